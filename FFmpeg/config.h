@@ -279,6 +279,7 @@
 #define HAVE_CLOSESOCKET 0
 #define HAVE_COMMANDLINETOARGVW 0
 #define HAVE_FCNTL 1
+#define HAVE_FORK 1
 #define HAVE_GETADDRINFO 1
 #define HAVE_GETHRTIME 0
 #define HAVE_GETOPT 1
@@ -90,6 +90,17 @@
 #include <sys/select.h>
 #endif
 
+#if HAVE_FORK
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#if HAVE_SYS_UN_H
+#include <sys/un.h>
+#endif
+#endif
+
 #if HAVE_TERMIOS_H
 #include <fcntl.h>
 #include <sys/ioctl.h>
@@ -126,15 +137,16 @@ typedef struct BenchmarkTimeStamps {
     int64_t sys_usec;
 } BenchmarkTimeStamps;
 
-static void do_video_stats(OutputStream *ost, int frame_size);
+static int do_video_stats(OutputStream *ost, int frame_size);
 static BenchmarkTimeStamps get_benchmark_time_stamps(void);
 static int64_t getmaxrss(void);
+static void run_command(void);
 static int ifilter_has_all_input_formats(FilterGraph *fg);
 
 static int run_as_daemon  = 0;
-static int nb_frames_dup = 0;
-static unsigned dup_warning = 1000;
-static int nb_frames_drop = 0;
+static atomic_int nb_frames_dup = ATOMIC_VAR_INIT(0);
+static atomic_uint dup_warning = ATOMIC_VAR_INIT(1000);
+static atomic_int nb_frames_drop = ATOMIC_VAR_INIT(0);
 static int64_t decode_error_stat[2];
 static unsigned nb_output_dumped = 0;
 
@@ -167,7 +179,9 @@ static int restore_tty;
 
 #if HAVE_THREADS
 static void free_input_threads(void);
+static void free_encoder_threads(int drain);
 #endif
+static void free_mux_threads(int drain);
 
 /* sub2video hack:
    Convert subtitles to video with alpha to insert them in filter graphs.
@@ -347,6 +361,9 @@ static volatile int ffmpeg_exited = 0;
 static int main_return_code = 0;
 static int64_t copy_ts_first_pts = AV_NOPTS_VALUE;
 
+/* serializes muxer access between the main thread and the encoder threads */
+static AVMutex output_lock = AV_MUTEX_INITIALIZER;
+
 static void
 sigterm_handler(int sig)
 {
@@ -521,6 +538,9 @@ static void ffmpeg_cleanup(int ret)
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
     }
 
+    free_encoder_threads(0);
+    free_mux_threads(0);
+
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
         avfilter_graph_free(&fg->graph);
@@ -590,6 +610,7 @@ static void ffmpeg_cleanup(int ret)
             continue;
 
         av_bsf_free(&ost->bsf_ctx);
+        smart_cut_free(&ost->smart_cut_ctx);
 
         av_frame_free(&ost->filtered_frame);
         av_frame_free(&ost->last_frame);
@@ -624,6 +645,7 @@ static void ffmpeg_cleanup(int ret)
 #if HAVE_THREADS
     free_input_threads();
 #endif
+    profile_report_close();
     for (i = 0; i < nb_input_files; i++) {
         avformat_close_input(&input_files[i]->ctx);
         av_packet_free(&input_files[i]->pkt);
@@ -719,16 +741,301 @@ static void update_benchmark(const char *fmt, ...)
     }
 }
 
+/* whether the caller is the encoder thread of ost */
+static int on_encoder_thread(OutputStream *ost)
+{
+#if HAVE_THREADS
+    return ost->enc_queue && pthread_equal(pthread_self(), ost->enc_thread);
+#else
+    return 0;
+#endif
+}
+
+/*
+ * The counters of an output stream that the main thread reads while the
+ * encoder thread of the stream may be updating them.
+ */
+typedef struct OutputStreamStatus {
+    int     frame_number;
+    int64_t sync_opts;
+    int64_t last_mux_dts;
+    int     quality;
+    enum AVPictureType pict_type;
+    int64_t error[4];
+    int64_t end_pts;        /* in the stream time base, AV_NOPTS_VALUE if unknown */
+} OutputStreamStatus;
+
+/*
+ * Read the counters of ost from the main thread. With an encoder thread
+ * running, the fields written by write_packet() are read under output_lock
+ * and frame_number and sync_opts come from the copies the thread publishes.
+ * With a muxing thread, the packets queued for it count as written, as in
+ * output_file_tell(), so end_pts is the last dts handed to the queue.
+ */
+static void get_output_stream_status(OutputStream *ost, OutputStreamStatus *st)
+{
+    int threaded = 0;
+
+#if HAVE_THREADS
+    threaded = !!ost->enc_queue;
+    if (threaded) {
+        ff_mutex_lock(&output_lock);
+        st->frame_number = ost->enc_frame_number;
+        st->sync_opts    = ost->enc_sync_opts;
+    }
+#endif
+    if (!threaded) {
+        st->frame_number = ost->frame_number;
+        st->sync_opts    = ost->sync_opts;
+    }
+    st->last_mux_dts = ost->last_mux_dts;
+    st->quality      = ost->quality;
+    st->pict_type    = ost->pict_type;
+    memcpy(st->error, ost->error, sizeof(st->error));
+    st->end_pts      = output_files[ost->file_index]->mux_thread_running ?
+                       ost->last_mux_dts : av_stream_get_end_pts(ost->st);
+#if HAVE_THREADS
+    if (threaded)
+        ff_mutex_unlock(&output_lock);
+#endif
+}
+
 static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream, OSTFinished others)
 {
     int i;
+#if HAVE_THREADS
+    if (on_encoder_thread(ost)) {
+        atomic_fetch_or(&ost->enc_finished_others, others);
+        atomic_fetch_or(&ost->enc_finished, this_stream);
+        return;
+    }
+#endif
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream *ost2 = output_streams[i];
         ost2->finished |= ost == ost2 ? this_stream : others;
     }
 }
 
-static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
+typedef struct MuxQueueEntry {
+    AVPacket *pkt;
+    int64_t   dts;  /* in AV_TIME_BASE units, AV_NOPTS_VALUE if unknown */
+} MuxQueueEntry;
+
+#if HAVE_THREADS
+/* dts span of the packets queued for the muxing thread, mux_lock must be held */
+static int64_t mux_queue_duration(OutputFile *of)
+{
+    MuxQueueEntry first, last;
+    int nb_entries = av_fifo_size(of->mux_queue) / sizeof(first);
+
+    if (nb_entries < 2)
+        return 0;
+    av_fifo_generic_peek_at(of->mux_queue, &first, 0, sizeof(first), NULL);
+    av_fifo_generic_peek_at(of->mux_queue, &last, (nb_entries - 1) * sizeof(last),
+                            sizeof(last), NULL);
+    if (first.dts == AV_NOPTS_VALUE || last.dts == AV_NOPTS_VALUE)
+        return 0;
+    return FFMAX(last.dts - first.dts, 0);
+}
+
+static void *mux_thread(void *arg)
+{
+    OutputFile *of = arg;
+
+    pthread_mutex_lock(&of->mux_lock);
+    for (;;) {
+        MuxQueueEntry entry;
+        ProfileTimer timer = { 0 };
+        int64_t pos;
+        int ret;
+
+        while (!av_fifo_size(of->mux_queue) && !of->mux_eof)
+            pthread_cond_wait(&of->mux_cond, &of->mux_lock);
+        if (!av_fifo_size(of->mux_queue))
+            break;
+
+        av_fifo_generic_read(of->mux_queue, &entry, sizeof(entry), NULL);
+        of->mux_queue_size -= entry.pkt->size;
+        pthread_cond_broadcast(&of->mux_cond);
+
+        // after an error the remaining packets are only discarded
+        if (of->mux_error < 0) {
+            av_packet_free(&entry.pkt);
+            continue;
+        }
+
+        pthread_mutex_unlock(&of->mux_lock);
+        profile_timer_start(&timer);
+        ret = av_interleaved_write_frame(of->ctx, entry.pkt);
+        profile_timer_stop(&timer);
+        profile_stage_add(&of->prof_mux, &timer, ret >= 0);
+        av_packet_free(&entry.pkt);
+        pos = of->ctx->pb ? avio_tell(of->ctx->pb) : 0;
+        pthread_mutex_lock(&of->mux_lock);
+
+        of->bytes_written = pos;
+        if (ret < 0)
+            of->mux_error = ret;
+    }
+    pthread_mutex_unlock(&of->mux_lock);
+
+    return NULL;
+}
+
+static int init_mux_thread(OutputFile *of)
+{
+    int ret;
+
+    if (of->mux_thread_queue_size <= 0)
+        return 0;
+
+    of->mux_queue = av_fifo_alloc(8 * sizeof(MuxQueueEntry));
+    if (!of->mux_queue)
+        return AVERROR(ENOMEM);
+    pthread_mutex_init(&of->mux_lock, NULL);
+    pthread_cond_init(&of->mux_cond, NULL);
+    of->bytes_written = of->ctx->pb ? avio_tell(of->ctx->pb) : 0;
+
+    if ((ret = pthread_create(&of->mux_thread, NULL, mux_thread, of))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        pthread_cond_destroy(&of->mux_cond);
+        pthread_mutex_destroy(&of->mux_lock);
+        av_fifo_freep(&of->mux_queue);
+        return AVERROR(ret);
+    }
+    of->mux_thread_running = 1;
+
+    return 0;
+}
+
+/*
+ * Queue a packet for the muxing thread, waiting while the queue holds more
+ * than mux_thread_queue_size bytes or mux_thread_queue_duration of data.
+ * Returns the error of the muxer once it has failed.
+ */
+static int queue_mux_packet(OutputFile *of, AVPacket *pkt, int64_t dts)
+{
+    MuxQueueEntry entry = { .dts = dts };
+    int ret;
+
+    entry.pkt = av_packet_alloc();
+    if (!entry.pkt) {
+        av_packet_unref(pkt);
+        return AVERROR(ENOMEM);
+    }
+    ret = av_packet_make_refcounted(pkt);
+    if (ret < 0) {
+        av_packet_unref(pkt);
+        av_packet_free(&entry.pkt);
+        return ret;
+    }
+    av_packet_move_ref(entry.pkt, pkt);
+
+    pthread_mutex_lock(&of->mux_lock);
+    while (!of->mux_error && av_fifo_size(of->mux_queue) &&
+           (of->mux_queue_size + entry.pkt->size > of->mux_thread_queue_size ||
+            (of->mux_thread_queue_duration > 0 &&
+             mux_queue_duration(of) >= of->mux_thread_queue_duration)))
+        pthread_cond_wait(&of->mux_cond, &of->mux_lock);
+
+    ret = of->mux_error;
+    if (ret >= 0 && !av_fifo_space(of->mux_queue))
+        ret = av_fifo_grow(of->mux_queue, av_fifo_size(of->mux_queue));
+    if (ret < 0) {
+        pthread_mutex_unlock(&of->mux_lock);
+        av_packet_free(&entry.pkt);
+        return ret;
+    }
+
+    av_fifo_generic_write(of->mux_queue, &entry, sizeof(entry), NULL);
+    of->mux_queue_size += entry.pkt->size;
+    of->mux_queue_peak_size     = FFMAX(of->mux_queue_peak_size, of->mux_queue_size);
+    of->mux_queue_peak_duration = FFMAX(of->mux_queue_peak_duration, mux_queue_duration(of));
+    of->mux_queue_peak_packets  = FFMAX(of->mux_queue_peak_packets,
+                                        av_fifo_size(of->mux_queue) / sizeof(entry));
+    pthread_cond_broadcast(&of->mux_cond);
+    pthread_mutex_unlock(&of->mux_lock);
+
+    return 0;
+}
+
+/*
+ * Stop the muxing threads. With drain set, all queued packets are written
+ * first, so that the trailers can be written from the main thread afterwards.
+ */
+static void free_mux_threads(int drain)
+{
+    int i;
+
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+        int ret;
+
+        if (!of || !of->mux_thread_running)
+            continue;
+
+        pthread_mutex_lock(&of->mux_lock);
+        of->mux_eof = 1;
+        if (!drain && !of->mux_error)
+            of->mux_error = AVERROR_EXIT;
+        pthread_cond_broadcast(&of->mux_cond);
+        pthread_mutex_unlock(&of->mux_lock);
+
+        pthread_join(of->mux_thread, NULL);
+        of->mux_thread_running = 0;
+        pthread_cond_destroy(&of->mux_cond);
+        pthread_mutex_destroy(&of->mux_lock);
+        av_fifo_freep(&of->mux_queue);
+
+        ret = of->mux_error;
+        if (drain && ret < 0) {
+            print_error("av_interleaved_write_frame()", ret);
+            main_return_code = 1;
+            close_all_output_streams(output_streams[of->ost_index],
+                                     MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
+        }
+    }
+}
+#else
+static int init_mux_thread(OutputFile *of)
+{
+    return 0;
+}
+
+static int queue_mux_packet(OutputFile *of, AVPacket *pkt, int64_t dts)
+{
+    return AVERROR(ENOSYS);
+}
+
+static void free_mux_threads(int drain)
+{
+}
+#endif
+
+/*
+ * Current output position, without touching the AVIOContext of a muxing
+ * thread. Packets still queued for that thread are counted as written.
+ */
+static int64_t output_file_tell(OutputFile *of)
+{
+    int64_t pos;
+
+#if HAVE_THREADS
+    if (of->mux_thread_running) {
+        pthread_mutex_lock(&of->mux_lock);
+        pos = of->bytes_written + of->mux_queue_size;
+        pthread_mutex_unlock(&of->mux_lock);
+        return pos;
+    }
+#endif
+    // the encoder threads write to the file under output_lock
+    ff_mutex_lock(&output_lock);
+    pos = of->ctx->pb ? avio_tell(of->ctx->pb) : 0;
+    ff_mutex_unlock(&output_lock);
+    return pos;
+}
+
+static int write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
 {
     AVFormatContext *s = of->ctx;
     AVStream *st = ost->st;
@@ -745,7 +1052,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
     if (!(st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && ost->encoding_needed) && !unqueue) {
         if (ost->frame_number >= ost->max_frames) {
             av_packet_unref(pkt);
-            return;
+            return 0;
         }
         ost->frame_number++;
     }
@@ -765,22 +1072,22 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
                 av_log(NULL, AV_LOG_ERROR,
                        "Too many packets buffered for output stream %d:%d.\n",
                        ost->file_index, ost->st->index);
-                exit_program(1);
+                return AVERROR(ENOSPC);
             }
             ret = av_fifo_realloc2(ost->muxing_queue, new_size);
             if (ret < 0)
-                exit_program(1);
+                return ret;
         }
         ret = av_packet_make_refcounted(pkt);
         if (ret < 0)
-            exit_program(1);
+            return ret;
         tmp_pkt = av_packet_alloc();
         if (!tmp_pkt)
-            exit_program(1);
+            return AVERROR(ENOMEM);
         av_packet_move_ref(tmp_pkt, pkt);
         ost->muxing_queue_data_size += tmp_pkt->size;
         av_fifo_generic_write(ost->muxing_queue, &tmp_pkt, sizeof(tmp_pkt), NULL);
-        return;
+        return 0;
     }
 
     if ((st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && video_sync_method == VSYNC_DROP) ||
@@ -837,7 +1144,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
                        ost->file_index, ost->st->index, ost->last_mux_dts, pkt->dts);
                 if (exit_on_error) {
                     av_log(NULL, AV_LOG_FATAL, "aborting.\n");
-                    exit_program(1);
+                    return AVERROR(EINVAL);
                 }
                 av_log(s, loglevel, "changing to %"PRId64". This may result "
                        "in incorrect timestamps in the output file.\n",
@@ -865,21 +1172,50 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
               );
     }
 
-    ret = av_interleaved_write_frame(s, pkt);
+    if (of->mux_thread_running)
+        ret = queue_mux_packet(of, pkt, pkt->dts == AV_NOPTS_VALUE ? AV_NOPTS_VALUE :
+                               av_rescale_q(pkt->dts, st->time_base, AV_TIME_BASE_Q));
+    else {
+        ProfileTimer timer = { 0 };
+
+        profile_timer_start(&timer);
+        ret = av_interleaved_write_frame(s, pkt);
+        profile_timer_stop(&timer);
+        profile_stage_add(&of->prof_mux, &timer, ret >= 0);
+    }
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
-        main_return_code = 1;
+        // set by sync_encoder_threads() for the encoder threads
+        if (!on_encoder_thread(ost))
+            main_return_code = 1;
         close_all_output_streams(ost, MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
     }
+
+    return 0;
 }
 
 static void close_output_stream(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
 
+#if HAVE_THREADS
+    if (on_encoder_thread(ost)) {
+        if (!(atomic_load(&ost->enc_finished) & ENCODER_FINISHED)) {
+            if (of->shortest)
+                ost->enc_end_time = av_rescale_q(ost->sync_opts - ost->first_pts, ost->enc_ctx->time_base, AV_TIME_BASE_Q);
+            atomic_fetch_or(&ost->enc_finished, ENCODER_FINISHED);
+        }
+        return;
+    }
+#endif
+
     ost->finished |= ENCODER_FINISHED;
     if (of->shortest) {
-        int64_t end = av_rescale_q(ost->sync_opts - ost->first_pts, ost->enc_ctx->time_base, AV_TIME_BASE_Q);
+        OutputStreamStatus st;
+        int64_t end;
+
+        get_output_stream_status(ost, &st);
+        end = av_rescale_q(st.sync_opts - ost->first_pts, ost->enc_ctx->time_base, AV_TIME_BASE_Q);
         of->recording_time = FFMIN(of->recording_time, end);
     }
 }
@@ -894,39 +1230,67 @@ static void close_output_stream(OutputStream *ost)
  * If eof is set, instead indicate EOF to all bitstream filters and
  * therefore flush any delayed packets to the output.  A blank packet
  * must be supplied in this case.
+ *
+ * Returns a negative error code only for errors that must abort the program.
  */
-static void output_packet(OutputFile *of, AVPacket *pkt,
-                          OutputStream *ost, int eof)
+static int output_packet(OutputFile *of, AVPacket *pkt,
+                         OutputStream *ost, int eof)
 {
     int ret = 0;
 
     /* apply the output bitstream filters */
     if (ost->bsf_ctx) {
+        ProfileTimer timer = { 0 };
+        int nb_packets = 0;
+
+        profile_timer_start(&timer);
         ret = av_bsf_send_packet(ost->bsf_ctx, eof ? NULL : pkt);
-        if (ret < 0)
+        if (ret < 0) {
+            profile_timer_stop(&timer);
             goto finish;
-        while ((ret = av_bsf_receive_packet(ost->bsf_ctx, pkt)) >= 0)
-            write_packet(of, pkt, ost, 0);
+        }
+        while ((ret = av_bsf_receive_packet(ost->bsf_ctx, pkt)) >= 0) {
+            profile_timer_stop(&timer);
+            nb_packets++;
+            ff_mutex_lock(&output_lock);
+            ret = write_packet(of, pkt, ost, 0);
+            ff_mutex_unlock(&output_lock);
+            if (ret < 0)
+                return ret;
+            profile_timer_start(&timer);
+        }
+        profile_timer_stop(&timer);
+        profile_stage_add(&ost->prof_bsf, &timer, nb_packets);
         if (ret == AVERROR(EAGAIN))
             ret = 0;
-    } else if (!eof)
-        write_packet(of, pkt, ost, 0);
+    } else if (!eof) {
+        ff_mutex_lock(&output_lock);
+        ret = write_packet(of, pkt, ost, 0);
+        ff_mutex_unlock(&output_lock);
+        return ret;
+    }
 
 finish:
     if (ret < 0 && ret != AVERROR_EOF) {
         av_log(NULL, AV_LOG_ERROR, "Error applying bitstream filters to an output "
                "packet for stream #%d:%d.\n", ost->file_index, ost->index);
         if(exit_on_error)
-            exit_program(1);
+            return ret;
     }
+    return 0;
 }
 
 static int check_recording_time(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
+    int64_t recording_time = of->recording_time;
 
-    if (of->recording_time != INT64_MAX &&
-        av_compare_ts(ost->sync_opts - ost->first_pts, ost->enc_ctx->time_base, of->recording_time,
+#if HAVE_THREADS
+    if (on_encoder_thread(ost))
+        recording_time = ost->enc_recording_time;
+#endif
+    if (recording_time != INT64_MAX &&
+        av_compare_ts(ost->sync_opts - ost->first_pts, ost->enc_ctx->time_base, recording_time,
                       AV_TIME_BASE_Q) >= 0) {
         close_output_stream(ost);
         return 0;
@@ -990,7 +1354,9 @@ static int init_output_stream_wrapper(OutputStream *ost, AVFrame *frame,
     if (ost->initialized)
         return 0;
 
+    ff_mutex_lock(&output_lock);
     ret = init_output_stream(ost, frame, error, sizeof(error));
+    ff_mutex_unlock(&output_lock);
     if (ret < 0) {
         av_log(NULL, AV_LOG_ERROR, "Error initializing output stream %d:%d -- %s\n",
                ost->file_index, ost->index, error);
@@ -1002,17 +1368,17 @@ static int init_output_stream_wrapper(OutputStream *ost, AVFrame *frame,
     return ret;
 }
 
-static void do_audio_out(OutputFile *of, OutputStream *ost,
-                         AVFrame *frame)
+static int do_audio_out(OutputFile *of, OutputStream *ost,
+                        AVFrame *frame)
 {
     AVCodecContext *enc = ost->enc_ctx;
     AVPacket *pkt = ost->pkt;
+    ProfileTimer timer = { 0 };
+    int nb_packets = 0;
     int ret;
 
-    adjust_frame_pts_to_encoder_tb(of, ost, frame);
-
     if (!check_recording_time(ost))
-        return;
+        return 0;
 
     if (frame->pts == AV_NOPTS_VALUE || audio_sync_method < 0)
         frame->pts = ost->sync_opts;
@@ -1028,6 +1394,7 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
+    profile_timer_start(&timer);
     ret = avcodec_send_frame(enc, frame);
     if (ret < 0)
         goto error;
@@ -1035,12 +1402,14 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
     while (1) {
         av_packet_unref(pkt);
         ret = avcodec_receive_packet(enc, pkt);
+        profile_timer_stop(&timer);
         if (ret == AVERROR(EAGAIN))
             break;
         if (ret < 0)
             goto error;
 
         update_benchmark("encode_audio %d.%d", ost->file_index, ost->index);
+        nb_packets++;
 
         av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
 
@@ -1051,13 +1420,16 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                    av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base));
         }
 
-        output_packet(of, pkt, ost, 0);
+        if ((ret = output_packet(of, pkt, ost, 0)) < 0)
+            return ret;
+        profile_timer_start(&timer);
     }
+    profile_stage_add(&ost->prof_encode, &timer, nb_packets);
 
-    return;
+    return 0;
 error:
     av_log(NULL, AV_LOG_FATAL, "Audio encoding failed\n");
-    exit_program(1);
+    return ret;
 }
 
 static void do_subtitle_out(OutputFile *of,
@@ -1139,28 +1511,23 @@ static void do_subtitle_out(OutputFile *of,
                 pkt->pts += av_rescale_q(sub->end_display_time, (AVRational){ 1, 1000 }, ost->mux_timebase);
         }
         pkt->dts = pkt->pts;
-        output_packet(of, pkt, ost, 0);
+        if (output_packet(of, pkt, ost, 0) < 0)
+            exit_program(1);
     }
 }
 
-static void do_video_out(OutputFile *of,
-                         OutputStream *ost,
-                         AVFrame *next_picture)
+/*
+ * Compute the duration of a filtered video frame in encoder time base units.
+ * This needs the filtergraph, so it is done before the frame is handed to an
+ * encoder thread.
+ */
+static double video_frame_duration(OutputStream *ost, AVFrame *next_picture)
 {
-    int ret, format_video_sync;
-    AVPacket *pkt = ost->pkt;
     AVCodecContext *enc = ost->enc_ctx;
+    AVFilterContext *filter = ost->filter->filter;
+    InputStream *ist = NULL;
     AVRational frame_rate;
-    int nb_frames, nb0_frames, i;
-    double delta, delta0;
     double duration = 0;
-    double sync_ipts = AV_NOPTS_VALUE;
-    int frame_size = 0;
-    InputStream *ist = NULL;
-    AVFilterContext *filter = ost->filter->filter;
-
-    init_output_stream_wrapper(ost, next_picture, 1);
-    sync_ipts = adjust_frame_pts_to_encoder_tb(of, ost, next_picture);
 
     if (ost->source_index >= 0)
         ist = input_streams[ost->source_index];
@@ -1181,6 +1548,28 @@ static void do_video_out(OutputFile *of,
         duration = lrintf(next_picture->pkt_duration * av_q2d(ist->st->time_base) / av_q2d(enc->time_base));
     }
 
+    return duration;
+}
+
+static int do_video_out(OutputFile *of,
+                        OutputStream *ost,
+                        AVFrame *next_picture,
+                        double sync_ipts,
+                        double duration)
+{
+    int ret, format_video_sync;
+    AVPacket *pkt = ost->pkt;
+    AVCodecContext *enc = ost->enc_ctx;
+    int nb_frames, nb0_frames, i;
+    double delta, delta0;
+    int frame_size = 0;
+    InputStream *ist = NULL;
+    ProfileTimer timer = { 0 };
+    int nb_packets;
+
+    if (ost->source_index >= 0)
+        ist = input_streams[ost->source_index];
+
     if (!next_picture) {
         //end, flushing
         nb0_frames = nb_frames = mid_pred(ost->last_nb0_frames[0],
@@ -1269,22 +1658,25 @@ static void do_video_out(OutputFile *of,
     ost->last_nb0_frames[0] = nb0_frames;
 
     if (nb0_frames == 0 && ost->last_dropped) {
-        nb_frames_drop++;
+        atomic_fetch_add(&nb_frames_drop, 1);
         av_log(NULL, AV_LOG_VERBOSE,
                "*** dropping frame %d from stream %d at ts %"PRId64"\n",
                ost->frame_number, ost->st->index, ost->last_frame->pts);
     }
     if (nb_frames > (nb0_frames && ost->last_dropped) + (nb_frames > nb0_frames)) {
+        int nb_dup = nb_frames - (nb0_frames && ost->last_dropped) - (nb_frames > nb0_frames);
+        unsigned warning = atomic_load(&dup_warning);
+
         if (nb_frames > dts_error_threshold * 30) {
             av_log(NULL, AV_LOG_ERROR, "%d frame duplication too large, skipping\n", nb_frames - 1);
-            nb_frames_drop++;
-            return;
+            atomic_fetch_add(&nb_frames_drop, 1);
+            return 0;
         }
-        nb_frames_dup += nb_frames - (nb0_frames && ost->last_dropped) - (nb_frames > nb0_frames);
+        nb_dup += atomic_fetch_add(&nb_frames_dup, nb_dup);
         av_log(NULL, AV_LOG_VERBOSE, "*** %d dup!\n", nb_frames - 1);
-        if (nb_frames_dup > dup_warning) {
-            av_log(NULL, AV_LOG_WARNING, "More than %d frames duplicated\n", dup_warning);
-            dup_warning *= 10;
+        if (nb_dup > warning) {
+            av_log(NULL, AV_LOG_WARNING, "More than %d frames duplicated\n", warning);
+            atomic_store(&dup_warning, warning * 10);
         }
     }
     ost->last_dropped = nb_frames == nb0_frames && next_picture;
@@ -1302,12 +1694,12 @@ static void do_video_out(OutputFile *of,
             in_picture = next_picture;
 
         if (!in_picture)
-            return;
+            return 0;
 
         in_picture->pts = ost->sync_opts;
 
         if (!check_recording_time(ost))
-            return;
+            return 0;
 
         in_picture->quality = enc->global_quality;
         in_picture->pict_type = 0;
@@ -1371,6 +1763,8 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
+        nb_packets = 0;
+        profile_timer_start(&timer);
         ret = avcodec_send_frame(enc, in_picture);
         if (ret < 0)
             goto error;
@@ -1380,11 +1774,13 @@ static void do_video_out(OutputFile *of,
         while (1) {
             av_packet_unref(pkt);
             ret = avcodec_receive_packet(enc, pkt);
+            profile_timer_stop(&timer);
             update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
             if (ret == AVERROR(EAGAIN))
                 break;
             if (ret < 0)
                 goto error;
+            nb_packets++;
 
             if (debug_ts) {
                 av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
@@ -1406,13 +1802,16 @@ static void do_video_out(OutputFile *of,
             }
 
             frame_size = pkt->size;
-            output_packet(of, pkt, ost, 0);
+            if ((ret = output_packet(of, pkt, ost, 0)) < 0)
+                return ret;
 
             /* if two pass, output log */
             if (ost->logfile && enc->stats_out) {
                 fprintf(ost->logfile, "%s", enc->stats_out);
             }
+            profile_timer_start(&timer);
         }
+        profile_stage_add(&ost->prof_encode, &timer, nb_packets);
         ost->sync_opts++;
         /*
          * For video, number of frames in == number of packets out.
@@ -1421,8 +1820,9 @@ static void do_video_out(OutputFile *of,
          */
         ost->frame_number++;
 
-        if (vstats_filename && frame_size)
-            do_video_stats(ost, frame_size);
+        if (vstats_filename && frame_size &&
+            (ret = do_video_stats(ost, frame_size)) < 0)
+            return ret;
     }
 
     if (!ost->last_frame)
@@ -1433,10 +1833,10 @@ static void do_video_out(OutputFile *of,
     else
         av_frame_free(&ost->last_frame);
 
-    return;
+    return 0;
 error:
     av_log(NULL, AV_LOG_FATAL, "Video encoding failed\n");
-    exit_program(1);
+    return ret;
 }
 
 static double psnr(double d)
@@ -1444,7 +1844,7 @@ static double psnr(double d)
     return -10.0 * log10(d);
 }
 
-static void do_video_stats(OutputStream *ost, int frame_size)
+static int do_video_stats(OutputStream *ost, int frame_size)
 {
     AVCodecContext *enc;
     int frame_number;
@@ -1454,8 +1854,9 @@ static void do_video_stats(OutputStream *ost, int frame_size)
     if (!vstats_file) {
         vstats_file = fopen(vstats_filename, "w");
         if (!vstats_file) {
+            int ret = AVERROR(errno);
             perror("fopen");
-            exit_program(1);
+            return ret;
         }
     }
 
@@ -1485,6 +1886,7 @@ static void do_video_stats(OutputStream *ost, int frame_size)
                (double)ost->data_size / 1024, ti1, bitrate, avg_bitrate);
         fprintf(vstats_file, "type= %c\n", av_get_picture_type_char(ost->pict_type));
     }
+    return 0;
 }
 
 static void finish_output_stream(OutputStream *ost)
@@ -1500,43 +1902,226 @@ static void finish_output_stream(OutputStream *ost)
     }
 }
 
-/**
- * Get and encode new output from any of the filtergraphs, without causing
- * activity.
- *
- * @return  0 for success, <0 for severe errors
- */
-static int reap_filters(int flush)
+typedef struct EncoderMsg {
+    AVFrame *frame;     /* NULL flushes the video frame rate conversion */
+    double sync_ipts;   /* video only, see do_video_out() */
+    double duration;
+    int64_t recording_time; /* of the output file when the frame was queued */
+} EncoderMsg;
+
+#if HAVE_THREADS
+static void encoder_msg_free(void *msg)
 {
-    AVFrame *filtered_frame = NULL;
-    int i;
+    av_frame_free(&((EncoderMsg *)msg)->frame);
+}
 
-    /* Reap all buffers present in the buffer sinks */
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream *ost = output_streams[i];
-        OutputFile    *of = output_files[ost->file_index];
-        AVFilterContext *filter;
-        AVCodecContext *enc = ost->enc_ctx;
-        int ret = 0;
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    OutputFile    *of = output_files[ost->file_index];
+    AVCodecContext *enc = ost->enc_ctx;
+    EncoderMsg msg;
+    int ret;
 
-        if (!ost->filter || !ost->filter->graph->graph)
-            continue;
-        filter = ost->filter->filter;
+    while (av_thread_message_queue_recv(ost->enc_queue, &msg, 0) >= 0) {
+        ost->enc_recording_time = msg.recording_time;
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+            if (msg.frame && !ost->frame_aspect_ratio.num)
+                enc->sample_aspect_ratio = msg.frame->sample_aspect_ratio;
+            ret = do_video_out(of, ost, msg.frame, msg.sync_ipts, msg.duration);
+        } else {
+            ret = do_audio_out(of, ost, msg.frame);
+        }
+        av_frame_free(&msg.frame);
 
-        /*
-         * Unlike video, with audio the audio frame size matters.
-         * Currently we are fully reliant on the lavfi filter chain to
-         * do the buffering deed for us, and thus the frame size parameter
-         * needs to be set accordingly. Where does one get the required
-         * frame size? From the initialized AVCodecContext of an audio
-         * encoder. Thus, if we have gotten to an audio stream, initialize
-         * the encoder earlier than receiving the first AVFrame.
-         */
-        if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_AUDIO)
-            init_output_stream_wrapper(ost, NULL, 1);
+        ff_mutex_lock(&output_lock);
+        ost->enc_frame_number = ost->frame_number;
+        ost->enc_sync_opts    = ost->sync_opts;
+        ff_mutex_unlock(&output_lock);
 
-        if (!ost->pkt && !(ost->pkt = av_packet_alloc())) {
-            return AVERROR(ENOMEM);
+        if (ret < 0) {
+            // the main thread exits once it fails to queue the next frame
+            ost->enc_error = ret;
+            av_thread_message_queue_set_err_send(ost->enc_queue, ret);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    int ret;
+
+    ret = av_thread_message_queue_alloc(&ost->enc_queue, ost->enc_thread_queue_size,
+                                        sizeof(EncoderMsg));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(ost->enc_queue, encoder_msg_free);
+    ost->enc_end_time     = INT64_MAX;
+    ost->enc_frame_number = ost->frame_number;
+    ost->enc_sync_opts    = ost->sync_opts;
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        av_thread_message_queue_free(&ost->enc_queue);
+        return AVERROR(ret);
+    }
+
+    return 0;
+}
+
+/*
+ * Apply the changes to the finished flags and recording times reported by
+ * the encoder threads. The reported flags are never cleared, so this can be
+ * repeated at any time.
+ */
+static void sync_encoder_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        OutputFile    *of = output_files[ost->file_index];
+        int finished = atomic_load(&ost->enc_finished);
+        int others   = atomic_load(&ost->enc_finished_others);
+
+        if (!finished && !others)
+            continue;
+        if ((finished & ENCODER_FINISHED) && of->shortest)
+            of->recording_time = FFMIN(of->recording_time, ost->enc_end_time);
+        if (finished & MUXER_FINISHED)
+            main_return_code = 1;
+        close_all_output_streams(ost, finished, others);
+    }
+}
+
+/*
+ * Stop the encoder threads. With drain set, the queued frames are encoded
+ * first, so that the encoders can be flushed from the main thread afterwards.
+ */
+static void free_encoder_threads(int drain)
+{
+    int i, failed = 0;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (!ost->enc_queue)
+            continue;
+        if (!drain)
+            av_thread_message_flush(ost->enc_queue);
+        av_thread_message_queue_set_err_recv(ost->enc_queue, AVERROR_EOF);
+        pthread_join(ost->enc_thread, NULL);
+        av_thread_message_queue_free(&ost->enc_queue);
+        failed |= ost->enc_error < 0;
+    }
+
+    sync_encoder_threads();
+    if (drain && failed)
+        exit_program(1);
+}
+#else
+static void sync_encoder_threads(void)
+{
+}
+
+static void free_encoder_threads(int drain)
+{
+}
+#endif
+
+/*
+ * Pass a filtered frame to the encoder of ost, either directly or through the
+ * queue of its encoder thread. Everything depending on the filtergraph is
+ * evaluated here, as the graph may be reconfigured while the frame is queued.
+ */
+static int send_frame_to_encoder(OutputFile *of, OutputStream *ost, AVFrame *frame)
+{
+    EncoderMsg msg = { NULL };
+
+    int ret;
+
+    if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+        init_output_stream_wrapper(ost, frame, 1);
+        msg.sync_ipts = adjust_frame_pts_to_encoder_tb(of, ost, frame);
+        msg.duration  = video_frame_duration(ost, frame);
+    } else {
+        adjust_frame_pts_to_encoder_tb(of, ost, frame);
+    }
+
+#if HAVE_THREADS
+    if (ost->enc_thread_queue_size > 0) {
+        if (!ost->enc_queue && (ret = init_encoder_thread(ost)) < 0)
+            return ret;
+
+        if (frame) {
+            if (!(msg.frame = av_frame_alloc()))
+                return AVERROR(ENOMEM);
+            av_frame_move_ref(msg.frame, frame);
+        }
+        msg.recording_time = of->recording_time;
+        // blocks while the encoder is behind, which throttles decoding and filtering
+        ret = av_thread_message_queue_send(ost->enc_queue, &msg, 0);
+        if (ret < 0) {
+            // only fails after the encoder thread stopped on an error
+            av_frame_free(&msg.frame);
+            exit_program(1);
+        }
+        return 0;
+    }
+#endif
+
+    if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+        if (frame && !ost->frame_aspect_ratio.num)
+            ost->enc_ctx->sample_aspect_ratio = frame->sample_aspect_ratio;
+        ret = do_video_out(of, ost, frame, msg.sync_ipts, msg.duration);
+    } else {
+        ret = do_audio_out(of, ost, frame);
+    }
+    if (ret < 0)
+        exit_program(1);
+    return 0;
+}
+
+/**
+ * Get and encode new output from any of the filtergraphs, without causing
+ * activity.
+ *
+ * @return  0 for success, <0 for severe errors
+ */
+static int reap_filters(int flush)
+{
+    AVFrame *filtered_frame = NULL;
+    int i;
+
+    /* Reap all buffers present in the buffer sinks */
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        OutputFile    *of = output_files[ost->file_index];
+        AVFilterContext *filter;
+        AVCodecContext *enc = ost->enc_ctx;
+        int ret = 0;
+
+        if (!ost->filter || !ost->filter->graph->graph)
+            continue;
+        filter = ost->filter->filter;
+
+        /*
+         * Unlike video, with audio the audio frame size matters.
+         * Currently we are fully reliant on the lavfi filter chain to
+         * do the buffering deed for us, and thus the frame size parameter
+         * needs to be set accordingly. Where does one get the required
+         * frame size? From the initialized AVCodecContext of an audio
+         * encoder. Thus, if we have gotten to an audio stream, initialize
+         * the encoder earlier than receiving the first AVFrame.
+         */
+        if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_AUDIO)
+            init_output_stream_wrapper(ost, NULL, 1);
+
+        if (!ost->pkt && !(ost->pkt = av_packet_alloc())) {
+            return AVERROR(ENOMEM);
         }
         if (!ost->filtered_frame && !(ost->filtered_frame = av_frame_alloc())) {
             return AVERROR(ENOMEM);
@@ -1551,8 +2136,9 @@ static int reap_filters(int flush)
                     av_log(NULL, AV_LOG_WARNING,
                            "Error in av_buffersink_get_frame_flags(): %s\n", av_err2str(ret));
                 } else if (flush && ret == AVERROR_EOF) {
-                    if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_VIDEO)
-                        do_video_out(of, ost, NULL);
+                    if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_VIDEO &&
+                        (ret = send_frame_to_encoder(of, ost, NULL)) < 0)
+                        return ret;
                 }
                 break;
             }
@@ -1563,10 +2149,7 @@ static int reap_filters(int flush)
 
             switch (av_buffersink_get_type(filter)) {
             case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
-                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
-
-                do_video_out(of, ost, filtered_frame);
+                ret = send_frame_to_encoder(of, ost, filtered_frame);
                 break;
             case AVMEDIA_TYPE_AUDIO:
                 if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
@@ -1575,7 +2158,7 @@ static int reap_filters(int flush)
                            "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
                     break;
                 }
-                do_audio_out(of, ost, filtered_frame);
+                ret = send_frame_to_encoder(of, ost, filtered_frame);
                 break;
             default:
                 // TODO support subtitle filters
@@ -1583,6 +2166,8 @@ static int reap_filters(int flush)
             }
 
             av_frame_unref(filtered_frame);
+            if (ret < 0)
+                return ret;
         }
     }
 
@@ -1714,6 +2299,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     int64_t total_size;
     AVCodecContext *enc;
     int frame_number, vid, i;
+    int frames_dup, frames_drop;
     double bitrate;
     double speed;
     int64_t pts = INT64_MIN + 1;
@@ -1743,19 +2329,27 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
     oc = output_files[0]->ctx;
 
-    total_size = avio_size(oc->pb);
-    if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
-        total_size = avio_tell(oc->pb);
+    if (output_files[0]->mux_thread_running) {
+        total_size = output_file_tell(output_files[0]);
+    } else {
+        ff_mutex_lock(&output_lock);
+        total_size = avio_size(oc->pb);
+        if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
+            total_size = avio_tell(oc->pb);
+        ff_mutex_unlock(&output_lock);
+    }
 
     vid = 0;
     av_bprint_init(&buf, 0, AV_BPRINT_SIZE_AUTOMATIC);
     av_bprint_init(&buf_script, 0, AV_BPRINT_SIZE_AUTOMATIC);
     for (i = 0; i < nb_output_streams; i++) {
+        OutputStreamStatus st;
         float q = -1;
         ost = output_streams[i];
         enc = ost->enc_ctx;
+        get_output_stream_status(ost, &st);
         if (!ost->stream_copy)
-            q = ost->quality / (float) FF_QP2LAMBDA;
+            q = st.quality / (float) FF_QP2LAMBDA;
 
         if (vid && enc->codec_type == AVMEDIA_TYPE_VIDEO) {
             av_bprintf(&buf, "q=%2.1f ", q);
@@ -1765,7 +2359,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         if (!vid && enc->codec_type == AVMEDIA_TYPE_VIDEO) {
             float fps;
 
-            frame_number = ost->frame_number;
+            frame_number = st.frame_number;
             fps = t > 1 ? frame_number / t : 0;
             av_bprintf(&buf, "frame=%5d fps=%3.*f q=%3.1f ",
                      frame_number, fps < 9.95, fps, q);
@@ -1784,7 +2378,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
                     av_bprintf(&buf, "%X", av_log2(qp_histogram[j] + 1));
             }
 
-            if ((enc->flags & AV_CODEC_FLAG_PSNR) && (ost->pict_type != AV_PICTURE_TYPE_NONE || is_last_report)) {
+            if ((enc->flags & AV_CODEC_FLAG_PSNR) && (st.pict_type != AV_PICTURE_TYPE_NONE || is_last_report)) {
                 int j;
                 double error, error_sum = 0;
                 double scale, scale_sum = 0;
@@ -1796,7 +2390,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
                         error = enc->error[j];
                         scale = enc->width * enc->height * 255.0 * 255.0 * frame_number;
                     } else {
-                        error = ost->error[j];
+                        error = st.error[j];
                         scale = enc->width * enc->height * 255.0 * 255.0;
                     }
                     if (j)
@@ -1816,9 +2410,8 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             vid = 1;
         }
         /* compute min output value */
-        if (av_stream_get_end_pts(ost->st) != AV_NOPTS_VALUE) {
-            pts = FFMAX(pts, av_rescale_q(av_stream_get_end_pts(ost->st),
-                                          ost->st->time_base, AV_TIME_BASE_Q));
+        if (st.end_pts != AV_NOPTS_VALUE) {
+            pts = FFMAX(pts, av_rescale_q(st.end_pts, ost->st->time_base, AV_TIME_BASE_Q));
             if (copy_ts) {
                 if (copy_ts_first_pts == AV_NOPTS_VALUE && pts > 1)
                     copy_ts_first_pts = pts;
@@ -1828,7 +2421,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         }
 
         if (is_last_report)
-            nb_frames_drop += ost->last_dropped;
+            atomic_fetch_add(&nb_frames_drop, ost->last_dropped);
     }
 
     secs = FFABS(pts) / AV_TIME_BASE;
@@ -1872,10 +2465,12 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
                    hours_sign, hours, mins, secs, us);
     }
 
-    if (nb_frames_dup || nb_frames_drop)
-        av_bprintf(&buf, " dup=%d drop=%d", nb_frames_dup, nb_frames_drop);
-    av_bprintf(&buf_script, "dup_frames=%d\n", nb_frames_dup);
-    av_bprintf(&buf_script, "drop_frames=%d\n", nb_frames_drop);
+    frames_dup  = atomic_load(&nb_frames_dup);
+    frames_drop = atomic_load(&nb_frames_drop);
+    if (frames_dup || frames_drop)
+        av_bprintf(&buf, " dup=%d drop=%d", frames_dup, frames_drop);
+    av_bprintf(&buf_script, "dup_frames=%d\n", frames_dup);
+    av_bprintf(&buf_script, "drop_frames=%d\n", frames_drop);
 
     if (speed < 0) {
         av_bprintf(&buf, " speed=N/A");
@@ -1885,6 +2480,32 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         av_bprintf(&buf_script, "speed=%4.3gx\n", speed);
     }
 
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+        int64_t peak_size, peak_duration;
+        int peak_packets;
+
+        if (!of->mux_thread_running && !of->mux_queue_peak_packets)
+            continue;
+#if HAVE_THREADS
+        if (of->mux_thread_running)
+            pthread_mutex_lock(&of->mux_lock);
+#endif
+        peak_size     = of->mux_queue_peak_size;
+        peak_duration = of->mux_queue_peak_duration;
+        peak_packets  = of->mux_queue_peak_packets;
+#if HAVE_THREADS
+        if (of->mux_thread_running)
+            pthread_mutex_unlock(&of->mux_lock);
+#endif
+        if (!i)
+            av_bprintf(&buf, " muxq=%.0fkB/%.2fs", peak_size / 1024.0,
+                       peak_duration / (double)AV_TIME_BASE);
+        av_bprintf(&buf_script, "mux_%d_queue_peak_size=%"PRId64"\n", i, peak_size);
+        av_bprintf(&buf_script, "mux_%d_queue_peak_duration_us=%"PRId64"\n", i, peak_duration);
+        av_bprintf(&buf_script, "mux_%d_queue_peak_packets=%d\n", i, peak_packets);
+    }
+
     if (print_stats || is_last_report) {
         const char end = is_last_report ? '\n' : '\r';
         if (print_stats==1 && AV_LOG_INFO > av_log_get_level()) {
@@ -1979,6 +2600,7 @@ static void flush_encoders(void)
         for (;;) {
             const char *desc = NULL;
             AVPacket *pkt = ost->pkt;
+            ProfileTimer timer = { 0 };
             int pkt_size;
 
             switch (enc->codec_type) {
@@ -1993,6 +2615,7 @@ static void flush_encoders(void)
             }
 
             update_benchmark(NULL);
+            profile_timer_start(&timer);
 
             av_packet_unref(pkt);
             while ((ret = avcodec_receive_packet(enc, pkt)) == AVERROR(EAGAIN)) {
@@ -2006,6 +2629,8 @@ static void flush_encoders(void)
             }
 
             update_benchmark("flush_%s %d.%d", desc, ost->file_index, ost->index);
+            profile_timer_stop(&timer);
+            profile_stage_add(&ost->prof_encode, &timer, ret >= 0);
             if (ret < 0 && ret != AVERROR_EOF) {
                 av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
                        desc,
@@ -2016,7 +2641,8 @@ static void flush_encoders(void)
                 fprintf(ost->logfile, "%s", enc->stats_out);
             }
             if (ret == AVERROR_EOF) {
-                output_packet(of, pkt, ost, 1);
+                if (output_packet(of, pkt, ost, 1) < 0)
+                    exit_program(1);
                 break;
             }
             if (ost->finished & MUXER_FINISHED) {
@@ -2025,10 +2651,11 @@ static void flush_encoders(void)
             }
             av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
             pkt_size = pkt->size;
-            output_packet(of, pkt, ost, 0);
-            if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename) {
-                do_video_stats(ost, pkt_size);
-            }
+            if (output_packet(of, pkt, ost, 0) < 0)
+                exit_program(1);
+            if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename &&
+                do_video_stats(ost, pkt_size) < 0)
+                exit_program(1);
         }
     }
 }
@@ -2047,13 +2674,15 @@ static int check_output_constraints(InputStream *ist, OutputStream *ost)
     if (ost->finished)
         return 0;
 
-    if (of->start_time != AV_NOPTS_VALUE && ist->pts < of->start_time)
+    /* smart cut needs the GOP that contains the start time */
+    if (of->start_time != AV_NOPTS_VALUE && ist->pts < of->start_time &&
+        !ost->smart_cut_ctx)
         return 0;
 
     return 1;
 }
 
-static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *pkt)
+static void streamcopy_packet(InputStream *ist, OutputStream *ost, const AVPacket *pkt)
 {
     OutputFile *of = output_files[ost->file_index];
     InputFile   *f = input_files [ist->file_index];
@@ -2064,7 +2693,8 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
     av_packet_unref(opkt);
     // EOF: flush output bitstream filters.
     if (!pkt) {
-        output_packet(of, opkt, ost, 1);
+        if (output_packet(of, opkt, ost, 1) < 0)
+            exit_program(1);
         return;
     }
 
@@ -2082,6 +2712,10 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
             return;
     }
 
+    /* smart cut ends the stream at the exact frame */
+    if (ost->smart_cut_ctx)
+        goto copy;
+
     if (of->recording_time != INT64_MAX &&
         ist->pts >= of->recording_time + start_time) {
         close_output_stream(ost);
@@ -2100,6 +2734,7 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
         }
     }
 
+copy:
     /* force the input stream PTS */
     if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
         ost->sync_opts++;
@@ -2127,7 +2762,28 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
 
     opkt->duration = av_rescale_q(pkt->duration, ist->st->time_base, ost->mux_timebase);
 
-    output_packet(of, opkt, ost, 0);
+    if (output_packet(of, opkt, ost, 0) < 0)
+        exit_program(1);
+}
+
+static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *pkt)
+{
+    if (ost->smart_cut_ctx) {
+        AVPacket *opkt;
+        int ret = smart_cut_send_packet(ost->smart_cut_ctx, pkt);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Smart cut of output stream #%d:%d failed: %s\n",
+                   ost->file_index, ost->index, av_err2str(ret));
+            exit_program(1);
+        }
+        while ((opkt = smart_cut_receive_packet(ost->smart_cut_ctx)))
+            streamcopy_packet(ist, ost, opkt);
+        if (smart_cut_finished(ost->smart_cut_ctx))
+            close_output_stream(ost);
+        if (pkt)
+            return;
+    }
+    streamcopy_packet(ist, ost, pkt);
 }
 
 int guess_input_channel_layout(InputStream *ist)
@@ -2180,10 +2836,60 @@ static int ifilter_has_all_input_formats(FilterGraph *fg)
     return 1;
 }
 
+#if CONFIG_SWSCALE
+/*
+ * Whether a video frame whose size or pixel format differs from the
+ * configured filtergraph input can be sent to the graph as it is, leaving
+ * the scale filters to adapt to it (-reinit_filter 2).
+ */
+static int ifilter_can_reconfigure(InputFilter *ifilter, const AVFrame *frame)
+{
+    AVFrameSideData *sd = av_frame_get_side_data(frame, AV_FRAME_DATA_DISPLAYMATRIX);
+
+    if (ifilter->ist->reinit_filters != 2 || !ifilter->graph->graph ||
+        ifilter->type != AVMEDIA_TYPE_VIDEO ||
+        ifilter->hw_frames_ctx || frame->hw_frames_ctx)
+        return 0;
+    if (!sd != !ifilter->displaymatrix ||
+        (sd && memcmp(sd->data, ifilter->displaymatrix, sizeof(int32_t) * 9)))
+        return 0;
+    return sws_isSupportedInput(frame->format) &&
+           filter_outputs_reach_scale(ifilter->filter);
+}
+
+static int ifilter_reconfigure(InputFilter *ifilter, const AVFrame *frame)
+{
+    AVBufferSrcParameters *par;
+    InputStream *ist = ifilter->ist;
+    int ret;
+
+    av_log(NULL, AV_LOG_VERBOSE, "Input stream #%d:%d changed to %dx%d %s, "
+           "reconfiguring the scalers of filtergraph %d\n",
+           ist->file_index, ist->st->index, frame->width, frame->height,
+           av_get_pix_fmt_name(frame->format), ifilter->graph->index);
+
+    ret = ifilter_parameters_from_frame(ifilter, frame);
+    if (ret < 0)
+        return ret;
+
+    /* the buffer source only compares the frames with these */
+    par = av_buffersrc_parameters_alloc();
+    if (!par)
+        return AVERROR(ENOMEM);
+    par->format = frame->format;
+    par->width  = frame->width;
+    par->height = frame->height;
+    ret = av_buffersrc_parameters_set(ifilter->filter, par);
+    av_freep(&par);
+    return ret;
+}
+#endif
+
 static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
 {
     FilterGraph *fg = ifilter->graph;
     AVFrameSideData *sd;
+    ProfileTimer timer = { 0 };
     int need_reinit, ret, i;
 
     /* determine if the parameters for this input changed */
@@ -2214,6 +2920,15 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
     } else if (ifilter->displaymatrix)
         need_reinit = 1;
 
+#if CONFIG_SWSCALE
+    if (need_reinit && ifilter_can_reconfigure(ifilter, frame)) {
+        ret = ifilter_reconfigure(ifilter, frame);
+        if (ret < 0)
+            return ret;
+        need_reinit = 0;
+    }
+#endif
+
     if (need_reinit) {
         ret = ifilter_parameters_from_frame(ifilter, frame);
         if (ret < 0)
@@ -2254,7 +2969,10 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
         }
     }
 
+    profile_timer_start(&timer);
     ret = av_buffersrc_add_frame_flags(ifilter->filter, frame, AV_BUFFERSRC_FLAG_PUSH);
+    profile_timer_stop(&timer);
+    profile_stage_add(&fg->prof_filter, &timer, 1);
     if (ret < 0) {
         if (ret != AVERROR_EOF)
             av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
@@ -2345,6 +3063,7 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
 {
     AVFrame *decoded_frame;
     AVCodecContext *avctx = ist->dec_ctx;
+    ProfileTimer timer = { 0 };
     int ret, err = 0;
     AVRational decoded_frame_tb;
 
@@ -2355,7 +3074,10 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
     decoded_frame = ist->decoded_frame;
 
     update_benchmark(NULL);
+    profile_timer_start(&timer);
     ret = decode(avctx, decoded_frame, got_output, pkt);
+    profile_timer_stop(&timer);
+    profile_stage_add(&ist->prof_decode, &timer, *got_output);
     update_benchmark("decode_audio %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2406,6 +3128,7 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
                         int *decode_failed)
 {
     AVFrame *decoded_frame;
+    ProfileTimer timer = { 0 };
     int i, ret = 0, err = 0;
     int64_t best_effort_timestamp;
     int64_t dts = AV_NOPTS_VALUE;
@@ -2438,7 +3161,10 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     }
 
     update_benchmark(NULL);
+    profile_timer_start(&timer);
     ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt);
+    profile_timer_stop(&timer);
+    profile_stage_add(&ist->prof_decode, &timer, *got_output);
     update_benchmark("decode_video %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -3069,6 +3795,10 @@ static int check_init_output_file(OutputFile *of, int file_index)
     if (sdp_filename || want_sdp)
         print_sdp();
 
+    ret = init_mux_thread(of);
+    if (ret < 0)
+        return ret;
+
     /* flush the muxing queues */
     for (i = 0; i < of->ctx->nb_streams; i++) {
         OutputStream *ost = output_streams[of->ost_index + i];
@@ -3081,8 +3811,10 @@ static int check_init_output_file(OutputFile *of, int file_index)
             AVPacket *pkt;
             av_fifo_generic_read(ost->muxing_queue, &pkt, sizeof(pkt), NULL);
             ost->muxing_queue_data_size -= pkt->size;
-            write_packet(of, pkt, ost, 1);
+            ret = write_packet(of, pkt, ost, 1);
             av_packet_free(&pkt);
+            if (ret < 0)
+                exit_program(1);
         }
     }
 
@@ -3232,6 +3964,31 @@ static int init_output_stream_streamcopy(OutputStream *ost)
         ost->st->sample_aspect_ratio = par_dst->sample_aspect_ratio = sar;
         ost->st->avg_frame_rate = ist->st->avg_frame_rate;
         ost->st->r_frame_rate = ist->st->r_frame_rate;
+
+        if (ost->smart_cut) {
+            InputFile *f = input_files[ist->file_index];
+            int64_t start_time = of->start_time == AV_NOPTS_VALUE ? 0 : of->start_time;
+            int64_t cut_time = start_time, end_time = INT64_MAX;
+
+            /* same bounds as streamcopy_packet() */
+            if (copy_ts && f->start_time != AV_NOPTS_VALUE)
+                cut_time = FFMAX(start_time, f->start_time + f->ts_offset);
+            if (of->recording_time != INT64_MAX)
+                end_time = of->recording_time + start_time;
+            if (f->recording_time != INT64_MAX) {
+                int64_t f_start_time = 0;
+                if (copy_ts) {
+                    f_start_time += f->start_time != AV_NOPTS_VALUE ? f->start_time : 0;
+                    f_start_time += start_at_zero ? 0 : f->ctx->start_time;
+                }
+                end_time = FFMIN(end_time, f->recording_time + f_start_time);
+            }
+            ret = smart_cut_init(ost, ist, av_rescale_q(cut_time, AV_TIME_BASE_Q, ist->st->time_base),
+                                 end_time == INT64_MAX ? INT64_MAX :
+                                 av_rescale_q(end_time, AV_TIME_BASE_Q, ist->st->time_base));
+            if (ret < 0)
+                return ret;
+        }
         break;
     }
 
@@ -3930,15 +4687,19 @@ static int need_output(void)
 {
     int i;
 
+    sync_encoder_threads();
+
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream *ost    = output_streams[i];
         OutputFile *of       = output_files[ost->file_index];
         AVFormatContext *os  = output_files[ost->file_index]->ctx;
+        OutputStreamStatus st;
 
         if (ost->finished ||
-            (os->pb && avio_tell(os->pb) >= of->limit_filesize))
+            (os->pb && output_file_tell(of) >= of->limit_filesize))
             continue;
-        if (ost->frame_number >= ost->max_frames) {
+        get_output_stream_status(ost, &st);
+        if (st.frame_number >= ost->max_frames) {
             int j;
             for (j = 0; j < of->ctx->nb_streams; j++)
                 close_output_stream(output_streams[of->ost_index + j]);
@@ -3964,10 +4725,13 @@ static OutputStream *choose_output(void)
 
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream *ost = output_streams[i];
-        int64_t opts = ost->last_mux_dts == AV_NOPTS_VALUE ? INT64_MIN :
-                       av_rescale_q(ost->last_mux_dts, ost->st->time_base,
-                                    AV_TIME_BASE_Q);
-        if (ost->last_mux_dts == AV_NOPTS_VALUE)
+        OutputStreamStatus st;
+        int64_t opts;
+
+        get_output_stream_status(ost, &st);
+        opts = st.last_mux_dts == AV_NOPTS_VALUE ? INT64_MIN :
+               av_rescale_q(st.last_mux_dts, ost->st->time_base, AV_TIME_BASE_Q);
+        if (st.last_mux_dts == AV_NOPTS_VALUE)
             av_log(NULL, AV_LOG_DEBUG,
                 "cur_dts is invalid st:%d (%d) [init:%d i_done:%d finish:%d] (this is harmless if it occurs once at the start per stream)\n",
                 ost->st->index, ost->st->id, ost->initialized, ost->inputs_done, ost->finished);
@@ -4114,10 +4878,16 @@ static void *input_thread(void *arg)
     InputFile *f = arg;
     AVPacket *pkt = f->pkt, *queue_pkt;
     unsigned flags = f->non_blocking ? AV_THREAD_MESSAGE_NONBLOCK : 0;
+    int budget_warned = 0;
     int ret = 0;
 
     while (1) {
+        ProfileTimer timer = { 0 };
+
+        profile_timer_start(&timer);
         ret = av_read_frame(f->ctx, pkt);
+        profile_timer_stop(&timer);
+        profile_stage_add(&f->prof_demux, &timer, ret >= 0);
 
         if (ret == AVERROR(EAGAIN)) {
             av_usleep(10000);
@@ -4134,6 +4904,24 @@ static void *input_thread(void *arg)
             break;
         }
         av_packet_move_ref(queue_pkt, pkt);
+
+        pthread_mutex_lock(&f->readahead_lock);
+        while (f->readahead_bytes > 0 && !f->readahead_stop &&
+               f->readahead_bytes + queue_pkt->size > f->readahead_budget) {
+            if (flags && !budget_warned &&
+                f->readahead_budget >= f->thread_queue_bytes) {
+                av_log(f->ctx, AV_LOG_WARNING,
+                       "Readahead budget reached; consider raising the "
+                       "thread_queue_bytes option (current value: %"PRId64")\n",
+                       f->thread_queue_bytes);
+                budget_warned = 1;
+            }
+            f->readahead_full = 1;
+            pthread_cond_wait(&f->readahead_cond, &f->readahead_lock);
+        }
+        f->readahead_bytes += queue_pkt->size;
+        pthread_mutex_unlock(&f->readahead_lock);
+
         ret = av_thread_message_queue_send(f->in_thread_queue, &queue_pkt, flags);
         if (flags && ret == AVERROR(EAGAIN)) {
             flags = 0;
@@ -4165,12 +4953,18 @@ static void free_input_thread(int i)
     if (!f || !f->in_thread_queue)
         return;
     av_thread_message_queue_set_err_send(f->in_thread_queue, AVERROR_EOF);
+    pthread_mutex_lock(&f->readahead_lock);
+    f->readahead_stop = 1;
+    pthread_cond_signal(&f->readahead_cond);
+    pthread_mutex_unlock(&f->readahead_lock);
     while (av_thread_message_queue_recv(f->in_thread_queue, &pkt, 0) >= 0)
         av_packet_free(&pkt);
 
     pthread_join(f->thread, NULL);
     f->joined = 1;
     av_thread_message_queue_free(&f->in_thread_queue);
+    pthread_cond_destroy(&f->readahead_cond);
+    pthread_mutex_destroy(&f->readahead_lock);
 }
 
 static void free_input_threads(void)
@@ -4186,22 +4980,37 @@ static int init_input_thread(int i)
     int ret;
     InputFile *f = input_files[i];
 
+    /* the queue is normally bounded by thread_queue_bytes, not by the number of packets */
     if (f->thread_queue_size < 0)
-        f->thread_queue_size = (nb_input_files > 1 ? 8 : 0);
+        f->thread_queue_size = 1024;
     if (!f->thread_queue_size)
         return 0;
 
-    if (f->ctx->pb ? !f->ctx->pb->seekable :
-        strcmp(f->ctx->iformat->name, "lavfi"))
+    /* with a single input there is nothing else to do while waiting for a packet */
+    if (nb_input_files > 1 &&
+        (f->ctx->pb ? !f->ctx->pb->seekable :
+         strcmp(f->ctx->iformat->name, "lavfi")))
         f->non_blocking = 1;
     ret = av_thread_message_queue_alloc(&f->in_thread_queue,
                                         f->thread_queue_size, sizeof(f->pkt));
     if (ret < 0)
         return ret;
 
+    /* start with a small readahead, it is raised when the queue runs dry */
+    if (!f->readahead_budget)
+        f->readahead_budget = f->thread_queue_bytes > 0 ?
+                              FFMIN(f->thread_queue_bytes, 1 << 20) : INT64_MAX;
+    f->readahead_bytes = 0;
+    f->readahead_full  = 0;
+    f->readahead_stop  = 0;
+    pthread_mutex_init(&f->readahead_lock, NULL);
+    pthread_cond_init(&f->readahead_cond, NULL);
+
     if ((ret = pthread_create(&f->thread, NULL, input_thread, f))) {
         av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
         av_thread_message_queue_free(&f->in_thread_queue);
+        pthread_cond_destroy(&f->readahead_cond);
+        pthread_mutex_destroy(&f->readahead_lock);
         return AVERROR(ret);
     }
 
@@ -4222,14 +5031,42 @@ static int init_input_threads(void)
 
 static int get_input_packet_mt(InputFile *f, AVPacket **pkt)
 {
-    return av_thread_message_queue_recv(f->in_thread_queue, pkt,
-                                        f->non_blocking ?
-                                        AV_THREAD_MESSAGE_NONBLOCK : 0);
+    int ret;
+
+    if (!av_thread_message_queue_nb_elems(f->in_thread_queue)) {
+        pthread_mutex_lock(&f->readahead_lock);
+        /* the reader was held back by the budget, yet the queue ran dry:
+         * read further ahead to ride out the next stall of the input */
+        if (f->readahead_full && f->readahead_budget < f->thread_queue_bytes) {
+            f->readahead_budget = FFMIN(2 * f->readahead_budget, f->thread_queue_bytes);
+            av_log(f->ctx, AV_LOG_VERBOSE, "Readahead queue ran dry, raising "
+                   "its budget to %"PRId64" bytes\n", f->readahead_budget);
+            pthread_cond_signal(&f->readahead_cond);
+        }
+        f->readahead_full = 0;
+        pthread_mutex_unlock(&f->readahead_lock);
+    }
+
+    ret = av_thread_message_queue_recv(f->in_thread_queue, pkt,
+                                       f->non_blocking ?
+                                       AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (ret < 0)
+        return ret;
+
+    pthread_mutex_lock(&f->readahead_lock);
+    f->readahead_bytes -= (*pkt)->size;
+    pthread_cond_signal(&f->readahead_cond);
+    pthread_mutex_unlock(&f->readahead_lock);
+
+    return 0;
 }
 #endif
 
 static int get_input_packet(InputFile *f, AVPacket **pkt)
 {
+    ProfileTimer timer = { 0 };
+    int ret;
+
     if (f->readrate || f->rate_emu) {
         int i;
         int64_t file_start = copy_ts * (
@@ -4254,7 +5091,11 @@ static int get_input_packet(InputFile *f, AVPacket **pkt)
         return get_input_packet_mt(f, pkt);
 #endif
     *pkt = f->pkt;
-    return av_read_frame(f->ctx, *pkt);
+    profile_timer_start(&timer);
+    ret = av_read_frame(f->ctx, *pkt);
+    profile_timer_stop(&timer);
+    profile_stage_add(&f->prof_demux, &timer, ret >= 0);
+    return ret;
 }
 
 static int got_eagain(void)
@@ -4429,8 +5270,14 @@ static int process_input(int file_index)
                 OutputStream *ost = output_streams[j];
 
                 if (ost->source_index == ifile->ist_index + i &&
-                    (ost->stream_copy || ost->enc->type == AVMEDIA_TYPE_SUBTITLE))
+                    (ost->stream_copy || ost->enc->type == AVMEDIA_TYPE_SUBTITLE)) {
+                    /* the smart cut holds packets back until the next keyframe,
+                     * process_input_packet() only flushes it for decoded inputs */
+                    if (ost->smart_cut_ctx && !ist->decoding_needed &&
+                        check_output_constraints(ist, ost))
+                        do_streamcopy(ist, ost, NULL);
                     finish_output_stream(ost);
+                }
             }
         }
 
@@ -4660,9 +5507,13 @@ static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
     int nb_requests, nb_requests_max = 0;
     InputFilter *ifilter;
     InputStream *ist;
+    ProfileTimer timer = { 0 };
 
     *best_ist = NULL;
+    profile_timer_start(&timer);
     ret = avfilter_graph_request_oldest(graph->graph);
+    profile_timer_stop(&timer);
+    profile_stage_add(&graph->prof_filter, &timer, 0);
     if (ret >= 0)
         return reap_filters(0);
 
@@ -4836,6 +5687,7 @@ static int transcode(void)
 
         /* dump report by using the output first video and audio streams */
         print_report(0, timer_start, cur_time);
+        profile_report_write(0, timer_start, cur_time);
     }
 #if HAVE_THREADS
     free_input_threads();
@@ -4848,7 +5700,9 @@ static int transcode(void)
             process_input_packet(ist, NULL, 0);
         }
     }
+    free_encoder_threads(1);
     flush_encoders();
+    free_mux_threads(1);
 
     term_exit();
 
@@ -4871,6 +5725,7 @@ static int transcode(void)
 
     /* dump report by using the first video and audio streams */
     print_report(1, timer_start, av_gettime_relative());
+    profile_report_write(1, timer_start, av_gettime_relative());
 
     /* close each encoder */
     for (i = 0; i < nb_output_streams; i++) {
@@ -4981,39 +5836,12 @@ static void log_callback_null(void *ptr, int level, const char *fmt, va_list vl)
 {
 }
 
-int main(int argc, char **argv)
+/* everything main() does once the options are parsed, does not return */
+static void run_transcode(void)
 {
-    int i, ret;
+    int i;
     BenchmarkTimeStamps ti;
 
-    init_dynload();
-
-    register_exit(ffmpeg_cleanup);
-
-    setvbuf(stderr,NULL,_IONBF,0); /* win32 runtime needs this */
-
-    av_log_set_flags(AV_LOG_SKIP_REPEATED);
-    parse_loglevel(argc, argv, options);
-
-    if(argc>1 && !strcmp(argv[1], "-d")){
-        run_as_daemon=1;
-        av_log_set_callback(log_callback_null);
-        argc--;
-        argv++;
-    }
-
-#if CONFIG_AVDEVICE
-    avdevice_register_all();
-#endif
-    avformat_network_init();
-
-    show_banner(argc, argv, options);
-
-    /* parse options and open all input/output files */
-    ret = ffmpeg_parse_options(argc, argv);
-    if (ret < 0)
-        exit_program(1);
-
     if (nb_output_files <= 0 && nb_input_files == 0) {
         show_usage();
         av_log(NULL, AV_LOG_WARNING, "Use -h to get full help or, even better, run 'man %s'\n", program_name);
@@ -5050,5 +5878,886 @@ int main(int argc, char **argv)
         exit_program(69);
 
     exit_program(received_nb_signals ? 255 : main_return_code);
+}
+
+#if HAVE_FORK
+/*
+ * Worker mode: jobs are read one per line, with the syntax of the command
+ * line, from stdin or from the connections to a Unix socket. Each job runs
+ * in a process forked from the worker, which never runs a job itself, so
+ * that every job starts from the state the worker had after its own setup
+ * (loaded libraries, global options, the network) and shares nothing with
+ * the other jobs. When a job ends, "<job number> <exit code>" is written back,
+ * jobs being numbered from 1 on each connection.
+ */
+typedef struct WorkerConn {
+    int fd_in, fd_out;
+    AVBPrint line;          /* partial line read so far */
+    int nb_jobs;            /* number of jobs received */
+    int nb_pending;         /* jobs received but not finished */
+    int eof;
+} WorkerConn;
+
+typedef struct WorkerJob {
+    WorkerConn *conn;
+    int id;
+    char *cmdline;
+    pid_t pid;              /* 0 until started */
+} WorkerJob;
+
+static void worker_reply(WorkerConn *conn, int id, int status)
+{
+    char buf[64];
+    int len, code = WIFEXITED(status)   ? WEXITSTATUS(status) :
+                    WIFSIGNALED(status) ? 128 + WTERMSIG(status) : 255;
+
+    len = snprintf(buf, sizeof(buf), "%d %d\n", id, code);
+    if (write(conn->fd_out, buf, len) != len)
+        av_log(NULL, AV_LOG_WARNING, "Could not report the end of job %d\n", id);
+}
+
+/* runs in the forked process, does not return */
+static void worker_exec_job(WorkerJob *job)
+{
+    const char *p = job->cmdline;
+    char **argv = NULL;
+    int argc = 0;
+
+    /* the job must not read the commands sent to the worker on stdin */
+    if (!worker_socket) {
+        int fd = open("/dev/null", O_RDONLY);
+        if (fd >= 0) {
+            dup2(fd, 0);
+            close(fd);
+        }
+    }
+
+    GROW_ARRAY(argv, argc);
+    if (!(argv[argc - 1] = av_strdup(program_name)))
+        exit_program(1);
+    while (*(p += strspn(p, " \t\r"))) {
+        GROW_ARRAY(argv, argc);
+        if (!(argv[argc - 1] = av_get_token(&p, " \t\r")))
+            exit_program(1);
+    }
+
+    worker_jobs = 0;
+    av_freep(&worker_socket);
+    parse_loglevel(argc, argv, options);
+    if (ffmpeg_parse_options(argc, argv) < 0)
+        exit_program(1);
+    if (worker_jobs > 0) {
+        av_log(NULL, AV_LOG_FATAL, "-worker_jobs cannot be used in a worker job\n");
+        exit_program(1);
+    }
+    run_command();
+}
+
+static int worker_start_job(WorkerJob *job, int listen_fd, WorkerConn **conns, int nb_conns)
+{
+    int i;
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        int ret = AVERROR(errno);
+        av_log(NULL, AV_LOG_ERROR, "Could not start a job: %s\n", av_err2str(ret));
+        return ret;
+    }
+    if (!pid) {
+        if (listen_fd >= 0)
+            close(listen_fd);
+        for (i = 0; i < nb_conns; i++) {
+            if (conns[i]->fd_in > 2)
+                close(conns[i]->fd_in);
+            if (conns[i]->fd_out > 2 && conns[i]->fd_out != conns[i]->fd_in)
+                close(conns[i]->fd_out);
+        }
+        worker_exec_job(job);
+    }
+    job->pid = pid;
+    return 0;
+}
+
+/* split the data read on conn into jobs */
+static void worker_read(WorkerConn *conn, WorkerJob ***jobs, int *nb_jobs)
+{
+    char buf[4096], *line, *end;
+    ssize_t len = read(conn->fd_in, buf, sizeof(buf));
+
+    if (len <= 0) {
+        if (len < 0 && (errno == EINTR || errno == EAGAIN))
+            return;
+        conn->eof = 1;
+        return;
+    }
+    av_bprint_append_data(&conn->line, buf, len);
+    if (!av_bprint_is_complete(&conn->line))
+        exit_program(1);
+
+    line = conn->line.str;
+    while ((end = memchr(line, '\n', conn->line.str + conn->line.len - line))) {
+        *end = 0;
+        if (line[strspn(line, " \t\r")]) {
+            WorkerJob *job = av_mallocz(sizeof(*job));
+            if (!job || !(job->cmdline = av_strdup(line)))
+                exit_program(1);
+            job->conn = conn;
+            job->id   = ++conn->nb_jobs;
+            conn->nb_pending++;
+            GROW_ARRAY(*jobs, *nb_jobs);
+            (*jobs)[*nb_jobs - 1] = job;
+        }
+        line = end + 1;
+    }
+    len = conn->line.str + conn->line.len - line;
+    memmove(conn->line.str, line, len);
+    conn->line.str[len] = 0;
+    conn->line.len      = len;
+}
+
+static WorkerConn *worker_add_conn(WorkerConn ***conns, int *nb_conns, int fd_in, int fd_out)
+{
+    WorkerConn *conn = av_mallocz(sizeof(*conn));
+
+    if (!conn)
+        exit_program(1);
+    conn->fd_in  = fd_in;
+    conn->fd_out = fd_out;
+    av_bprint_init(&conn->line, 0, AV_BPRINT_SIZE_UNLIMITED);
+    GROW_ARRAY(*conns, *nb_conns);
+    (*conns)[*nb_conns - 1] = conn;
+    return conn;
+}
+
+static void worker_close_conn(WorkerConn *conn)
+{
+    if (conn->fd_in > 2)
+        close(conn->fd_in);
+    if (conn->fd_out > 2 && conn->fd_out != conn->fd_in)
+        close(conn->fd_out);
+    av_bprint_finalize(&conn->line, NULL);
+}
+
+static int worker_listen(const char *path)
+{
+#if HAVE_SYS_UN_H
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        av_log(NULL, AV_LOG_ERROR, "Worker socket path too long: %s\n", path);
+        return AVERROR(EINVAL);
+    }
+    av_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 16) < 0) {
+        int ret = AVERROR(errno);
+        av_log(NULL, AV_LOG_ERROR, "Could not listen on %s: %s\n", path, av_err2str(ret));
+        if (fd >= 0)
+            close(fd);
+        return ret;
+    }
+    return fd;
+#else
+    av_log(NULL, AV_LOG_ERROR, "Unix sockets are not supported on this platform\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
+static int run_worker(void)
+{
+    WorkerConn **conns = NULL;
+    WorkerJob  **jobs  = NULL;
+    struct pollfd *fds = NULL;
+    int nb_conns = 0, nb_jobs = 0, nb_running = 0, nb_fds;
+    int listen_fd = -1, i, ret = 0;
+
+    if (nb_input_files || nb_output_files) {
+        av_log(NULL, AV_LOG_FATAL, "-worker_jobs cannot be used with input or output files\n");
+        return 1;
+    }
+
+    if (worker_socket) {
+        listen_fd = worker_listen(worker_socket);
+        if (listen_fd < 0)
+            return 1;
+    } else {
+        /* the jobs keep stdout, so the replies need a descriptor of their own */
+        if (worker_reply_fd < 0 || worker_reply_fd == 0 ||
+            fcntl(worker_reply_fd, F_GETFD) < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Jobs read from stdin need an open -worker_reply_fd "
+                   "other than 0 for the replies\n");
+            return 1;
+        }
+        worker_add_conn(&conns, &nb_conns, 0, worker_reply_fd);
+    }
+
+    /* jobs inherit the global options given to the worker, but no terminal */
+    term_exit();
+    stdin_interaction = 0;
+
+    av_log(NULL, AV_LOG_INFO, "Worker running up to %d jobs at once, reading jobs from %s\n",
+           worker_jobs, worker_socket ? worker_socket : "stdin");
+
+    while (!received_sigterm) {
+        int status;
+        pid_t pid;
+
+        /* start the queued jobs, in order */
+        for (i = 0; i < nb_jobs && nb_running < worker_jobs; i++) {
+            if (jobs[i]->pid)
+                continue;
+            if (worker_start_job(jobs[i], listen_fd, conns, nb_conns) < 0)
+                break;
+            nb_running++;
+        }
+
+        /* close the connections that are done */
+        for (i = 0; i < nb_conns; i++) {
+            WorkerConn *conn = conns[i];
+            if (!conn->eof || conn->nb_pending)
+                continue;
+            worker_close_conn(conn);
+            av_freep(&conns[i]);
+            conns[i--] = conns[--nb_conns];
+        }
+        if (listen_fd < 0 && !nb_conns)
+            break;
+
+        fds = av_realloc_array(fds, nb_conns + 1, sizeof(*fds));
+        if (!fds)
+            exit_program(1);
+        nb_fds = 0;
+        if (listen_fd >= 0)
+            fds[nb_fds++] = (struct pollfd){ .fd = listen_fd, .events = POLLIN };
+        for (i = 0; i < nb_conns; i++)
+            if (!conns[i]->eof)
+                fds[nb_fds++] = (struct pollfd){ .fd = conns[i]->fd_in, .events = POLLIN };
+
+        if (poll(fds, nb_fds, 100) > 0) {
+            for (i = 0; i < nb_fds; i++) {
+                int j;
+
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                    continue;
+                if (fds[i].fd == listen_fd) {
+                    int fd = accept(listen_fd, NULL, NULL);
+                    if (fd >= 0)
+                        worker_add_conn(&conns, &nb_conns, fd, fd);
+                    continue;
+                }
+                for (j = 0; j < nb_conns; j++)
+                    if (conns[j]->fd_in == fds[i].fd && !conns[j]->eof)
+                        worker_read(conns[j], &jobs, &nb_jobs);
+            }
+        }
+
+        /* report the finished jobs */
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (i = 0; i < nb_jobs; i++) {
+                WorkerJob *job = jobs[i];
+                if (job->pid != pid)
+                    continue;
+                worker_reply(job->conn, job->id, status);
+                job->conn->nb_pending--;
+                nb_running--;
+                av_freep(&job->cmdline);
+                av_freep(&jobs[i]);
+                memmove(jobs + i, jobs + i + 1, (nb_jobs - i - 1) * sizeof(*jobs));
+                nb_jobs--;
+                break;
+            }
+        }
+    }
+
+    if (received_sigterm) {
+        for (i = 0; i < nb_jobs; i++)
+            if (jobs[i]->pid)
+                kill(jobs[i]->pid, SIGTERM);
+        ret = 255;
+    }
+    while (waitpid(-1, NULL, 0) > 0 || errno == EINTR)
+        ;
+
+    for (i = 0; i < nb_jobs; i++) {
+        av_freep(&jobs[i]->cmdline);
+        av_freep(&jobs[i]);
+    }
+    av_freep(&jobs);
+    for (i = 0; i < nb_conns; i++) {
+        worker_close_conn(conns[i]);
+        av_freep(&conns[i]);
+    }
+    av_freep(&conns);
+    av_freep(&fds);
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(worker_socket);
+    }
+    return ret;
+}
+
+/*
+ * Chunked encoding: the input is split into encode_chunks parts at keyframes,
+ * each part is transcoded by a process forked after the options are parsed,
+ * with its own demuxer, decoders, filters and encoders, and the outputs of
+ * the parts are joined with the concat demuxer.
+ */
+static char *chunk_filename(const char *url, int idx)
+{
+    return idx < 0 ? av_asprintf("%s.ffconcat", url) : av_asprintf("%s.chunk%d", url, idx);
+}
+
+/* open the input again in a chunk process, with the streams set up by the parent */
+static int chunk_reopen_input(InputFile *f)
+{
+    AVFormatContext *old = f->ctx, *ic = avformat_alloc_context();
+    int i, ret;
+
+    if (!ic)
+        return AVERROR(ENOMEM);
+    ic->interrupt_callback = int_cb;
+    ret = avformat_open_input(&ic, old->url, old->iformat, NULL);
+    if (ret >= 0)
+        ret = avformat_find_stream_info(ic, NULL);
+    if (ret >= 0 && ic->nb_streams != old->nb_streams)
+        ret = AVERROR(EINVAL);
+    if (ret < 0) {
+        avformat_close_input(&ic);
+        return ret;
+    }
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        ic->streams[i]->discard = old->streams[i]->discard;
+        input_streams[f->ist_index + i]->st = ic->streams[i];
+    }
+    f->ctx = ic;
+    avformat_close_input(&old);
+    return 0;
+}
+
+static void chunk_exec(int idx, int64_t start, int64_t end)
+{
+    InputFile  *f  = input_files[0];
+    OutputFile *of = output_files[0];
+    AVFormatContext *oc = of->ctx;
+    int64_t seek_timestamp = start + (f->ctx->start_time != AV_NOPTS_VALUE ? f->ctx->start_time : 0);
+    char *url = chunk_filename(oc->url, idx);
+    int fd, ret;
+
+    fd = open("/dev/null", O_RDONLY);
+    if (fd >= 0) {
+        dup2(fd, 0);
+        close(fd);
+    }
+    stdin_interaction = 0;
+    print_stats       = 0;
+
+    /* the file offset of the input is shared with the other processes */
+    ret = chunk_reopen_input(f);
+    if (ret >= 0 && start > 0)
+        ret = avformat_seek_file(f->ctx, -1, INT64_MIN, seek_timestamp, seek_timestamp, 0);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Chunk %d: cannot reopen %s: %s\n", idx, f->ctx->url, av_err2str(ret));
+        exit_program(1);
+    }
+    f->start_time  = start;
+    f->ts_offset  -= start;
+    if (end != INT64_MAX)
+        f->recording_time = end - start;
+
+    avio_closep(&oc->pb);
+    av_freep(&oc->url);
+    oc->url = url;
+    if (!url || (ret = avio_open2(&oc->pb, url, AVIO_FLAG_WRITE, &oc->interrupt_callback, NULL)) < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Chunk %d: cannot open %s\n", idx, url ? url : "output");
+        exit_program(1);
+    }
+    run_transcode();
+}
+
+/* split points, in AV_TIME_BASE from the start of the input */
+static int chunk_split_points(int64_t *points, int nb_chunks)
+{
+    AVFormatContext *ic = input_files[0]->ctx;
+    int64_t start = ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0;
+    AVStream *st = NULL;
+    int i, nb_points = 0;
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        if (ic->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO &&
+            !(ic->streams[i]->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+            st = ic->streams[i];
+            break;
+        }
+    }
+
+    points[nb_points++] = 0;
+    for (i = 1; i < nb_chunks; i++) {
+        int64_t t = av_rescale(ic->duration, i, nb_chunks);
+
+        /* move to the previous keyframe if it is known and close enough,
+         * so that decoding starts right there */
+        if (st) {
+            const AVIndexEntry *e = avformat_index_get_entry_from_timestamp(st,
+                av_rescale_q(t + start, AV_TIME_BASE_Q, st->time_base), AVSEEK_FLAG_BACKWARD);
+            int64_t key = e ? av_rescale_q(e->timestamp, st->time_base, AV_TIME_BASE_Q) - start : 0;
+            if (e && t - key < ic->duration / (2 * nb_chunks))
+                t = key;
+        }
+        if (t > points[nb_points - 1])
+            points[nb_points++] = t;
+    }
+    points[nb_points] = INT64_MAX;
+    return nb_points;
+}
+
+/* remux the chunks into the output file with the concat demuxer */
+static int chunk_concat(const int64_t *points, int nb_chunks)
+{
+    OutputFile *of = output_files[0];
+    AVFormatContext *ic = NULL, *oc = NULL;
+    const AVInputFormat *concat = av_find_input_format("concat");
+    AVDictionary *opts = NULL, *format_opts = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    char *list = chunk_filename(of->ctx->url, -1);
+    FILE *fp;
+    int i, ret = AVERROR(ENOMEM);
+
+    if (!pkt || !list)
+        goto end;
+    if (!concat) {
+        av_log(NULL, AV_LOG_FATAL, "The concat demuxer is needed to join the chunks\n");
+        ret = AVERROR_DEMUXER_NOT_FOUND;
+        goto end;
+    }
+
+    fp = fopen(list, "w");
+    if (!fp) {
+        ret = AVERROR(errno);
+        goto end;
+    }
+    fprintf(fp, "ffconcat version 1.0\n");
+    for (i = 0; i < nb_chunks; i++) {
+        char *chunk = chunk_filename(av_basename(of->ctx->url), i);
+        const char *p;
+        if (!chunk) {
+            fclose(fp);
+            goto end;
+        }
+        fputs("file '", fp);
+        for (p = chunk; *p; p++) {
+            if (*p == '\'')
+                fputs("'\\''", fp);
+            else
+                fputc(*p, fp);
+        }
+        fputs("'\n", fp);
+        /* the duration of a chunk guessed from its last timestamp misses the
+         * duration of its last frame, so give the one it was cut to */
+        if (points[i + 1] != INT64_MAX)
+            fprintf(fp, "duration %"PRId64"us\n", points[i + 1] - points[i]);
+        av_free(chunk);
+    }
+    fclose(fp);
+
+    av_dict_set(&opts, "safe", "0", 0);
+    ret = avformat_open_input(&ic, list, concat, &opts);
+    if (ret >= 0)
+        ret = avformat_find_stream_info(ic, NULL);
+    if (ret >= 0)
+        ret = avformat_alloc_output_context2(&oc, of->ctx->oformat, NULL, of->ctx->url);
+    if (ret < 0)
+        goto end;
+
+    av_dict_copy(&oc->metadata, of->ctx->metadata, 0);
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream *ist = ic->streams[i], *ost = avformat_new_stream(oc, NULL);
+        if (!ost) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ret = avcodec_parameters_copy(ost->codecpar, ist->codecpar);
+        if (ret < 0)
+            goto end;
+        ost->time_base           = ist->time_base;
+        ost->avg_frame_rate      = ist->avg_frame_rate;
+        ost->sample_aspect_ratio = ist->sample_aspect_ratio;
+        if (i < of->ctx->nb_streams) {
+            ost->disposition = of->ctx->streams[i]->disposition;
+            av_dict_copy(&ost->metadata, of->ctx->streams[i]->metadata, 0);
+        }
+    }
+
+    if (!(oc->oformat->flags & AVFMT_NOFILE) &&
+        (ret = avio_open2(&oc->pb, oc->url, AVIO_FLAG_WRITE, &oc->interrupt_callback, NULL)) < 0)
+        goto end;
+    av_dict_copy(&format_opts, of->opts, 0);
+    ret = avformat_write_header(oc, &format_opts);
+    if (ret < 0)
+        goto end;
+
+    while ((ret = av_read_frame(ic, pkt)) >= 0) {
+        av_packet_rescale_ts(pkt, ic->streams[pkt->stream_index]->time_base,
+                             oc->streams[pkt->stream_index]->time_base);
+        ret = av_interleaved_write_frame(oc, pkt);
+        if (ret < 0)
+            goto end;
+    }
+    ret = av_write_trailer(oc);
+
+end:
+    if (ret < 0 && ret != AVERROR_EOF)
+        av_log(NULL, AV_LOG_FATAL, "Error joining the chunks: %s\n", av_err2str(ret));
+    if (oc && !(oc->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+    avformat_close_input(&ic);
+    av_dict_free(&opts);
+    av_dict_free(&format_opts);
+    av_packet_free(&pkt);
+    if (list)
+        unlink(list);
+    av_free(list);
+    return ret < 0 && ret != AVERROR_EOF ? ret : 0;
+}
+
+static int run_chunked(void)
+{
+    InputFile  *f  = nb_input_files  == 1 ? input_files[0]  : NULL;
+    OutputFile *of = nb_output_files == 1 ? output_files[0] : NULL;
+    int64_t *points;
+    pid_t *pids;
+    int nb_chunks, i, ret = 0;
+
+    if (!f || !of) {
+        av_log(NULL, AV_LOG_FATAL, "-chunks needs exactly one input and one output file\n");
+        return 1;
+    }
+    if (f->start_time != AV_NOPTS_VALUE || f->recording_time != INT64_MAX ||
+        of->start_time != AV_NOPTS_VALUE || of->recording_time != INT64_MAX || copy_ts) {
+        av_log(NULL, AV_LOG_FATAL, "-chunks cannot be combined with -ss, -t, -to or -copyts\n");
+        return 1;
+    }
+    for (i = 0; i < of->ctx->nb_streams; i++) {
+        if (output_streams[of->ost_index + i]->enc_ctx->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2)) {
+            av_log(NULL, AV_LOG_FATAL, "-chunks cannot be combined with two-pass encoding\n");
+            return 1;
+        }
+    }
+    if ((f->ctx->iformat->flags & AVFMT_NOFILE) || !f->ctx->pb || !(f->ctx->pb->seekable & AVIO_SEEKABLE_NORMAL) ||
+        f->ctx->duration <= 0) {
+        av_log(NULL, AV_LOG_FATAL, "-chunks needs a seekable input file of known duration\n");
+        return 1;
+    }
+    if ((of->ctx->oformat->flags & AVFMT_NOFILE) || !of->ctx->pb ||
+        !(of->ctx->pb->seekable & AVIO_SEEKABLE_NORMAL)) {
+        av_log(NULL, AV_LOG_FATAL, "-chunks needs a seekable output file\n");
+        return 1;
+    }
+
+    points = av_calloc(encode_chunks + 1, sizeof(*points));
+    pids   = av_calloc(encode_chunks,     sizeof(*pids));
+    if (!points || !pids)
+        exit_program(1);
+    nb_chunks = chunk_split_points(points, encode_chunks);
+    av_log(NULL, AV_LOG_INFO, "Encoding %s in %d chunks\n", f->ctx->url, nb_chunks);
+
+    /* the chunks write their own files, the output is written by the concat */
+    avio_closep(&of->ctx->pb);
+    term_exit();
+
+    for (i = 0; i < nb_chunks; i++) {
+        pids[i] = fork();
+        if (pids[i] < 0) {
+            av_log(NULL, AV_LOG_FATAL, "fork failed: %s\n", strerror(errno));
+            ret = 1;
+            break;
+        }
+        if (!pids[i])
+            chunk_exec(i, points[i], points[i + 1]);
+        av_log(NULL, AV_LOG_VERBOSE, "Chunk %d: %0.3fs to %0.3fs\n", i,
+               points[i] / (double)AV_TIME_BASE,
+               points[i + 1] == INT64_MAX ? f->ctx->duration / (double)AV_TIME_BASE :
+                                            points[i + 1] / (double)AV_TIME_BASE);
+    }
+
+    for (i = 0; i < nb_chunks; i++) {
+        int status;
+        if (pids[i] <= 0)
+            continue;
+        while (waitpid(pids[i], &status, 0) < 0 && errno == EINTR)
+            ;
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            av_log(NULL, AV_LOG_ERROR, "Chunk %d failed\n", i);
+            ret = 1;
+        }
+    }
+
+    if (!ret && !received_sigterm && chunk_concat(points, nb_chunks) < 0)
+        ret = 1;
+
+    for (i = 0; i < nb_chunks; i++) {
+        char *chunk = chunk_filename(of->ctx->url, i);
+        if (chunk)
+            unlink(chunk);
+        av_free(chunk);
+    }
+    av_free(points);
+    av_free(pids);
+    return received_sigterm ? 255 : ret;
+}
+#else
+static int run_worker(void)
+{
+    av_log(NULL, AV_LOG_FATAL, "Worker mode is not supported on this platform\n");
+    return 1;
+}
+
+static int run_chunked(void)
+{
+    av_log(NULL, AV_LOG_FATAL, "Chunked encoding is not supported on this platform\n");
+    return 1;
+}
+#endif
+
+/*
+ * Decode benchmark: the selected streams of all the inputs are decoded and
+ * the frames dropped, without any filtering, encoding or muxing. The time
+ * spent is reported separately for the warm-up, the first
+ * decode_bench_warmup microseconds, and for the steady state after it.
+ */
+typedef struct DecodeBenchPhase {
+    BenchmarkTimeStamps start;
+    BenchmarkTimeStamps end;
+    int64_t maxrss;
+} DecodeBenchPhase;
+
+static int decode_bench_stream(InputStream *ist, const AVPacket *pkt, AVFrame *frame,
+                               int64_t *nb_frames)
+{
+    int ret = avcodec_send_packet(ist->dec_ctx, pkt);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        av_log(NULL, AV_LOG_WARNING, "Error decoding input stream #%d:%d: %s\n",
+               ist->file_index, ist->st->index, av_err2str(ret));
+        decode_error_stat[1]++;
+        if (exit_on_error)
+            return ret;
+    }
+    while ((ret = avcodec_receive_frame(ist->dec_ctx, frame)) >= 0) {
+        (*nb_frames)++;
+        av_frame_unref(frame);
+    }
+    if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+        decode_error_stat[1]++;
+        if (exit_on_error)
+            return ret;
+    }
+    return 0;
+}
+
+static void decode_bench_report(const char *name, const DecodeBenchPhase *p,
+                                int64_t (*nb_frames)[2], int64_t (*nb_bytes)[2],
+                                int phase, int nb_threads)
+{
+    int64_t real = p->end.real_usec - p->start.real_usec;
+    int64_t cpu  = p->end.user_usec - p->start.user_usec +
+                   p->end.sys_usec  - p->start.sys_usec;
+    int i;
+
+    if (real <= 0) {
+        av_log(NULL, AV_LOG_INFO, "%s: not reached\n", name);
+        return;
+    }
+    /* the decoding threads belong to libavcodec, so their own CPU time is not
+     * known; the load is given as a share of what nb_threads can do */
+    av_log(NULL, AV_LOG_INFO, "%s: %.3fs real, %.3fs cpu, %.0f%% cpu (%.0f%% of %d threads), maxrss=%"PRId64"KiB\n",
+           name, real / 1000000.0, cpu / 1000000.0, 100.0 * cpu / real,
+           100.0 * cpu / real / nb_threads, nb_threads, p->maxrss / 1024);
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+        if (!ist->decoding_needed)
+            continue;
+        av_log(NULL, AV_LOG_INFO, "  stream #%d:%d (%s): %"PRId64" frames, %.2f fps, %.1f kB/s\n",
+               ist->file_index, ist->st->index, ist->dec->name, nb_frames[i][phase],
+               nb_frames[i][phase] * 1000000.0 / real, nb_bytes[i][phase] * 1000.0 / real);
+    }
+}
+
+static int run_decode_bench(void)
+{
+    DecodeBenchPhase phases[2] = { { { 0 } } };
+    int64_t (*nb_frames)[2] = av_calloc(nb_input_streams, sizeof(*nb_frames));
+    int64_t (*nb_bytes)[2]  = av_calloc(nb_input_streams, sizeof(*nb_bytes));
+    AVPacket *pkt  = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    int i, j, phase = 0, nb_threads = 0, nb_decoded = 0, ret = 0;
+    char error[1024];
+
+    if (!nb_frames || !nb_bytes || !pkt || !frame)
+        exit_program(1);
+
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+        AVFormatContext *ic = input_files[ist->file_index]->ctx;
+        enum AVMediaType type = ist->st->codecpar->codec_type;
+
+        if (ist->user_set_discard == AVDISCARD_ALL ||
+            (type != AVMEDIA_TYPE_VIDEO && type != AVMEDIA_TYPE_AUDIO))
+            continue;
+        ret = avformat_match_stream_specifier(ic, ist->st, decode_bench);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Invalid stream specifier: %s\n", decode_bench);
+            return 1;
+        }
+        if (!ret)
+            continue;
+
+        /* decode in software, whatever -hwaccel says */
+        ist->hwaccel_id          = HWACCEL_NONE;
+        ist->hwaccel_device_type = AV_HWDEVICE_TYPE_NONE;
+        ist->decoding_needed     = DECODING_FOR_FILTER;
+        ist->discard             = 0;
+        ist->st->discard         = ist->user_set_discard;
+        ret = init_input_stream(i, error, sizeof(error));
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "%s\n", error);
+            return 1;
+        }
+        nb_threads += FFMAX(ist->dec_ctx->thread_count, 1);
+        nb_decoded++;
+        av_log(NULL, AV_LOG_INFO, "Decoding stream #%d:%d (%s) with %d thread(s)%s\n",
+               ist->file_index, ist->st->index, ist->dec->name, ist->dec_ctx->thread_count,
+               ist->dec_ctx->active_thread_type == FF_THREAD_FRAME ? ", frame threading" :
+               ist->dec_ctx->active_thread_type == FF_THREAD_SLICE ? ", slice threading" : "");
+    }
+    if (!nb_decoded) {
+        av_log(NULL, AV_LOG_FATAL, "-decode_bench selects no audio or video stream\n");
+        return 1;
+    }
+
+    phases[0].start = get_benchmark_time_stamps();
+    for (i = 0; i < nb_input_files && !received_sigterm; i++) {
+        InputFile *f = input_files[i];
+
+        while (!received_sigterm) {
+            InputStream *ist;
+
+            if (!phase && av_gettime_relative() - phases[0].start.real_usec >= decode_bench_warmup) {
+                phases[0].end    = get_benchmark_time_stamps();
+                phases[0].maxrss = getmaxrss();
+                phases[1].start  = phases[0].end;
+                phase = 1;
+            }
+
+            ret = av_read_frame(f->ctx, pkt);
+            if (ret == AVERROR(EAGAIN)) {
+                av_usleep(10000);
+                continue;
+            }
+            if (ret < 0)
+                break;
+            ist = input_streams[f->ist_index + pkt->stream_index];
+            if (ist->decoding_needed) {
+                nb_bytes[f->ist_index + pkt->stream_index][phase] += pkt->size;
+                ret = decode_bench_stream(ist, pkt, frame,
+                                          &nb_frames[f->ist_index + pkt->stream_index][phase]);
+            }
+            av_packet_unref(pkt);
+            if (ret < 0)
+                break;
+        }
+        if (ret < 0 && ret != AVERROR_EOF) {
+            av_log(NULL, AV_LOG_ERROR, "Error reading %s: %s\n", f->ctx->url, av_err2str(ret));
+            if (exit_on_error)
+                break;
+        }
+        ret = 0;
+
+        /* flush the decoders of the file */
+        for (j = 0; j < f->nb_streams; j++) {
+            InputStream *ist = input_streams[f->ist_index + j];
+            if (ist->decoding_needed &&
+                (ret = decode_bench_stream(ist, NULL, frame, &nb_frames[f->ist_index + j][phase])) < 0)
+                break;
+        }
+        if (ret < 0)
+            break;
+    }
+    phases[phase].end    = get_benchmark_time_stamps();
+    phases[phase].maxrss = getmaxrss();
+
+    decode_bench_report("warm-up", &phases[0], nb_frames, nb_bytes, 0, nb_threads);
+    decode_bench_report("steady state", &phases[1], nb_frames, nb_bytes, 1, nb_threads);
+
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    av_free(nb_frames);
+    av_free(nb_bytes);
+    if (received_sigterm)
+        return 255;
+    return ret < 0 || (exit_on_error && decode_error_stat[1]);
+}
+
+/* run what the parsed options ask for, for the command line or a worker job */
+static void run_command(void)
+{
+    int ret;
+
+    if (worker_jobs > 0)
+        exit_program(run_worker());
+    if (encode_chunks > 1)
+        exit_program(run_chunked());
+    if (decode_bench) {
+        if (nb_output_files) {
+            av_log(NULL, AV_LOG_FATAL, "-decode_bench cannot be used with output files\n");
+            exit_program(1);
+        }
+        exit_program(run_decode_bench());
+    }
+    if (fast_remux) {
+        ret = mov_fast_remux();
+        if (ret)
+            exit_program(ret < 0);
+    }
+
+    run_transcode();
+}
+
+int main(int argc, char **argv)
+{
+    int ret;
+
+    init_dynload();
+
+    register_exit(ffmpeg_cleanup);
+
+    setvbuf(stderr,NULL,_IONBF,0); /* win32 runtime needs this */
+
+    av_log_set_flags(AV_LOG_SKIP_REPEATED);
+    parse_loglevel(argc, argv, options);
+
+    if(argc>1 && !strcmp(argv[1], "-d")){
+        run_as_daemon=1;
+        av_log_set_callback(log_callback_null);
+        argc--;
+        argv++;
+    }
+
+#if CONFIG_AVDEVICE
+    avdevice_register_all();
+#endif
+    avformat_network_init();
+
+    show_banner(argc, argv, options);
+
+    /* parse options and open all input/output files */
+    ret = ffmpeg_parse_options(argc, argv);
+    if (ret < 0)
+        exit_program(1);
+
+    run_command();
     return main_return_code;
 }
@@ -21,6 +21,7 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <signal.h>
@@ -122,6 +123,7 @@ typedef struct OptionsContext {
     float readrate;
     int accurate_seek;
     int thread_queue_size;
+    int64_t thread_queue_bytes;
 
     SpecifierOpt *ts_scale;
     int        nb_ts_scale;
@@ -152,6 +154,8 @@ typedef struct OptionsContext {
     int64_t recording_time;
     int64_t stop_time;
     uint64_t limit_filesize;
+    int64_t mux_thread_queue_size;
+    int64_t mux_thread_queue_duration;
     float mux_preload;
     float mux_max_delay;
     int shortest;
@@ -202,6 +206,8 @@ typedef struct OptionsContext {
     int        nb_copy_initial_nonkeyframes;
     SpecifierOpt *copy_prior_start;
     int        nb_copy_prior_start;
+    SpecifierOpt *smart_cut;
+    int        nb_smart_cut;
     SpecifierOpt *filters;
     int        nb_filters;
     SpecifierOpt *filter_scripts;
@@ -220,6 +226,8 @@ typedef struct OptionsContext {
     int        nb_max_muxing_queue_size;
     SpecifierOpt *muxing_queue_data_threshold;
     int        nb_muxing_queue_data_threshold;
+    SpecifierOpt *enc_thread_queue_size;
+    int        nb_enc_thread_queue_size;
     SpecifierOpt *guess_layout_max;
     int        nb_guess_layout_max;
     SpecifierOpt *apad;
@@ -238,6 +246,29 @@ typedef struct OptionsContext {
     int        nb_autoscale;
 } OptionsContext;
 
+#define PROFILE_HIST_SIZE 32
+
+/* time spent in one processing stage, see -profile_report */
+typedef struct ProfileStage {
+    int64_t nb_calls;
+    int64_t nb_frames;       /* frames or packets produced */
+    int64_t wall_time;       /* in microseconds */
+    int64_t cpu_time;        /* CPU time of the calling thread, in microseconds */
+    int64_t max_latency;     /* longest call, in microseconds */
+    /* calls taking less than 1us, [1us, 2us), [2us, 4us), ... */
+    int64_t latency_hist[PROFILE_HIST_SIZE];
+} ProfileStage;
+
+/* measures one call to a stage, possibly made of several intervals */
+typedef struct ProfileTimer {
+    int64_t wall_time;
+    int64_t cpu_time;
+    int64_t wall_start;
+    int64_t cpu_start;
+} ProfileTimer;
+
+typedef struct SmartCutContext SmartCutContext;
+
 typedef struct InputFilter {
     AVFilterContext    *filter;
     struct InputStream *ist;
@@ -297,6 +328,8 @@ typedef struct FilterGraph {
     int          nb_inputs;
     OutputFilter **outputs;
     int         nb_outputs;
+
+    ProfileStage prof_filter;
 } FilterGraph;
 
 typedef struct InputStream {
@@ -396,6 +429,8 @@ typedef struct InputStream {
     int nb_dts_buffer;
 
     int got_output;
+
+    ProfileStage prof_decode;
 } InputStream;
 
 typedef struct InputFile {
@@ -422,12 +457,21 @@ typedef struct InputFile {
 
     AVPacket *pkt;
 
+    ProfileStage prof_demux;
+
 #if HAVE_THREADS
     AVThreadMessageQueue *in_thread_queue;
     pthread_t thread;           /* thread reading from this file */
     int non_blocking;           /* reading packets from the thread should not block */
     int joined;                 /* the thread has been joined */
     int thread_queue_size;      /* maximum number of queued packets */
+    int64_t thread_queue_bytes; /* maximum number of queued bytes */
+    pthread_mutex_t readahead_lock;
+    pthread_cond_t readahead_cond;
+    int64_t readahead_bytes;    /* bytes currently queued by the reading thread */
+    int64_t readahead_budget;   /* current limit, raised up to thread_queue_bytes */
+    int readahead_full;         /* the reader waited on the budget since the queue last ran dry */
+    int readahead_stop;
 #endif
 } InputFile;
 
@@ -536,6 +580,8 @@ typedef struct OutputStream {
     const char *attachment_filename;
     int copy_initial_nonkeyframes;
     int copy_prior_start;
+    int smart_cut;
+    SmartCutContext *smart_cut_ctx;
     char *disposition;
 
     int keep_pix_fmt;
@@ -566,11 +612,37 @@ typedef struct OutputStream {
     /* Threshold after which max_muxing_queue_size will be in effect */
     size_t muxing_queue_data_threshold;
 
+    int enc_thread_queue_size;   /* maximum number of frames queued for the encoder thread,
+                                    0 to encode in the main thread */
+#if HAVE_THREADS
+    AVThreadMessageQueue *enc_queue;
+    pthread_t enc_thread;        /* thread running the encoder of this stream */
+    /*
+     * The main thread owns the finished flags and recording times, the encoder
+     * thread only reports the changes it wants, see sync_encoder_threads().
+     */
+    atomic_int enc_finished;        /* flags to set on this stream */
+    atomic_int enc_finished_others; /* flags to set on all other streams */
+    int64_t enc_end_time;           /* -shortest end, valid once ENCODER_FINISHED is reported */
+    int64_t enc_recording_time;     /* recording time of the file when the frame was queued */
+    int     enc_error;              /* error the encoder thread stopped on, read after join */
+    /*
+     * frame_number and sync_opts as of the last frame done by the encoder
+     * thread, copied under output_lock for the main thread, which must not
+     * read the originals while the thread runs, see get_output_stream_status().
+     */
+    int     enc_frame_number;
+    int64_t enc_sync_opts;
+#endif
+
     /* packet picture type */
     int pict_type;
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+    ProfileStage prof_encode;
+    ProfileStage prof_bsf;
 } OutputStream;
 
 typedef struct OutputFile {
@@ -584,6 +656,26 @@ typedef struct OutputFile {
     int shortest;
 
     int header_written;
+
+    /* packets are handed to a muxing thread when these are non-zero */
+    int64_t mux_thread_queue_size;     /* maximum bytes queued for the muxing thread */
+    int64_t mux_thread_queue_duration; /* maximum dts span queued, in AV_TIME_BASE units */
+#if HAVE_THREADS
+    pthread_t mux_thread;
+    pthread_mutex_t mux_lock;
+    pthread_cond_t mux_cond;
+    AVFifoBuffer *mux_queue; /* MuxQueueEntry waiting for the muxing thread */
+    int mux_eof;             /* no more packets will be queued */
+    int mux_error;           /* first error returned by the muxer */
+#endif
+    int mux_thread_running;
+    int64_t mux_queue_size;          /* bytes currently queued */
+    int64_t mux_queue_peak_size;     /* high-water marks of the muxing queue */
+    int64_t mux_queue_peak_duration;
+    int     mux_queue_peak_packets;
+    int64_t bytes_written;           /* output position as last seen by the muxing thread */
+
+    ProfileStage prof_mux;
 } OutputFile;
 
 extern InputStream **input_streams;
@@ -644,6 +736,17 @@ extern char *qsv_device;
 #endif
 extern HWDevice *filter_hw_device;
 
+extern AVIOContext *profile_avio;
+extern int64_t profile_report_period;
+
+extern int worker_jobs;
+extern char *worker_socket;
+extern int worker_reply_fd;
+extern int encode_chunks;
+extern int fast_remux;
+extern char *decode_bench;
+extern int64_t decode_bench_warmup;
+
 
 void term_init(void);
 void term_exit(void);
@@ -664,6 +767,7 @@ int init_complex_filtergraph(FilterGraph *fg);
 void sub2video_update(InputStream *ist, int64_t heartbeat_pts, AVSubtitle *sub);
 
 int ifilter_parameters_from_frame(InputFilter *ifilter, const AVFrame *frame);
+int filter_outputs_reach_scale(const AVFilterContext *f);
 
 int ffmpeg_parse_options(int argc, char **argv);
 
@@ -678,6 +782,22 @@ int hw_device_setup_for_decode(InputStream *ist);
 int hw_device_setup_for_encode(OutputStream *ost);
 int hw_device_setup_for_filter(FilterGraph *fg);
 
+void profile_timer_start(ProfileTimer *t);
+void profile_timer_stop(ProfileTimer *t);
+void profile_stage_add(ProfileStage *s, ProfileTimer *t, int nb_frames);
+void profile_report_write(int is_last, int64_t timer_start, int64_t cur_time);
+void profile_report_close(void);
+
+int  smart_cut_init(OutputStream *ost, InputStream *ist, int64_t cut_pts, int64_t end_pts);
+int  smart_cut_send_packet(SmartCutContext *sc, const AVPacket *pkt);
+int  smart_cut_finished(SmartCutContext *sc);
+/* the packet belongs to sc and is valid until the next call */
+AVPacket *smart_cut_receive_packet(SmartCutContext *sc);
+void smart_cut_free(SmartCutContext **sc);
+
+/* returns 1 if the output was written, 0 to use the normal path */
+int mov_fast_remux(void);
+
 int hwaccel_decode_init(AVCodecContext *avctx);
 
 #endif /* FFTOOLS_FFMPEG_H */
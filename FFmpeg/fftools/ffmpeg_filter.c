@@ -416,6 +416,81 @@ static int insert_filter(AVFilterContext **last_filter, int *pad_idx,
     return 0;
 }
 
+/*
+ * Whether all video frames leaving f reach a scale filter through filters
+ * that pass them on unchanged. The scale filter reconfigures itself when the
+ * size or pixel format of its input changes, so the graph does not need to
+ * be rebuilt for such a change.
+ */
+int filter_outputs_reach_scale(const AVFilterContext *f)
+{
+    static const char *const passthrough[] = {
+        "copy", "format", "fps", "null", "setpts", "setsar", "settb", "split", "trim",
+    };
+    int i, j;
+
+    if (!f->nb_outputs)
+        return 0;
+
+    for (i = 0; i < f->nb_outputs; i++) {
+        const AVFilterContext *dst = f->outputs[i]->dst;
+
+        if (!strcmp(dst->filter->name, "scale"))
+            continue;
+        for (j = 0; j < FF_ARRAY_ELEMS(passthrough); j++)
+            if (!strcmp(dst->filter->name, passthrough[j]))
+                break;
+        if (j == FF_ARRAY_ELEMS(passthrough) || !filter_outputs_reach_scale(dst))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Whether changes of the size or pixel format of a video input are left to
+ * the scale filters of the graph instead of rebuilding it (-reinit_filter 2).
+ */
+static int scale_on_input_changes(FilterGraph *fg)
+{
+    int i;
+
+    for (i = 0; i < fg->nb_inputs; i++)
+        if (fg->inputs[i]->ist->reinit_filters == 2)
+            return 1;
+    return 0;
+}
+
+/*
+ * With -reinit_filter 2, make sure the frames of a video input reach a scale
+ * filter before any filter that would have to be rebuilt for a new size or
+ * pixel format, such as yadif. Otherwise a scaler keeping the size the graph is
+ * configured with is added after the buffer source, so that the rest of the
+ * graph, other inputs included, keeps its state across such changes.
+ */
+static int insert_input_scaler(FilterGraph *fg, InputFilter *ifilter)
+{
+    AVFilterContext *scaler;
+    char name[255], args[512];
+    int ret;
+
+    if (ifilter->ist->reinit_filters != 2 || ifilter->type != AVMEDIA_TYPE_VIDEO ||
+        ifilter->hw_frames_ctx || filter_outputs_reach_scale(ifilter->filter))
+        return 0;
+
+    snprintf(name, sizeof(name), "scaler_in_%d_%d", ifilter->ist->file_index,
+             ifilter->ist->st->index);
+    snprintf(args, sizeof(args), "%d:%d", ifilter->width, ifilter->height);
+    // the options the graph parser gives the scale filters of the graph
+    if (fg->graph->scale_sws_opts)
+        av_strlcatf(args, sizeof(args), ":%s", fg->graph->scale_sws_opts);
+    ret = avfilter_graph_create_filter(&scaler, avfilter_get_by_name("scale"),
+                                       name, args, NULL, fg->graph);
+    if (ret < 0)
+        return ret;
+
+    return avfilter_insert_filter(ifilter->filter->outputs[0], scaler, 0, 0);
+}
+
 static int configure_output_video_filter(FilterGraph *fg, OutputFilter *ofilter, AVFilterInOut *out)
 {
     char *pix_fmts;
@@ -434,13 +509,18 @@ static int configure_output_video_filter(FilterGraph *fg, OutputFilter *ofilter,
     if (ret < 0)
         return ret;
 
-    if ((ofilter->width || ofilter->height) && ofilter->ost->autoscale) {
+    if ((ofilter->width || ofilter->height || scale_on_input_changes(fg)) &&
+        ofilter->ost->autoscale) {
         char args[255];
         AVFilterContext *filter;
         AVDictionaryEntry *e = NULL;
 
-        snprintf(args, sizeof(args), "%d:%d",
-                 ofilter->width, ofilter->height);
+        // without a size, the scaler only keeps the output size constant
+        if (ofilter->width || ofilter->height)
+            snprintf(args, sizeof(args), "%d:%d",
+                     ofilter->width, ofilter->height);
+        else
+            av_strlcpy(args, "iw:ih", sizeof(args));
 
         while ((e = av_dict_get(ost->sws_dict, "", e,
                                 AV_DICT_IGNORE_SUFFIX))) {
@@ -990,6 +1070,7 @@ int configure_filtergraph(FilterGraph *fg)
     cleanup_filtergraph(fg);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    fg->graph->collect_stats = !!profile_avio;
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
@@ -1075,6 +1156,10 @@ int configure_filtergraph(FilterGraph *fg)
         configure_output_filter(fg, fg->outputs[i], cur);
     avfilter_inout_free(&outputs);
 
+    for (i = 0; i < fg->nb_inputs; i++)
+        if ((ret = insert_input_scaler(fg, fg->inputs[i])) < 0)
+            goto fail;
+
     if (!auto_conversion_filters)
         avfilter_graph_set_auto_convert(fg->graph, AVFILTER_AUTO_CONVERT_NONE);
     if ((ret = avfilter_graph_config(fg->graph, NULL)) < 0)
@@ -0,0 +1,892 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Remux of a MP4/MOV file into a MP4/MOV file without touching the samples:
+ * the moov box is rewritten with the chunk offsets moved to the new position
+ * of the media data, and the other top level boxes are copied in large
+ * ranges, with copy_file_range() where the system has it.
+ *
+ * Only plain stream copies qualify. Tracks can be dropped, the metadata that
+ * lives in the iTunes ilst box and the track languages can be edited, and the
+ * moov box can be moved in front of the media data with -movflags +faststart.
+ * Everything else is left to the normal remuxing path.
+ */
+
+#include "config.h"
+
+#if HAVE_COPY_FILE_RANGE
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <stdarg.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/intreadwrite.h"
+#include "libavformat/avformat.h"
+
+#include "ffmpeg.h"
+
+#define MOV_REMUX_FALLBACK  1
+#define MOV_REMUX_BUF_SIZE  (4 << 20)
+
+typedef struct MovRemuxBox {
+    uint32_t type;
+    int64_t  pos;       ///< position of the box in the input
+    int64_t  size;      ///< size of the box, header included
+    int64_t  new_pos;   ///< position of the box in the output
+} MovRemuxBox;
+
+typedef struct MovRemuxContext {
+    InputFile   *f;
+    OutputFile  *of;
+    AVIOContext *in;
+    int in_fd, out_fd;
+
+    MovRemuxBox *boxes;
+    int nb_boxes;
+    int *order;             ///< output order of the boxes
+    int moov;               ///< index of the moov box in boxes
+    uint8_t *moov_buf;      ///< moov box of the input, header excluded
+    int moov_size;
+
+    int nb_traks;
+    int *keep;              ///< per trak, whether it is kept in the output
+    int *lang;              ///< per trak, new mdhd language code or -1
+    int trak;               ///< number of traks met, the last one is being written
+    int dropped;            ///< some traks are not in the output
+    int write_ilst;         ///< the ilst box is rebuilt from the output metadata
+    int faststart;
+    int co64;               ///< write all chunk offsets on 64 bits
+
+    uint8_t *buf;
+    int64_t copied;
+} MovRemuxContext;
+
+/* string tags of the ilst box, as read by the mov demuxer */
+static const struct {
+    uint32_t tag;
+    const char *key;
+} ilst_tags[] = {
+    { MKTAG(0xa9,'n','a','m'), "title"        },
+    { MKTAG(0xa9,'A','R','T'), "artist"       },
+    { MKTAG('a','A','R','T'),  "album_artist" },
+    { MKTAG(0xa9,'w','r','t'), "composer"     },
+    { MKTAG(0xa9,'a','l','b'), "album"        },
+    { MKTAG(0xa9,'d','a','y'), "date"         },
+    { MKTAG(0xa9,'t','o','o'), "encoder"      },
+    { MKTAG(0xa9,'c','m','t'), "comment"      },
+    { MKTAG(0xa9,'g','e','n'), "genre"        },
+    { MKTAG('c','p','r','t'),  "copyright"    },
+    { MKTAG(0xa9,'g','r','p'), "grouping"     },
+    { MKTAG(0xa9,'l','y','r'), "lyrics"       },
+    { MKTAG('d','e','s','c'),  "description"  },
+    { MKTAG('l','d','e','s'),  "synopsis"     },
+    { MKTAG('t','v','s','h'),  "show"         },
+    { MKTAG('t','v','e','n'),  "episode_id"   },
+    { MKTAG('t','v','n','n'),  "network"      },
+    { MKTAG('k','e','y','w'),  "keywords"     },
+};
+
+/* global metadata that the output does not need to carry over */
+static const char *const dropped_keys[] = {
+    "creation_time", "major_brand", "minor_version", "compatible_brands", "duration",
+};
+
+static int fallback(const char *fmt, ...)
+{
+    va_list vl;
+    av_log(NULL, AV_LOG_INFO, "Using the normal remuxing path: ");
+    va_start(vl, fmt);
+    av_vlog(NULL, AV_LOG_INFO, fmt, vl);
+    va_end(vl);
+    return MOV_REMUX_FALLBACK;
+}
+
+static int ilst_tag_index(uint32_t tag, const char *key)
+{
+    int i;
+    for (i = 0; i < FF_ARRAY_ELEMS(ilst_tags); i++)
+        if (key ? !strcmp(ilst_tags[i].key, key) : ilst_tags[i].tag == tag)
+            return i;
+    return -1;
+}
+
+static int is_file_url(const char *url)
+{
+    const char *proto = avio_find_protocol_name(url);
+    return proto && !strcmp(proto, "file");
+}
+
+#if HAVE_COPY_FILE_RANGE
+static const char *file_path(const char *url)
+{
+    av_strstart(url, "file:", &url);
+    return url;
+}
+#endif
+
+/**
+ * Compare two metadata dictionaries. Returns 0 if they are equal, 1 if they
+ * only differ in tags that can be rewritten, and the first other key that
+ * differs in *key otherwise.
+ */
+static int compare_metadata(AVDictionary *in, AVDictionary *out, int global,
+                            const char **key)
+{
+    const AVDictionaryEntry *e = NULL, *o;
+    int i, changed = 0;
+
+    while ((e = av_dict_get(out, "", e, AV_DICT_IGNORE_SUFFIX))) {
+        o = av_dict_get(in, e->key, NULL, AV_DICT_MATCH_CASE);
+        if (o && !strcmp(o->value, e->value))
+            continue;
+        if ((global  && ilst_tag_index(0, e->key) < 0) ||
+            (!global && strcmp(e->key, "language"))) {
+            *key = e->key;
+            return -1;
+        }
+        changed = 1;
+    }
+    while ((e = av_dict_get(in, "", e, AV_DICT_IGNORE_SUFFIX))) {
+        if (av_dict_get(out, e->key, NULL, AV_DICT_MATCH_CASE))
+            continue;
+        for (i = 0; global && i < FF_ARRAY_ELEMS(dropped_keys); i++)
+            if (!strcmp(e->key, dropped_keys[i]))
+                break;
+        if (global && i < FF_ARRAY_ELEMS(dropped_keys))
+            continue;
+        if (!global || ilst_tag_index(0, e->key) < 0) {
+            *key = e->key;
+            return -1;
+        }
+        changed = 1;
+    }
+    return changed;
+}
+
+static int parse_movflags(MovRemuxContext *mr, const char *flags)
+{
+    while (*flags) {
+        int enable = *flags != '-';
+        size_t len;
+        if (*flags == '+' || *flags == '-')
+            flags++;
+        len = strcspn(flags, "+-");
+        if (len != 9 || strncmp(flags, "faststart", len))
+            return fallback("-movflags %.*s is not supported\n", (int)len, flags);
+        mr->faststart = enable;
+        flags += len;
+    }
+    return 0;
+}
+
+static int check_streams(MovRemuxContext *mr)
+{
+    OutputFile *of = mr->of;
+    int i, last = -1;
+
+    for (i = 0; i < of->ctx->nb_streams; i++) {
+        OutputStream *ost = output_streams[of->ost_index + i];
+        InputStream  *ist;
+        const AVDictionaryEntry *in_lang, *out_lang;
+        const char *key;
+        int idx;
+
+        if (ost->source_index < 0)
+            return fallback("output stream #%d has no input stream\n", i);
+        ist = input_streams[ost->source_index];
+        idx = ist->st->index;
+        if (!ost->stream_copy)
+            return fallback("output stream #%d is not a stream copy\n", i);
+        if (idx >= mr->nb_traks)
+            return fallback("input stream #%d is not a track\n", idx);
+        if (idx <= last)
+            return fallback("the input streams are reordered or duplicated\n");
+        if (ost->bsf_ctx || ost->enc_ctx->codec_tag || ost->frame_rate.num ||
+            ost->frame_aspect_ratio.num || ost->max_frames != INT64_MAX ||
+            ost->disposition || ost->smart_cut || ist->ts_scale != 1.0)
+            return fallback("output stream #%d modifies the packets or parameters\n", i);
+        if (compare_metadata(ist->st->metadata, ost->st->metadata, 0, &key) < 0)
+            return fallback("stream metadata %s is changed\n", key);
+
+        in_lang  = av_dict_get(ist->st->metadata, "language", NULL, 0);
+        out_lang = av_dict_get(ost->st->metadata, "language", NULL, 0);
+        if (out_lang && (!in_lang || strcmp(in_lang->value, out_lang->value))) {
+            const char *l = out_lang->value;
+            if (strlen(l) != 3 || l[0] < 'a' || l[0] > 'z' ||
+                l[1] < 'a' || l[1] > 'z' || l[2] < 'a' || l[2] > 'z')
+                return fallback("language %s cannot be written\n", l);
+            mr->lang[idx] = (l[0] - 0x60) << 10 | (l[1] - 0x60) << 5 | (l[2] - 0x60);
+        } else if (!out_lang && in_lang) {
+            mr->lang[idx] = (('u' - 0x60) << 10) | (('n' - 0x60) << 5) | ('d' - 0x60);
+        }
+
+        mr->keep[idx] = 1;
+        last = idx;
+    }
+    for (i = 0; i < mr->nb_traks; i++)
+        mr->dropped |= !mr->keep[i];
+    return 0;
+}
+
+static int check_files(MovRemuxContext *mr)
+{
+    InputFile  *f  = mr->f;
+    OutputFile *of = mr->of;
+    const AVDictionaryEntry *e = NULL, *brand;
+    const char *oformat = of->ctx->oformat->name;
+    const char *key;
+    int ret;
+
+    if (!av_match_name("mov", f->ctx->iformat->name) ||
+        (strcmp(oformat, "mov") && strcmp(oformat, "mp4")))
+        return fallback("not a MP4/MOV to MP4/MOV remux\n");
+    brand = av_dict_get(f->ctx->metadata, "major_brand", NULL, 0);
+    if (!strcmp(oformat, "mov") != (brand && !strcmp(brand->value, "qt  ")))
+        return fallback("the output format does not match the brand of the input\n");
+    if (!is_file_url(f->ctx->url) || !is_file_url(of->ctx->url) || !of->ctx->pb ||
+        !(of->ctx->pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return fallback("the input and output must be local files\n");
+    if (f->start_time != AV_NOPTS_VALUE || f->recording_time != INT64_MAX ||
+        of->start_time != AV_NOPTS_VALUE || of->recording_time != INT64_MAX ||
+        f->input_ts_offset || f->loop || of->shortest || of->limit_filesize != UINT64_MAX)
+        return fallback("the timestamps or the duration are changed\n");
+    if (of->ctx->nb_chapters != f->ctx->nb_chapters)
+        return fallback("the chapters are changed\n");
+
+    while ((e = av_dict_get(of->opts, "", e, AV_DICT_IGNORE_SUFFIX))) {
+        if (strcmp(e->key, "movflags"))
+            return fallback("muxer option %s is not supported\n", e->key);
+        if ((ret = parse_movflags(mr, e->value)))
+            return ret;
+    }
+
+    ret = compare_metadata(f->ctx->metadata, of->ctx->metadata, 1, &key);
+    if (ret < 0)
+        return fallback("metadata %s is changed\n", key);
+    mr->write_ilst = ret;
+    return 0;
+}
+
+static int read_boxes(MovRemuxContext *mr)
+{
+    int64_t file_size = avio_size(mr->in), pos = 0;
+    int has_mdat = 0, ret;
+
+    if (file_size < 0)
+        return file_size;
+    mr->moov = -1;
+    while (pos < file_size) {
+        MovRemuxBox *box;
+        uint8_t hdr[16];
+        int hdr_size = 8;
+
+        avio_seek(mr->in, pos, SEEK_SET);
+        if (avio_read(mr->in, hdr, 8) != 8)
+            return AVERROR_INVALIDDATA;
+        ret = av_reallocp_array(&mr->boxes, mr->nb_boxes + 1, sizeof(*mr->boxes));
+        if (ret < 0)
+            return ret;
+        box = &mr->boxes[mr->nb_boxes++];
+        box->pos  = pos;
+        box->size = AV_RB32(hdr);
+        box->type = AV_RL32(hdr + 4);
+        if (box->size == 1) {
+            if (avio_read(mr->in, hdr + 8, 8) != 8)
+                return AVERROR_INVALIDDATA;
+            box->size = AV_RB64(hdr + 8);
+            hdr_size  = 16;
+        } else if (!box->size) {
+            box->size = file_size - pos;
+        }
+        if (box->size < hdr_size || box->size > file_size - pos)
+            return fallback("truncated or invalid box at %"PRId64"\n", pos);
+
+        switch (box->type) {
+        case MKTAG('m','o','o','f'):
+        case MKTAG('m','f','r','a'):
+        case MKTAG('s','i','d','x'):
+            return fallback("fragmented input\n");
+        case MKTAG('m','d','a','t'):
+            has_mdat = 1;
+            break;
+        case MKTAG('m','e','t','a'):
+            /* its iloc box would point to the items at their old position */
+            return fallback("top level meta box\n");
+        case MKTAG('m','o','o','v'):
+            if (mr->moov >= 0)
+                return fallback("several moov boxes\n");
+            if (box->size - hdr_size > INT_MAX / 2)
+                return fallback("moov box too large\n");
+            mr->moov      = mr->nb_boxes - 1;
+            mr->moov_size = box->size - hdr_size;
+            mr->moov_buf  = av_malloc(mr->moov_size);
+            if (!mr->moov_buf)
+                return AVERROR(ENOMEM);
+            if (avio_read(mr->in, mr->moov_buf, mr->moov_size) != mr->moov_size)
+                return AVERROR_INVALIDDATA;
+            break;
+        }
+        pos += box->size;
+    }
+    if (mr->moov < 0 || !has_mdat)
+        return fallback("no moov or mdat box\n");
+    return 0;
+}
+
+/* iterate over the boxes in buf, stopping at the end or at an invalid box */
+static int next_box(const uint8_t *buf, int size, int *pos, uint32_t *type,
+                    const uint8_t **payload, int *payload_size)
+{
+    int64_t box_size;
+    int hdr = 8;
+
+    if (size - *pos < 8)
+        return 0;
+    box_size = AV_RB32(buf + *pos);
+    *type    = AV_RL32(buf + *pos + 4);
+    if (box_size == 1) {
+        if (size - *pos < 16)
+            return AVERROR_INVALIDDATA;
+        box_size = AV_RB64(buf + *pos + 8);
+        hdr      = 16;
+    } else if (!box_size) {
+        box_size = size - *pos;
+    }
+    if (box_size < hdr || box_size > size - *pos)
+        return AVERROR_INVALIDDATA;
+    *payload      = buf + *pos + hdr;
+    *payload_size = box_size - hdr;
+    *pos         += box_size;
+    return 1;
+}
+
+static int count_traks(MovRemuxContext *mr)
+{
+    const uint8_t *payload;
+    uint32_t type;
+    int pos = 0, size, ret;
+
+    while ((ret = next_box(mr->moov_buf, mr->moov_size, &pos, &type, &payload, &size)) > 0) {
+        if (type == MKTAG('t','r','a','k'))
+            mr->nb_traks++;
+        else if (type == MKTAG('m','v','e','x'))
+            return fallback("fragmented input\n");
+    }
+    return ret;
+}
+
+static void update_size(AVIOContext *pb, int64_t pos)
+{
+    int64_t cur = avio_tell(pb);
+    avio_seek(pb, pos, SEEK_SET);
+    avio_wb32(pb, cur - pos);
+    avio_seek(pb, cur, SEEK_SET);
+}
+
+/* map a position in the input to the output, or return -1 */
+static int64_t map_offset(MovRemuxContext *mr, int64_t pos)
+{
+    int i;
+    for (i = 0; i < mr->nb_boxes; i++) {
+        const MovRemuxBox *box = &mr->boxes[i];
+        if (i != mr->moov && pos >= box->pos && pos < box->pos + box->size)
+            return pos - box->pos + box->new_pos;
+    }
+    return -1;
+}
+
+static int write_chunk_offsets(MovRemuxContext *mr, AVIOContext *pb, uint32_t type,
+                               const uint8_t *buf, int size)
+{
+    int entry_size = type == MKTAG('c','o','6','4') ? 8 : 4;
+    unsigned i, nb_entries;
+
+    if (size < 8)
+        return AVERROR_INVALIDDATA;
+    nb_entries = AV_RB32(buf + 4);
+    if (nb_entries > (size - 8) / entry_size)
+        return AVERROR_INVALIDDATA;
+
+    avio_wb32(pb, 16 + (int64_t)nb_entries * (mr->co64 ? 8 : 4));
+    avio_wl32(pb, mr->co64 ? MKTAG('c','o','6','4') : MKTAG('s','t','c','o'));
+    avio_wb32(pb, 0); /* version & flags */
+    avio_wb32(pb, nb_entries);
+    for (i = 0; i < nb_entries; i++) {
+        int64_t pos = entry_size == 8 ? AV_RB64(buf + 8 + 8 * i) : AV_RB32(buf + 8 + 4 * i);
+        pos = map_offset(mr, pos);
+        if (pos < 0)
+            return fallback("chunk offset outside of the file\n");
+        if (mr->co64)
+            avio_wb64(pb, pos);
+        else
+            avio_wb32(pb, pos);
+    }
+    return 0;
+}
+
+/* the auxiliary information offsets of a non-fragmented file are file offsets */
+static int write_saio(MovRemuxContext *mr, AVIOContext *pb,
+                      const uint8_t *buf, int size)
+{
+    int version, entry_size, hdr = 8;
+    unsigned i, nb_entries;
+
+    if (size < 8)
+        return AVERROR_INVALIDDATA;
+    version    = buf[0];
+    entry_size = version ? 8 : 4;
+    if (AV_RB24(buf + 1) & 1) /* aux_info_type and its parameter */
+        hdr += 8;
+    if (size < hdr)
+        return AVERROR_INVALIDDATA;
+    nb_entries = AV_RB32(buf + hdr - 4);
+    if (nb_entries > (size - hdr) / entry_size)
+        return AVERROR_INVALIDDATA;
+
+    avio_wb32(pb, 8 + hdr + (int64_t)nb_entries * (version || mr->co64 ? 8 : 4));
+    avio_wl32(pb, MKTAG('s','a','i','o'));
+    avio_w8(pb, version || mr->co64);
+    avio_write(pb, buf + 1, hdr - 1);
+    for (i = 0; i < nb_entries; i++) {
+        int64_t pos = version ? AV_RB64(buf + hdr + 8 * i) : AV_RB32(buf + hdr + 4 * i);
+        /* the boxes inside moov move by amounts that are not tracked */
+        pos = map_offset(mr, pos);
+        if (pos < 0)
+            return fallback("auxiliary information offset outside of the copied boxes\n");
+        if (version || mr->co64)
+            avio_wb64(pb, pos);
+        else
+            avio_wb32(pb, pos);
+    }
+    return 0;
+}
+
+static int write_mdhd(MovRemuxContext *mr, AVIOContext *pb,
+                      const uint8_t *buf, int size)
+{
+    int lang_pos = buf[0] == 1 ? 32 : 20;
+
+    if (size < lang_pos + 2)
+        return AVERROR_INVALIDDATA;
+    avio_wb32(pb, 8 + size);
+    avio_wl32(pb, MKTAG('m','d','h','d'));
+    avio_write(pb, buf, lang_pos);
+    avio_wb16(pb, mr->lang[mr->trak - 1]);
+    avio_write(pb, buf + lang_pos + 2, size - lang_pos - 2);
+    return 0;
+}
+
+static int check_dref(const uint8_t *buf, int size)
+{
+    const uint8_t *payload;
+    uint32_t type;
+    int pos = 8, payload_size, ret;
+
+    if (size < 8)
+        return AVERROR_INVALIDDATA;
+    while ((ret = next_box(buf, size, &pos, &type, &payload, &payload_size)) > 0) {
+        /* flag 1: the media data is in the same file */
+        if (payload_size < 4 || !(AV_RB32(payload) & 1))
+            return fallback("external data references\n");
+    }
+    return ret;
+}
+
+/* the item locations of iloc can be file offsets, which are not remapped */
+static int check_meta(const uint8_t *buf, int size)
+{
+    const uint8_t *payload;
+    uint32_t type;
+    /* ISO meta boxes are full boxes, QuickTime ones are not */
+    int pos = size >= 8 && AV_RL32(buf + 4) == MKTAG('h','d','l','r') ? 0 : 4;
+    int payload_size, ret;
+
+    while ((ret = next_box(buf, size, &pos, &type, &payload, &payload_size)) > 0)
+        if (type == MKTAG('i','l','o','c'))
+            return fallback("item locations in a meta box\n");
+    return ret;
+}
+
+/* the meta box holding the output metadata and the unknown items of ilst */
+static void write_meta(MovRemuxContext *mr, AVIOContext *pb,
+                       const uint8_t *ilst, int ilst_size)
+{
+    const uint8_t *payload;
+    int64_t meta_pos = avio_tell(pb), ilst_pos;
+    uint32_t type;
+    int i, pos = 0, size;
+
+    avio_wb32(pb, 0);
+    avio_wl32(pb, MKTAG('m','e','t','a'));
+    avio_wb32(pb, 0);
+    avio_wb32(pb, 33);
+    avio_wl32(pb, MKTAG('h','d','l','r'));
+    avio_wb32(pb, 0);
+    avio_wb32(pb, 0);
+    avio_wl32(pb, MKTAG('m','d','i','r'));
+    avio_wl32(pb, MKTAG('a','p','p','l'));
+    avio_wb32(pb, 0);
+    avio_wb32(pb, 0);
+    avio_w8(pb, 0);
+
+    ilst_pos = avio_tell(pb);
+    avio_wb32(pb, 0);
+    avio_wl32(pb, MKTAG('i','l','s','t'));
+    for (i = 0; i < FF_ARRAY_ELEMS(ilst_tags); i++) {
+        const AVDictionaryEntry *e = av_dict_get(mr->of->ctx->metadata, ilst_tags[i].key, NULL, 0);
+        int len;
+        if (!e || !*e->value)
+            continue;
+        len = strlen(e->value);
+        avio_wb32(pb, 24 + len);
+        avio_wl32(pb, ilst_tags[i].tag);
+        avio_wb32(pb, 16 + len);
+        avio_wl32(pb, MKTAG('d','a','t','a'));
+        avio_wb32(pb, 1); /* UTF-8 */
+        avio_wb32(pb, 0);
+        avio_write(pb, e->value, len);
+    }
+    while (ilst && next_box(ilst, ilst_size, &pos, &type, &payload, &size) > 0)
+        if (ilst_tag_index(type, NULL) < 0)
+            avio_write(pb, payload - 8, size + 8);
+    update_size(pb, ilst_pos);
+    update_size(pb, meta_pos);
+}
+
+static int write_udta(MovRemuxContext *mr, AVIOContext *pb,
+                      const uint8_t *buf, int size)
+{
+    const uint8_t *payload, *ilst = NULL;
+    int64_t udta_pos = avio_tell(pb);
+    uint32_t type;
+    int pos = 0, start = 0, payload_size, ilst_size = 0, ret;
+
+    avio_wb32(pb, 0);
+    avio_wl32(pb, MKTAG('u','d','t','a'));
+    while ((ret = next_box(buf, size, &pos, &type, &payload, &payload_size)) > 0) {
+        if (type == MKTAG('m','e','t','a')) {
+            const uint8_t *child;
+            uint32_t child_type;
+            int child_pos = 4, child_size;
+            while (next_box(payload, payload_size, &child_pos, &child_type, &child, &child_size) > 0) {
+                if (child_type == MKTAG('i','l','s','t')) {
+                    ilst      = child;
+                    ilst_size = child_size;
+                }
+            }
+        } else if (ilst_tag_index(type, NULL) < 0) {
+            avio_write(pb, buf + start, pos - start);
+        }
+        start = pos;
+    }
+    if (ret < 0)
+        return ret;
+    write_meta(mr, pb, ilst, ilst_size);
+    update_size(pb, udta_pos);
+    return 0;
+}
+
+static int write_boxes(MovRemuxContext *mr, AVIOContext *pb, uint32_t parent,
+                       const uint8_t *buf, int size)
+{
+    const uint8_t *payload;
+    uint32_t type;
+    int pos = 0, start = 0, payload_size, has_udta = 0, ret;
+
+    while ((ret = next_box(buf, size, &pos, &type, &payload, &payload_size)) > 0) {
+        int64_t box_pos = avio_tell(pb);
+
+        switch (type) {
+        case MKTAG('t','r','a','k'):
+            if (!mr->keep[mr->trak++])
+                break;
+            /* fall through */
+        case MKTAG('m','d','i','a'):
+        case MKTAG('m','i','n','f'):
+        case MKTAG('s','t','b','l'):
+        case MKTAG('d','i','n','f'):
+            avio_wb32(pb, 0);
+            avio_wl32(pb, type);
+            ret = write_boxes(mr, pb, type, payload, payload_size);
+            if (ret)
+                return ret;
+            update_size(pb, box_pos);
+            break;
+        case MKTAG('s','t','c','o'):
+        case MKTAG('c','o','6','4'):
+            ret = write_chunk_offsets(mr, pb, type, payload, payload_size);
+            if (ret)
+                return ret;
+            break;
+        case MKTAG('s','a','i','o'):
+            ret = write_saio(mr, pb, payload, payload_size);
+            if (ret)
+                return ret;
+            break;
+        case MKTAG('m','d','h','d'):
+            if (mr->lang[mr->trak - 1] >= 0) {
+                ret = write_mdhd(mr, pb, payload, payload_size);
+                if (ret)
+                    return ret;
+                break;
+            }
+            avio_write(pb, buf + start, pos - start);
+            break;
+        case MKTAG('d','r','e','f'):
+            ret = check_dref(payload, payload_size);
+            if (ret)
+                return ret;
+            avio_write(pb, buf + start, pos - start);
+            break;
+        case MKTAG('t','r','e','f'):
+            /* the referenced track may be gone */
+            if (mr->dropped)
+                return fallback("track references with dropped tracks\n");
+            avio_write(pb, buf + start, pos - start);
+            break;
+        case MKTAG('m','e','t','a'):
+            if (parent == MKTAG('m','o','o','v') && mr->write_ilst)
+                return fallback("QuickTime metadata cannot be changed\n");
+            ret = check_meta(payload, payload_size);
+            if (ret)
+                return ret;
+            avio_write(pb, buf + start, pos - start);
+            break;
+        case MKTAG('u','d','t','a'):
+            if (parent == MKTAG('m','o','o','v') && mr->write_ilst) {
+                has_udta = 1;
+                ret = write_udta(mr, pb, payload, payload_size);
+                if (ret)
+                    return ret;
+                break;
+            }
+            /* fall through */
+        default:
+            avio_write(pb, buf + start, pos - start);
+        }
+        start = pos;
+    }
+    if (ret < 0)
+        return ret;
+
+    if (parent == MKTAG('m','o','o','v') && mr->write_ilst && !has_udta) {
+        int64_t udta_pos = avio_tell(pb);
+        avio_wb32(pb, 0);
+        avio_wl32(pb, MKTAG('u','d','t','a'));
+        write_meta(mr, pb, NULL, 0);
+        update_size(pb, udta_pos);
+    }
+    return 0;
+}
+
+/* place the boxes in output order for a moov box of moov_size bytes */
+static int64_t layout_boxes(MovRemuxContext *mr, int64_t moov_size)
+{
+    int64_t pos = 0;
+    int i;
+
+    for (i = 0; i < mr->nb_boxes; i++) {
+        MovRemuxBox *box = &mr->boxes[mr->order[i]];
+        box->new_pos = pos;
+        pos += mr->order[i] == mr->moov ? moov_size : box->size;
+    }
+    return pos;
+}
+
+static int build_moov(MovRemuxContext *mr, uint8_t **moov, int *moov_size)
+{
+    int64_t size = 8 + mr->moov_size, last = -1;
+    int i, ret, pass = 0;
+
+    mr->order = av_malloc_array(mr->nb_boxes, sizeof(*mr->order));
+    if (!mr->order)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < mr->nb_boxes; i++)
+        mr->order[i] = i;
+    if (mr->faststart) {
+        for (i = 0; i < mr->moov && mr->boxes[i].type != MKTAG('m','d','a','t'); i++)
+            ;
+        memmove(mr->order + i + 1, mr->order + i, (mr->moov - i) * sizeof(*mr->order));
+        mr->order[i] = mr->moov;
+    }
+
+    /* the size of the moov box moves the chunks, which may need co64 */
+    while (size != last) {
+        AVIOContext *pb;
+
+        av_freep(moov);
+        if (++pass > 4)
+            return AVERROR_BUG;
+        mr->co64 = layout_boxes(mr, size) > UINT32_MAX;
+        mr->trak = 0;
+        if ((ret = avio_open_dyn_buf(&pb)) < 0)
+            return ret;
+        avio_wb32(pb, 0);
+        avio_wl32(pb, MKTAG('m','o','o','v'));
+        ret = write_boxes(mr, pb, MKTAG('m','o','o','v'), mr->moov_buf, mr->moov_size);
+        update_size(pb, 0);
+        *moov_size = avio_close_dyn_buf(pb, moov);
+        if (ret)
+            return ret;
+        last = size;
+        size = *moov_size;
+    }
+    return 0;
+}
+
+static int copy_range(MovRemuxContext *mr, AVIOContext *pb, int64_t pos, int64_t size)
+{
+#if HAVE_COPY_FILE_RANGE
+    if (mr->in_fd >= 0 && mr->out_fd >= 0) {
+        off_t in_pos = pos, out_pos;
+        int ret;
+
+        avio_flush(pb);
+        out_pos = avio_tell(pb);
+        while (size > 0) {
+            ssize_t n = copy_file_range(mr->in_fd, &in_pos, mr->out_fd, &out_pos,
+                                        FFMIN(size, 1 << 30), 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+                          errno == EOPNOTSUPP)) {
+                /* not between these files, use reads and writes */
+                close(mr->in_fd);
+                mr->in_fd = -1;
+                break;
+            }
+            if (n <= 0)
+                return n ? AVERROR(errno) : AVERROR_INVALIDDATA;
+            size       -= n;
+            mr->copied += n;
+        }
+        pos = in_pos;
+        if ((ret = avio_seek(pb, out_pos, SEEK_SET)) < 0)
+            return ret;
+    }
+#endif
+    if (size > 0 && !mr->buf) {
+        mr->buf = av_malloc(MOV_REMUX_BUF_SIZE);
+        if (!mr->buf)
+            return AVERROR(ENOMEM);
+    }
+    if (size > 0 && avio_seek(mr->in, pos, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    while (size > 0) {
+        int n = avio_read(mr->in, mr->buf, FFMIN(size, MOV_REMUX_BUF_SIZE));
+        if (n <= 0)
+            return n ? n : AVERROR_INVALIDDATA;
+        avio_write(pb, mr->buf, n);
+        size       -= n;
+        mr->copied += n;
+    }
+    return pb->error;
+}
+
+static int write_output(MovRemuxContext *mr, const uint8_t *moov, int moov_size)
+{
+    AVIOContext *pb = mr->of->ctx->pb;
+    int i, ret;
+
+#if HAVE_COPY_FILE_RANGE
+    mr->in_fd  = open(file_path(mr->f->ctx->url),  O_RDONLY);
+    mr->out_fd = open(file_path(mr->of->ctx->url), O_WRONLY);
+#endif
+    for (i = 0; i < mr->nb_boxes; i++) {
+        const MovRemuxBox *box = &mr->boxes[mr->order[i]];
+        if (mr->order[i] == mr->moov) {
+            avio_write(pb, moov, moov_size);
+            continue;
+        }
+        av_log(NULL, AV_LOG_DEBUG, "Copying %s box of %"PRId64" bytes from %"PRId64" to %"PRId64"\n",
+               av_fourcc2str(box->type), box->size, box->pos, box->new_pos);
+        if ((ret = copy_range(mr, pb, box->pos, box->size)) < 0)
+            return ret;
+    }
+    avio_flush(pb);
+    return pb->error;
+}
+
+int mov_fast_remux(void)
+{
+    MovRemuxContext mr = { 0 };
+    uint8_t *moov = NULL;
+    int moov_size = 0, ret;
+
+    if (nb_input_files != 1 || nb_output_files != 1)
+        return fallback("more than one input or output file\n");
+    mr.f      = input_files[0];
+    mr.of     = output_files[0];
+    mr.in_fd  = -1;
+    mr.out_fd = -1;
+
+    if ((ret = check_files(&mr)))
+        goto end;
+    ret = avio_open2(&mr.in, mr.f->ctx->url, AVIO_FLAG_READ, &int_cb, NULL);
+    if (ret < 0)
+        goto end;
+    if ((ret = read_boxes(&mr)) || (ret = count_traks(&mr)))
+        goto end;
+
+    mr.keep = av_calloc(mr.nb_traks, sizeof(*mr.keep));
+    mr.lang = av_malloc_array(mr.nb_traks, sizeof(*mr.lang));
+    if (!mr.keep || !mr.lang) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    memset(mr.lang, -1, mr.nb_traks * sizeof(*mr.lang));
+    if ((ret = check_streams(&mr)) || (ret = build_moov(&mr, &moov, &moov_size)))
+        goto end;
+
+    av_log(NULL, AV_LOG_INFO, "Remuxing %s by copying its boxes%s\n", mr.f->ctx->url,
+           mr.faststart ? ", moov first" : "");
+    ret = write_output(&mr, moov, moov_size);
+    if (ret < 0)
+        goto end;
+    av_log(NULL, AV_LOG_VERBOSE, "%"PRId64" bytes copied, moov box of %d bytes\n",
+           mr.copied, moov_size);
+    ret = 0;
+
+end:
+    if (ret < 0 && ret != AVERROR_EXIT)
+        av_log(NULL, AV_LOG_ERROR, "Box remux of %s failed: %s\n",
+               mr.f ? mr.f->ctx->url : "", av_err2str(ret));
+#if HAVE_COPY_FILE_RANGE
+    if (mr.in_fd >= 0)
+        close(mr.in_fd);
+    if (mr.out_fd >= 0)
+        close(mr.out_fd);
+#endif
+    avio_closep(&mr.in);
+    av_freep(&moov);
+    av_freep(&mr.moov_buf);
+    av_freep(&mr.boxes);
+    av_freep(&mr.order);
+    av_freep(&mr.keep);
+    av_freep(&mr.lang);
+    av_freep(&mr.buf);
+    return ret == MOV_REMUX_FALLBACK ? 0 : ret < 0 ? ret : 1;
+}
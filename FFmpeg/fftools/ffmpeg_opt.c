@@ -81,6 +81,7 @@ static const char *const opt_name_top_field_first[]           = {"top", NULL};
 static const char *const opt_name_presets[]                   = {"pre", "apre", "vpre", "spre", NULL};
 static const char *const opt_name_copy_initial_nonkeyframes[] = {"copyinkfr", NULL};
 static const char *const opt_name_copy_prior_start[]          = {"copypriorss", NULL};
+static const char *const opt_name_smart_cut[]                 = {"smart_cut", NULL};
 static const char *const opt_name_filters[]                   = {"filter", "af", "vf", NULL};
 static const char *const opt_name_filter_scripts[]            = {"filter_script", NULL};
 static const char *const opt_name_reinit_filters[]            = {"reinit_filter", NULL};
@@ -90,6 +91,7 @@ static const char *const opt_name_pass[]                      = {"pass", NULL};
 static const char *const opt_name_passlogfiles[]              = {"passlogfile", NULL};
 static const char *const opt_name_max_muxing_queue_size[]     = {"max_muxing_queue_size", NULL};
 static const char *const opt_name_muxing_queue_data_threshold[] = {"muxing_queue_data_threshold", NULL};
+static const char *const opt_name_enc_thread_queue_size[]     = {"enc_thread_queue_size", NULL};
 static const char *const opt_name_guess_layout_max[]          = {"guess_layout_max", NULL};
 static const char *const opt_name_apad[]                      = {"apad", NULL};
 static const char *const opt_name_discard[]                   = {"discard", NULL};
@@ -174,6 +176,14 @@ int filter_complex_nbthreads = 0;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
 int64_t stats_period = 500000;
+int64_t profile_report_period = 0;
+int worker_jobs = 0;
+char *worker_socket;
+int worker_reply_fd = -1;
+int encode_chunks = 0;
+int fast_remux = 0;
+char *decode_bench = NULL;
+int64_t decode_bench_warmup = 1000000;
 
 
 static int intra_only         = 0;
@@ -229,9 +239,12 @@ static void init_options(OptionsContext *o)
     o->start_time_eof = AV_NOPTS_VALUE;
     o->recording_time = INT64_MAX;
     o->limit_filesize = UINT64_MAX;
+    o->mux_thread_queue_size     = 16 << 20;
+    o->mux_thread_queue_duration = 10 * AV_TIME_BASE;
     o->chapters_input_file = INT_MAX;
     o->accurate_seek  = 1;
     o->thread_queue_size = -1;
+    o->thread_queue_bytes = 32 << 20;
 }
 
 static int show_hwaccels(void *optctx, const char *opt, const char *arg)
@@ -1330,7 +1343,8 @@ static int open_input_file(OptionsContext *o, const char *filename)
     if (!f->pkt)
         exit_program(1);
 #if HAVE_THREADS
-    f->thread_queue_size = o->thread_queue_size;
+    f->thread_queue_size  = o->thread_queue_size;
+    f->thread_queue_bytes = o->thread_queue_bytes;
 #endif
 
     /* check if all codec options have been used */
@@ -1590,6 +1604,7 @@ static OutputStream *new_output_stream(OptionsContext *o, AVFormatContext *oc, e
 
     ost->copy_prior_start = -1;
     MATCH_PER_STREAM_OPT(copy_prior_start, i, ost->copy_prior_start, oc ,st);
+    MATCH_PER_STREAM_OPT(smart_cut, i, ost->smart_cut, oc, st);
 
     MATCH_PER_STREAM_OPT(bitstream_filters, str, bsfs, oc, st);
     if (bsfs && *bsfs) {
@@ -1627,6 +1642,8 @@ static OutputStream *new_output_stream(OptionsContext *o, AVFormatContext *oc, e
     ost->muxing_queue_data_threshold = 50*1024*1024;
     MATCH_PER_STREAM_OPT(muxing_queue_data_threshold, i, ost->muxing_queue_data_threshold, oc, st);
 
+    MATCH_PER_STREAM_OPT(enc_thread_queue_size, i, ost->enc_thread_queue_size, oc, st);
+
     if (oc->oformat->flags & AVFMT_GLOBALHEADER)
         ost->enc_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
@@ -2231,6 +2248,8 @@ static int open_output_file(OptionsContext *o, const char *filename)
     of->recording_time = o->recording_time;
     of->start_time     = o->start_time;
     of->limit_filesize = o->limit_filesize;
+    of->mux_thread_queue_size     = o->mux_thread_queue_size;
+    of->mux_thread_queue_duration = o->mux_thread_queue_duration;
     of->shortest       = o->shortest;
     av_dict_copy(&of->opts, o->g->format_opts, 0);
 
@@ -3471,6 +3490,29 @@ static int opt_progress(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_profile_report(void *optctx, const char *opt, const char *arg)
+{
+    AVIOContext *avio = NULL;
+    int ret;
+
+    if (!strcmp(arg, "-"))
+        arg = "pipe:";
+    ret = avio_open2(&avio, arg, AVIO_FLAG_WRITE, &int_cb, NULL);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to open profile report URL \"%s\": %s\n",
+               arg, av_err2str(ret));
+        return ret;
+    }
+    profile_avio = avio;
+    return 0;
+}
+
+static int opt_profile_report_period(void *optctx, const char *opt, const char *arg)
+{
+    profile_report_period = parse_time_or_die(opt, arg, 1);
+    return 0;
+}
+
 #define OFFSET(x) offsetof(OptionsContext, x)
 const OptionDef options[] = {
     /* main options */
@@ -3518,6 +3560,10 @@ const OptionDef options[] = {
         "record or transcode stop time", "time_stop" },
     { "fs",             HAS_ARG | OPT_INT64 | OPT_OFFSET | OPT_OUTPUT, { .off = OFFSET(limit_filesize) },
         "set the limit file size in bytes", "limit_size" },
+    { "mux_thread_queue_size", HAS_ARG | OPT_INT64 | OPT_OFFSET | OPT_EXPERT | OPT_OUTPUT, { .off = OFFSET(mux_thread_queue_size) },
+        "maximum number of bytes queued for the muxing thread, 0 to mux on the main thread", "bytes" },
+    { "mux_thread_queue_duration", HAS_ARG | OPT_TIME | OPT_OFFSET | OPT_EXPERT | OPT_OUTPUT, { .off = OFFSET(mux_thread_queue_duration) },
+        "maximum duration of the packets queued for the muxing thread", "duration" },
     { "ss",             HAS_ARG | OPT_TIME | OPT_OFFSET |
                         OPT_INPUT | OPT_OUTPUT,                      { .off = OFFSET(start_time) },
         "set the start time offset", "time_off" },
@@ -3604,6 +3650,8 @@ const OptionDef options[] = {
         "copy initial non-keyframes" },
     { "copypriorss",    OPT_INT | HAS_ARG | OPT_EXPERT | OPT_SPEC | OPT_OUTPUT,   { .off = OFFSET(copy_prior_start) },
         "copy or discard frames before start time" },
+    { "smart_cut",      OPT_BOOL | OPT_EXPERT | OPT_SPEC | OPT_OUTPUT, { .off = OFFSET(smart_cut) },
+        "cut stream copied video at exact frames, re-encoding the start and end GOPs" },
     { "frames",         OPT_INT64 | HAS_ARG | OPT_SPEC | OPT_OUTPUT, { .off = OFFSET(max_frames) },
         "set the number of frames to output", "number" },
     { "tag",            OPT_STRING | HAS_ARG | OPT_SPEC |
@@ -3624,7 +3672,7 @@ const OptionDef options[] = {
     { "filter_script",  HAS_ARG | OPT_STRING | OPT_SPEC | OPT_OUTPUT, { .off = OFFSET(filter_scripts) },
         "read stream filtergraph description from a file", "filename" },
     { "reinit_filter",  HAS_ARG | OPT_INT | OPT_SPEC | OPT_INPUT,    { .off = OFFSET(reinit_filters) },
-        "reinit filtergraph on input parameter changes", "" },
+        "reinit filtergraph on input parameter changes, 2 to only reconfigure the video scalers when possible", "" },
     { "filter_complex", HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
@@ -3639,6 +3687,24 @@ const OptionDef options[] = {
         "print progress report during encoding", },
     { "stats_period",    HAS_ARG | OPT_EXPERT,                       { .func_arg = opt_stats_period },
         "set the period at which ffmpeg updates stats and -progress output", "time" },
+    { "profile_report",  HAS_ARG | OPT_EXPERT,                       { .func_arg = opt_profile_report },
+        "write a JSON profile of every processing stage", "url" },
+    { "profile_report_period", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_profile_report_period },
+        "also write the profile at this period", "time" },
+    { "worker_jobs",     OPT_INT | HAS_ARG | OPT_EXPERT,             { &worker_jobs },
+        "run as a worker executing up to this many jobs at once", "n" },
+    { "worker_socket",   OPT_STRING | HAS_ARG | OPT_EXPERT,          { &worker_socket },
+        "read worker jobs from this Unix socket instead of stdin", "path" },
+    { "worker_reply_fd", OPT_INT | HAS_ARG | OPT_EXPERT,             { &worker_reply_fd },
+        "write the replies to the jobs read from stdin to this file descriptor", "fd" },
+    { "chunks",          OPT_INT | HAS_ARG | OPT_EXPERT,             { &encode_chunks },
+        "split the input in this many chunks transcoded in parallel", "n" },
+    { "fast_remux",      OPT_BOOL | OPT_EXPERT,                      { &fast_remux },
+        "remux MP4/MOV files by rewriting their boxes when possible" },
+    { "decode_bench",    OPT_STRING | HAS_ARG | OPT_EXPERT,          { &decode_bench },
+        "only decode the matching streams of the inputs and report the decoding speed", "stream_specifier" },
+    { "decode_bench_warmup", OPT_TIME | HAS_ARG | OPT_EXPERT,        { &decode_bench_warmup },
+        "report the first part of -decode_bench separately", "duration" },
     { "attach",         HAS_ARG | OPT_PERFILE | OPT_EXPERT |
                         OPT_OUTPUT,                                  { .func_arg = opt_attach },
         "add an attachment to the output file", "filename" },
@@ -3660,6 +3726,9 @@ const OptionDef options[] = {
     { "thread_queue_size", HAS_ARG | OPT_INT | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
                                                                      { .off = OFFSET(thread_queue_size) },
         "set the maximum number of queued packets from the demuxer" },
+    { "thread_queue_bytes", HAS_ARG | OPT_INT64 | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
+                                                                     { .off = OFFSET(thread_queue_bytes) },
+        "set the maximum number of bytes queued from the demuxer", "bytes" },
     { "find_stream_info", OPT_BOOL | OPT_PERFILE | OPT_INPUT | OPT_EXPERT, { &find_stream_info },
         "read and decode the streams to fill missing information with heuristics" },
 
@@ -3854,6 +3923,8 @@ const OptionDef options[] = {
         "maximum number of packets that can be buffered while waiting for all streams to initialize", "packets" },
     { "muxing_queue_data_threshold", HAS_ARG | OPT_INT | OPT_SPEC | OPT_EXPERT | OPT_OUTPUT, { .off = OFFSET(muxing_queue_data_threshold) },
         "set the threshold after which max_muxing_queue_size is taken into account", "bytes" },
+    { "enc_thread_queue_size", HAS_ARG | OPT_INT | OPT_SPEC | OPT_EXPERT | OPT_OUTPUT, { .off = OFFSET(enc_thread_queue_size) },
+        "run the encoder in its own thread, fed through a queue of the given number of frames", "frames" },
 
     /* data codec support */
     { "dcodec", HAS_ARG | OPT_DATA | OPT_PERFILE | OPT_EXPERT | OPT_INPUT | OPT_OUTPUT, { .func_arg = opt_data_codec },
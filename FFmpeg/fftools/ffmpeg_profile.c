@@ -0,0 +1,272 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Per-stage profiling of the transcoding pipeline, written as one JSON
+ * object per line to the -profile_report output.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#include "libavutil/bprint.h"
+#include "libavutil/common.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "ffmpeg.h"
+
+AVIOContext *profile_avio;
+
+/* stages are updated from the encoder, muxing and input threads */
+static AVMutex profile_lock = AV_MUTEX_INITIALIZER;
+
+static int64_t thread_cpu_time(void)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000;
+#endif
+    return 0;
+}
+
+void profile_timer_start(ProfileTimer *t)
+{
+    if (!profile_avio)
+        return;
+    t->wall_start = av_gettime_relative();
+    t->cpu_start  = thread_cpu_time();
+}
+
+void profile_timer_stop(ProfileTimer *t)
+{
+    if (!profile_avio)
+        return;
+    t->wall_time += av_gettime_relative() - t->wall_start;
+    t->cpu_time  += thread_cpu_time()     - t->cpu_start;
+}
+
+void profile_stage_add(ProfileStage *s, ProfileTimer *t, int nb_frames)
+{
+    int bucket;
+
+    if (!profile_avio)
+        return;
+
+    bucket = t->wall_time > 0 ? av_log2(FFMIN(t->wall_time, UINT_MAX)) + 1 : 0;
+    bucket = FFMIN(bucket, PROFILE_HIST_SIZE - 1);
+
+    ff_mutex_lock(&profile_lock);
+    s->nb_calls++;
+    s->nb_frames  += nb_frames;
+    s->wall_time  += t->wall_time;
+    s->cpu_time   += t->cpu_time;
+    s->max_latency = FFMAX(s->max_latency, t->wall_time);
+    s->latency_hist[bucket]++;
+    ff_mutex_unlock(&profile_lock);
+
+    memset(t, 0, sizeof(*t));
+}
+
+static void json_string(AVBPrint *bp, const char *str)
+{
+    av_bprint_chars(bp, '"', 1);
+    for (; str && *str; str++) {
+        if (*str == '"' || *str == '\\')
+            av_bprintf(bp, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            av_bprintf(bp, "\\u%04x", *str);
+        else
+            av_bprint_chars(bp, *str, 1);
+    }
+    av_bprint_chars(bp, '"', 1);
+}
+
+static void json_stage(AVBPrint *bp, const char *key, const ProfileStage *s)
+{
+    int i, nb_buckets = PROFILE_HIST_SIZE;
+
+    while (nb_buckets > 0 && !s->latency_hist[nb_buckets - 1])
+        nb_buckets--;
+
+    av_bprintf(bp, ",\"%s\":{\"calls\":%"PRId64",\"frames\":%"PRId64","
+               "\"wall_time_us\":%"PRId64",\"cpu_time_us\":%"PRId64","
+               "\"max_latency_us\":%"PRId64",\"latency_hist\":[",
+               key, s->nb_calls, s->nb_frames, s->wall_time, s->cpu_time,
+               s->max_latency);
+    for (i = 0; i < nb_buckets; i++)
+        av_bprintf(bp, "%s%"PRId64, i ? "," : "", s->latency_hist[i]);
+    av_bprintf(bp, "]}");
+}
+
+static void json_stream_info(AVBPrint *bp, const AVStream *st, const char *codec)
+{
+    const char *type = av_get_media_type_string(st->codecpar->codec_type);
+
+    av_bprintf(bp, "{\"index\":%d,\"type\":", st->index);
+    json_string(bp, type ? type : "unknown");
+    av_bprintf(bp, ",\"codec\":");
+    json_string(bp, codec);
+}
+
+static void print_inputs(AVBPrint *bp)
+{
+    int i, j;
+
+    av_bprintf(bp, ",\"inputs\":[");
+    for (i = 0; i < nb_input_files; i++) {
+        InputFile *f = input_files[i];
+
+        av_bprintf(bp, "%s{\"file\":%d,\"url\":", i ? "," : "", i);
+        json_string(bp, f->ctx->url);
+        json_stage(bp, "demux", &f->prof_demux);
+        av_bprintf(bp, ",\"streams\":[");
+        for (j = 0; j < f->nb_streams; j++) {
+            InputStream *ist = input_streams[f->ist_index + j];
+
+            if (j)
+                av_bprint_chars(bp, ',', 1);
+            json_stream_info(bp, ist->st, ist->dec ? ist->dec->name :
+                             avcodec_get_name(ist->st->codecpar->codec_id));
+            av_bprintf(bp, ",\"packets\":%"PRIu64, ist->nb_packets);
+            json_stage(bp, "decode", &ist->prof_decode);
+            av_bprint_chars(bp, '}', 1);
+        }
+        av_bprintf(bp, "]}");
+    }
+    av_bprint_chars(bp, ']', 1);
+}
+
+static void print_filtergraphs(AVBPrint *bp)
+{
+    int i, j, k;
+
+    av_bprintf(bp, ",\"filtergraphs\":[");
+    for (i = 0; i < nb_filtergraphs; i++) {
+        FilterGraph *fg = filtergraphs[i];
+        AVFilterGraph *graph = fg->graph;
+
+        av_bprintf(bp, "%s{\"index\":%d", i ? "," : "", fg->index);
+        json_stage(bp, "graph", &fg->prof_filter);
+        av_bprintf(bp, ",\"filters\":[");
+        for (j = 0; graph && j < graph->nb_filters; j++) {
+            AVFilterContext *f = graph->filters[j];
+            int64_t frames_in = 0, frames_out = 0;
+
+            for (k = 0; k < f->nb_inputs; k++)
+                if (f->inputs[k])
+                    frames_in += f->inputs[k]->frame_count_out;
+            for (k = 0; k < f->nb_outputs; k++)
+                if (f->outputs[k])
+                    frames_out += f->outputs[k]->frame_count_in;
+
+            av_bprintf(bp, "%s{\"name\":", j ? "," : "");
+            json_string(bp, f->name);
+            av_bprintf(bp, ",\"filter\":");
+            json_string(bp, f->filter->name);
+            av_bprintf(bp, ",\"activations\":%"PRId64",\"wall_time_us\":%"PRId64","
+                       "\"cpu_time_us\":%"PRId64",\"frames_in\":%"PRId64","
+                       "\"frames_out\":%"PRId64"}",
+                       f->nb_activations, f->activation_time, f->activation_cpu_time,
+                       frames_in, frames_out);
+        }
+        av_bprintf(bp, "]}");
+    }
+    av_bprint_chars(bp, ']', 1);
+}
+
+static void print_outputs(AVBPrint *bp)
+{
+    int i, j;
+
+    av_bprintf(bp, ",\"outputs\":[");
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+
+        av_bprintf(bp, "%s{\"file\":%d,\"url\":", i ? "," : "", i);
+        json_string(bp, of->ctx->url);
+        json_stage(bp, "mux", &of->prof_mux);
+        av_bprintf(bp, ",\"streams\":[");
+        for (j = 0; j < of->ctx->nb_streams; j++) {
+            OutputStream *ost = output_streams[of->ost_index + j];
+
+            if (j)
+                av_bprint_chars(bp, ',', 1);
+            json_stream_info(bp, ost->st, ost->enc ? ost->enc->name : "copy");
+            json_stage(bp, "encode", &ost->prof_encode);
+            json_stage(bp, "bsf", &ost->prof_bsf);
+            av_bprint_chars(bp, '}', 1);
+        }
+        av_bprintf(bp, "]}");
+    }
+    av_bprint_chars(bp, ']', 1);
+}
+
+/**
+ * Write a report every profile_report_period and once at the end.
+ */
+void profile_report_write(int is_last, int64_t timer_start, int64_t cur_time)
+{
+    static int64_t last_time = -1;
+    AVBPrint bp;
+
+    if (!profile_avio)
+        return;
+    if (!is_last) {
+        if (profile_report_period <= 0)
+            return;
+        if (last_time == -1)
+            last_time = timer_start;
+        if (cur_time - last_time < profile_report_period)
+            return;
+    }
+    last_time = cur_time;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "{\"time_us\":%"PRId64",\"final\":%s",
+               cur_time - timer_start, is_last ? "true" : "false");
+
+    ff_mutex_lock(&profile_lock);
+    print_inputs(&bp);
+    print_filtergraphs(&bp);
+    print_outputs(&bp);
+    ff_mutex_unlock(&profile_lock);
+
+    av_bprintf(&bp, "}\n");
+
+    if (av_bprint_is_complete(&bp)) {
+        avio_write(profile_avio, bp.str, bp.len);
+        avio_flush(profile_avio);
+    } else {
+        av_log(NULL, AV_LOG_ERROR, "Out of memory building the profile report\n");
+    }
+    av_bprint_finalize(&bp, NULL);
+}
+
+void profile_report_close(void)
+{
+    int ret;
+
+    if (profile_avio && (ret = avio_closep(&profile_avio)) < 0)
+        av_log(NULL, AV_LOG_ERROR, "Error closing the profile report: %s\n",
+               av_err2str(ret));
+}
@@ -0,0 +1,732 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Smart cut of a stream copied video stream: the parts of the GOPs that
+ * contain the start and end points are decoded and re-encoded with the
+ * parameters of the source, and the packets in between are copied.
+ *
+ * Packets are queued from the last keyframe before the start point until the
+ * first keyframe after it and its leading pictures, then decoded at once.
+ * With an end point, each GOP is held back until the next keyframe, and the
+ * one that crosses the end point is re-encoded instead of copied, decoding
+ * the GOP before it too for the leading pictures of open GOPs.
+ *
+ * The parameter sets of the encoder are sent in-band, and those of the source
+ * are sent again in front of the first copied keyframe, so that the output
+ * keeps the extradata of the source.
+ */
+
+#include <string.h>
+
+#include "libavutil/fifo.h"
+#include "libavutil/intreadwrite.h"
+#include "libavcodec/avcodec.h"
+
+#include "ffmpeg.h"
+
+enum SmartCutState {
+    SMART_CUT_HEAD,         ///< queueing the GOP that contains the start point
+    SMART_CUT_LEADING,      ///< queueing the leading pictures of the switch keyframe
+    SMART_CUT_COPY,         ///< copying, GOP by GOP if there is an end point
+    SMART_CUT_DONE,         ///< past the end point
+};
+
+struct SmartCutContext {
+    InputStream *ist;
+    enum SmartCutState state;
+    int64_t cut_pts;        ///< start point, in the input stream time base
+    int64_t end_pts;        ///< end point, INT64_MAX if none
+
+    AVFifoBuffer *in_queue; ///< AVPacket* waiting to be decoded or copied
+    AVFifoBuffer *ref_queue;///< last GOP copied, references of in_queue
+    int tail_cut;           ///< in_queue holds the GOP crossing the end point
+    int64_t end_keyframe_pts;   ///< first keyframe past the end point
+    AVFifoBuffer *out_queue;///< AVPacket* ready to be copied
+
+    AVPacket *keyframe;     ///< first keyframe after the start point
+    int keyframe_first;     ///< the keyframe starts the queue, nothing to encode
+
+    AVCodecContext *dec;
+    AVCodecContext *enc;
+    AVFrame *frame;
+
+    /* bitstream of the source */
+    int nal_length_size;    ///< 0 for Annex B and non NAL codecs
+    uint8_t *param_sets;    ///< source parameter sets, in the source bitstream format
+    int param_sets_size;
+
+    int nb_encoded;
+    int64_t enc_last_dts;   ///< of the last encoded packet
+    int64_t out_last_dts;   ///< of the last packet returned
+    int64_t out_max_pts;    ///< largest pts returned
+    AVPacket *out_pkt;      ///< returned by smart_cut_receive_packet()
+};
+
+static int queue_packet(AVFifoBuffer **fifo, AVPacket *pkt)
+{
+    int ret;
+
+    if (!*fifo && !(*fifo = av_fifo_alloc(8 * sizeof(pkt))))
+        return AVERROR(ENOMEM);
+    if (!av_fifo_space(*fifo)) {
+        ret = av_fifo_realloc2(*fifo, 2 * av_fifo_size(*fifo));
+        if (ret < 0)
+            return ret;
+    }
+    av_fifo_generic_write(*fifo, &pkt, sizeof(pkt), NULL);
+    return 0;
+}
+
+static int queue_packet_ref(AVFifoBuffer **fifo, const AVPacket *src)
+{
+    AVPacket *pkt = av_packet_clone(src);
+    int ret;
+
+    if (!pkt)
+        return AVERROR(ENOMEM);
+    ret = queue_packet(fifo, pkt);
+    if (ret < 0)
+        av_packet_free(&pkt);
+    return ret;
+}
+
+static void free_queue(AVFifoBuffer **fifo)
+{
+    while (*fifo && av_fifo_size(*fifo)) {
+        AVPacket *pkt;
+        av_fifo_generic_read(*fifo, &pkt, sizeof(pkt), NULL);
+        av_packet_free(&pkt);
+    }
+    av_fifo_freep(fifo);
+}
+
+/* Parameter sets of the source, with the packets they apply to: avcC/hvcC
+ * extradata is turned into length prefixed NAL units, other extradata is
+ * used as is, as dump_extra would. */
+static int parse_extradata(SmartCutContext *sc, const AVCodecParameters *par)
+{
+    const uint8_t *p = par->extradata, *end = p + par->extradata_size;
+    int nb_arrays, nb_nals, i, j;
+    AVIOContext *pb;
+    int ret;
+
+    if (!par->extradata_size)
+        return 0;
+
+    if (p[0] != 1 || (par->codec_id != AV_CODEC_ID_H264 && par->codec_id != AV_CODEC_ID_HEVC)) {
+        sc->param_sets = av_memdup(p, par->extradata_size);
+        if (!sc->param_sets)
+            return AVERROR(ENOMEM);
+        sc->param_sets_size = par->extradata_size;
+        return 0;
+    }
+
+    ret = avio_open_dyn_buf(&pb);
+    if (ret < 0)
+        return ret;
+
+    if (par->codec_id == AV_CODEC_ID_H264) {
+        if (end - p < 7)
+            goto fail;
+        sc->nal_length_size = (p[4] & 3) + 1;
+        p += 5;
+        /* SPS then PPS */
+        for (i = 0; i < 2; i++) {
+            nb_nals = i ? *p++ : *p++ & 0x1f;
+            for (j = 0; j < nb_nals; j++) {
+                int size;
+                if (end - p < 2 || end - p - 2 < (size = AV_RB16(p)))
+                    goto fail;
+                avio_wb32(pb, size);
+                avio_write(pb, p + 2, size);
+                p += 2 + size;
+            }
+            if (!i && p >= end)
+                goto fail;
+        }
+    } else {
+        if (end - p < 23)
+            goto fail;
+        sc->nal_length_size = (p[21] & 3) + 1;
+        nb_arrays = p[22];
+        p += 23;
+        for (i = 0; i < nb_arrays; i++) {
+            if (end - p < 3)
+                goto fail;
+            nb_nals = AV_RB16(p + 1);
+            p += 3;
+            for (j = 0; j < nb_nals; j++) {
+                int size;
+                if (end - p < 2 || end - p - 2 < (size = AV_RB16(p)))
+                    goto fail;
+                avio_wb32(pb, size);
+                avio_write(pb, p + 2, size);
+                p += 2 + size;
+            }
+        }
+    }
+
+    /* written with 4 byte lengths, shrink them if needed */
+    sc->param_sets_size = avio_close_dyn_buf(pb, &sc->param_sets);
+    if (sc->param_sets_size < 0)
+        return sc->param_sets_size;
+    if (sc->nal_length_size < 4) {
+        uint8_t *src = sc->param_sets, *dst = sc->param_sets;
+        uint8_t *src_end = src + sc->param_sets_size;
+
+        while (src < src_end) {
+            uint32_t size = AV_RB32(src);
+            if (size >> (8 * sc->nal_length_size)) {
+                av_log(NULL, AV_LOG_ERROR, "Parameter set too large for the NAL length size\n");
+                return AVERROR_INVALIDDATA;
+            }
+            for (i = 0; i < sc->nal_length_size; i++)
+                *dst++ = size >> (8 * (sc->nal_length_size - 1 - i));
+            memmove(dst, src + 4, size);
+            dst += size;
+            src += 4 + size;
+        }
+        sc->param_sets_size = dst - sc->param_sets;
+    }
+    return 0;
+
+fail:
+    avio_close_dyn_buf(pb, &sc->param_sets);
+    av_freep(&sc->param_sets);
+    av_log(NULL, AV_LOG_ERROR, "Invalid extradata, cannot smart cut\n");
+    return AVERROR_INVALIDDATA;
+}
+
+static const uint8_t *find_start_code(const uint8_t *p, const uint8_t *end)
+{
+    for (; end - p >= 3; p++)
+        if (!p[0] && !p[1] && p[2] == 1)
+            return p;
+    return end;
+}
+
+/* rewrite an Annex B packet from the encoder with length prefixes */
+static int annexb_to_length_prefixed(SmartCutContext *sc, AVPacket *pkt)
+{
+    const uint8_t *p = pkt->data, *end = pkt->data + pkt->size;
+    AVPacket *out;
+    AVIOContext *pb;
+    uint8_t *buf;
+    int i, size, ret;
+
+    ret = avio_open_dyn_buf(&pb);
+    if (ret < 0)
+        return ret;
+
+    p = find_start_code(p, end);
+    while (p < end) {
+        const uint8_t *nal = p + 3, *next = find_start_code(nal, end);
+        const uint8_t *nal_end = next;
+
+        while (nal_end > nal && !nal_end[-1])
+            nal_end--;
+        if (nal_end > nal) {
+            uint32_t nal_size = nal_end - nal;
+            if (sc->nal_length_size < 4 && nal_size >> (8 * sc->nal_length_size)) {
+                avio_close_dyn_buf(pb, &buf);
+                av_free(buf);
+                return AVERROR(ERANGE);
+            }
+            for (i = sc->nal_length_size - 1; i >= 0; i--)
+                avio_w8(pb, nal_size >> (8 * i));
+            avio_write(pb, nal, nal_size);
+        }
+        p = next;
+    }
+
+    size = avio_close_dyn_buf(pb, &buf);
+    if (size < 0)
+        return size;
+
+    out = av_packet_alloc();
+    if (!out || (ret = av_packet_from_data(out, buf, size)) < 0) {
+        av_packet_free(&out);
+        av_free(buf);
+        return AVERROR(ENOMEM);
+    }
+    ret = av_packet_copy_props(out, pkt);
+    if (ret >= 0) {
+        av_packet_unref(pkt);
+        av_packet_move_ref(pkt, out);
+    }
+    av_packet_free(&out);
+    return ret;
+}
+
+static int open_codecs(SmartCutContext *sc)
+{
+    InputStream *ist = sc->ist;
+    const AVCodecParameters *par = ist->st->codecpar;
+    const AVCodec *enc_codec;
+    AVCodecContext *dec, *enc;
+    int ret;
+
+    sc->dec = dec = avcodec_alloc_context3(ist->dec);
+    sc->frame     = av_frame_alloc();
+    if (!dec || !sc->frame)
+        return AVERROR(ENOMEM);
+    ret = avcodec_parameters_to_context(dec, par);
+    if (ret < 0)
+        return ret;
+    dec->pkt_timebase = ist->st->time_base;
+    ret = avcodec_open2(dec, ist->dec, NULL);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Error opening the smart cut decoder: %s\n", av_err2str(ret));
+        return ret;
+    }
+
+    enc_codec = avcodec_find_encoder(par->codec_id);
+    if (!enc_codec) {
+        av_log(NULL, AV_LOG_ERROR, "No %s encoder to smart cut with\n", avcodec_get_name(par->codec_id));
+        return AVERROR_ENCODER_NOT_FOUND;
+    }
+    sc->enc = enc = avcodec_alloc_context3(enc_codec);
+    if (!enc)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+/* set the encoder up from the first decoded frame, matching the source */
+static int open_encoder(SmartCutContext *sc, const AVFrame *frame)
+{
+    InputStream *ist = sc->ist;
+    const AVCodecParameters *par = ist->st->codecpar;
+    AVCodecContext *enc = sc->enc;
+    AVRational frame_rate = ist->framerate.num ? ist->framerate : ist->st->r_frame_rate;
+    int ret;
+
+    enc->width                  = frame->width;
+    enc->height                 = frame->height;
+    enc->pix_fmt                = frame->format;
+    enc->sample_aspect_ratio    = frame->sample_aspect_ratio;
+    enc->color_range            = frame->color_range;
+    enc->color_primaries        = frame->color_primaries;
+    enc->color_trc              = frame->color_trc;
+    enc->colorspace             = frame->colorspace;
+    enc->chroma_sample_location = frame->chroma_location;
+    enc->field_order            = par->field_order;
+    enc->profile                = par->profile;
+    enc->level                  = par->level;
+    enc->framerate              = frame_rate;
+    enc->time_base              = ist->st->time_base;
+    enc->bits_per_raw_sample    = par->bits_per_raw_sample;
+    /* a single intra frame at the start, and the reordering of the source,
+     * so that decoders do not have to change their delay at the switch */
+    enc->gop_size               = INT_MAX;
+    enc->max_b_frames           = par->video_delay;
+
+    if (par->bit_rate > 0) {
+        enc->bit_rate = par->bit_rate;
+    } else {
+        enc->flags         |= AV_CODEC_FLAG_QSCALE;
+        enc->global_quality = FF_QP2LAMBDA * 2;
+    }
+
+    /* MPEG-1/2 only code frame rates, MPEG-4 a 16 bit time base */
+    if (frame_rate.num &&
+        (par->codec_id == AV_CODEC_ID_MPEG1VIDEO || par->codec_id == AV_CODEC_ID_MPEG2VIDEO ||
+         enc->time_base.den > 65535))
+        enc->time_base = av_inv_q(frame_rate);
+
+    ret = avcodec_open2(enc, enc->codec, NULL);
+    if (ret < 0)
+        av_log(NULL, AV_LOG_ERROR, "Error opening the smart cut encoder: %s\n", av_err2str(ret));
+    return ret;
+}
+
+static int receive_encoded(SmartCutContext *sc, AVFifoBuffer **encoded)
+{
+    int ret;
+
+    while (1) {
+        AVPacket *pkt = av_packet_alloc();
+        if (!pkt)
+            return AVERROR(ENOMEM);
+        ret = avcodec_receive_packet(sc->enc, pkt);
+        if (ret < 0) {
+            av_packet_free(&pkt);
+            return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+        }
+        av_packet_rescale_ts(pkt, sc->enc->time_base, sc->ist->st->time_base);
+        if (pkt->dts == AV_NOPTS_VALUE)
+            pkt->dts = pkt->pts;
+        sc->enc_last_dts = pkt->dts;
+        if (sc->nal_length_size && (ret = annexb_to_length_prefixed(sc, pkt)) < 0) {
+            av_packet_free(&pkt);
+            return ret;
+        }
+        ret = queue_packet(encoded, pkt);
+        if (ret < 0) {
+            av_packet_free(&pkt);
+            return ret;
+        }
+        sc->nb_encoded++;
+    }
+}
+
+static int encode_frames(SmartCutContext *sc, int64_t start_pts, int64_t end_pts,
+                         AVFifoBuffer **encoded)
+{
+    AVFrame *frame = sc->frame;
+    int ret;
+
+    while ((ret = avcodec_receive_frame(sc->dec, frame)) >= 0) {
+        int64_t pts = frame->best_effort_timestamp;
+
+        if (pts != AV_NOPTS_VALUE && pts >= start_pts && pts < end_pts) {
+            if (!avcodec_is_open(sc->enc) && (ret = open_encoder(sc, frame)) < 0)
+                return ret;
+            frame->pts       = av_rescale_q(pts, sc->ist->st->time_base, sc->enc->time_base);
+            frame->pict_type = AV_PICTURE_TYPE_NONE;
+            ret = avcodec_send_frame(sc->enc, frame);
+            av_frame_unref(frame);
+            if (ret < 0)
+                return ret;
+            ret = receive_encoded(sc, encoded);
+            if (ret < 0)
+                return ret;
+        }
+        av_frame_unref(frame);
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+static int output_packet(SmartCutContext *sc, AVPacket *pkt)
+{
+    int ret = queue_packet(&sc->out_queue, pkt);
+
+    if (ret < 0) {
+        av_packet_free(&pkt);
+        return ret;
+    }
+    if (pkt->dts != AV_NOPTS_VALUE)
+        sc->out_last_dts = pkt->dts;
+    if (pkt->pts != AV_NOPTS_VALUE)
+        sc->out_max_pts = FFMAX(sc->out_max_pts, pkt->pts);
+    return 0;
+}
+
+/* copy the queued packets, keeping them as references for the next GOP */
+static int output_queue(SmartCutContext *sc)
+{
+    int ret = 0;
+
+    free_queue(&sc->ref_queue);
+    while (ret >= 0 && sc->in_queue && av_fifo_size(sc->in_queue)) {
+        AVPacket *pkt;
+        av_fifo_generic_read(sc->in_queue, &pkt, sizeof(pkt), NULL);
+        ret = queue_packet_ref(&sc->ref_queue, pkt);
+        if (ret >= 0)
+            ret = output_packet(sc, pkt);
+        else
+            av_packet_free(&pkt);
+    }
+    return ret;
+}
+
+static int decode_queue(SmartCutContext *sc, AVFifoBuffer **queue,
+                        int64_t start_pts, int64_t end_pts, AVFifoBuffer **encoded)
+{
+    int ret = 0;
+
+    while (ret >= 0 && *queue && av_fifo_size(*queue)) {
+        AVPacket *pkt;
+        av_fifo_generic_read(*queue, &pkt, sizeof(pkt), NULL);
+        ret = avcodec_send_packet(sc->dec, pkt);
+        av_packet_free(&pkt);
+        if (ret == AVERROR_INVALIDDATA)
+            ret = 0;
+        if (ret >= 0)
+            ret = encode_frames(sc, start_pts, end_pts, encoded);
+    }
+    free_queue(queue);
+    return ret;
+}
+
+/*
+ * Decode the queued packets, re-encode what is displayed between start_pts
+ * and end_pts, and return the result. The timestamps of the encoded packets
+ * are moved so that they decode before max_dts, or after the packets already
+ * returned; in the latter case pts is moved along with dts.
+ */
+static int reencode_queue(SmartCutContext *sc, int64_t start_pts, int64_t end_pts,
+                          int64_t max_dts)
+{
+    AVFifoBuffer *encoded = NULL;
+    int64_t dts_shift = 0;
+    int ret;
+
+    ret = open_codecs(sc);
+    if (ret >= 0)
+        ret = decode_queue(sc, &sc->ref_queue, start_pts, end_pts, &encoded);
+    if (ret >= 0)
+        ret = decode_queue(sc, &sc->in_queue, start_pts, end_pts, &encoded);
+    if (ret >= 0)
+        ret = avcodec_send_packet(sc->dec, NULL);
+    if (ret >= 0)
+        ret = encode_frames(sc, start_pts, end_pts, &encoded);
+    if (ret >= 0 && avcodec_is_open(sc->enc)) {
+        ret = avcodec_send_frame(sc->enc, NULL);
+        if (ret >= 0)
+            ret = receive_encoded(sc, &encoded);
+    }
+    free_queue(&sc->in_queue);
+    avcodec_free_context(&sc->dec);
+    avcodec_free_context(&sc->enc);
+    av_frame_free(&sc->frame);
+
+    if (ret >= 0 && encoded && av_fifo_size(encoded)) {
+        AVPacket *first;
+        av_fifo_generic_peek(encoded, &first, sizeof(first), NULL);
+        if (max_dts != AV_NOPTS_VALUE)
+            dts_shift = FFMIN(max_dts - 1 - sc->enc_last_dts, 0);
+        else if (sc->out_last_dts != AV_NOPTS_VALUE)
+            dts_shift = FFMAX(sc->out_last_dts + 1 - first->dts, 0);
+    }
+    while (ret >= 0 && encoded && av_fifo_size(encoded)) {
+        AVPacket *pkt;
+        av_fifo_generic_read(encoded, &pkt, sizeof(pkt), NULL);
+        pkt->dts += dts_shift;
+        /* a packet decoded later must be displayed later too */
+        if (dts_shift > 0 && pkt->pts != AV_NOPTS_VALUE)
+            pkt->pts += dts_shift;
+        ret = output_packet(sc, pkt);
+    }
+    free_queue(&encoded);
+    return ret;
+}
+
+/* re-encode the start, then switch to the keyframe */
+static int finish_head(SmartCutContext *sc)
+{
+    AVPacket *keyframe = sc->keyframe;
+    int64_t end_pts = sc->end_pts;
+    int ret = 0;
+
+    if (keyframe && keyframe->pts < end_pts)
+        end_pts = keyframe->pts;
+
+    if (!sc->keyframe_first)
+        ret = reencode_queue(sc, sc->cut_pts, end_pts, keyframe ? keyframe->dts : AV_NOPTS_VALUE);
+    free_queue(&sc->in_queue);
+    if (ret < 0)
+        return ret;
+
+    av_log(NULL, AV_LOG_VERBOSE, "Smart cut of stream #%d:%d: %d frames re-encoded at the start\n",
+           sc->ist->file_index, sc->ist->st->index, sc->nb_encoded);
+
+    if (!keyframe || keyframe->pts >= sc->end_pts) {
+        sc->state = SMART_CUT_DONE;
+        return 0;
+    }
+
+    /* switch back to the parameter sets of the source */
+    if (sc->nb_encoded && sc->param_sets_size) {
+        AVPacket *pkt = av_packet_alloc();
+        if (!pkt || (ret = av_new_packet(pkt, sc->param_sets_size + keyframe->size)) < 0 ||
+            (ret = av_packet_copy_props(pkt, keyframe)) < 0) {
+            av_packet_free(&pkt);
+            return ret < 0 ? ret : AVERROR(ENOMEM);
+        }
+        memcpy(pkt->data, sc->param_sets, sc->param_sets_size);
+        memcpy(pkt->data + sc->param_sets_size, keyframe->data, keyframe->size);
+        av_packet_free(&keyframe);
+        keyframe = pkt;
+    }
+    sc->keyframe = NULL;
+    sc->state    = SMART_CUT_COPY;
+
+    /* with an end point, the keyframe starts the first GOP held back */
+    if (sc->end_pts != INT64_MAX)
+        ret = queue_packet(&sc->in_queue, keyframe);
+    else
+        return output_packet(sc, keyframe);
+    if (ret < 0)
+        av_packet_free(&keyframe);
+    return ret;
+}
+
+/* re-encode the GOP that crosses the end point, then stop */
+static int finish_tail(SmartCutContext *sc)
+{
+    int nb_encoded = sc->nb_encoded;
+    int i, ret, needed = 0;
+
+    /* nothing to do if only the end keyframe was queued */
+    for (i = 0; sc->in_queue && i < av_fifo_size(sc->in_queue); i += sizeof(AVPacket *)) {
+        AVPacket *pkt;
+        av_fifo_generic_peek_at(sc->in_queue, &pkt, i, sizeof(pkt), NULL);
+        needed |= pkt->pts == AV_NOPTS_VALUE ||
+                  (pkt->pts > sc->out_max_pts && pkt->pts < sc->end_pts);
+    }
+    ret = needed ? reencode_queue(sc, sc->out_max_pts + 1, sc->end_pts, AV_NOPTS_VALUE) : 0;
+    free_queue(&sc->in_queue);
+    if (ret < 0)
+        return ret;
+    av_log(NULL, AV_LOG_VERBOSE, "Smart cut of stream #%d:%d: %d frames re-encoded at the end\n",
+           sc->ist->file_index, sc->ist->st->index, sc->nb_encoded - nb_encoded);
+    sc->state = SMART_CUT_DONE;
+    return 0;
+}
+
+int smart_cut_init(OutputStream *ost, InputStream *ist, int64_t cut_pts, int64_t end_pts)
+{
+    SmartCutContext *sc;
+    int ret;
+
+    switch (ist->st->codecpar->codec_id) {
+    case AV_CODEC_ID_H264:
+    case AV_CODEC_ID_HEVC:
+    case AV_CODEC_ID_MPEG1VIDEO:
+    case AV_CODEC_ID_MPEG2VIDEO:
+    case AV_CODEC_ID_MPEG4:
+        break;
+    default:
+        av_log(NULL, AV_LOG_WARNING, "Smart cut is not supported for %s, "
+               "stream #%d:%d is cut at keyframes\n",
+               avcodec_get_name(ist->st->codecpar->codec_id), ost->file_index, ost->index);
+        return 0;
+    }
+    if (!ist->dec || !avcodec_find_encoder(ist->st->codecpar->codec_id)) {
+        av_log(NULL, AV_LOG_ERROR, "Smart cut of stream #%d:%d needs a %s %s, "
+               "none is available\n", ost->file_index, ost->index,
+               avcodec_get_name(ist->st->codecpar->codec_id), ist->dec ? "encoder" : "decoder");
+        return ist->dec ? AVERROR_ENCODER_NOT_FOUND : AVERROR_DECODER_NOT_FOUND;
+    }
+
+    sc = av_mallocz(sizeof(*sc));
+    if (!sc)
+        return AVERROR(ENOMEM);
+    sc->ist          = ist;
+    sc->cut_pts      = cut_pts;
+    sc->end_pts      = end_pts;
+    sc->out_last_dts = AV_NOPTS_VALUE;
+    sc->out_max_pts  = INT64_MIN;
+    sc->end_keyframe_pts = AV_NOPTS_VALUE;
+    ret = parse_extradata(sc, ist->st->codecpar);
+    if (ret < 0) {
+        smart_cut_free(&sc);
+        return ret;
+    }
+    ost->smart_cut_ctx = sc;
+    return 0;
+}
+
+int smart_cut_send_packet(SmartCutContext *sc, const AVPacket *pkt)
+{
+    int is_key = pkt && pkt->flags & AV_PKT_FLAG_KEY;
+    int ret;
+
+    if (!pkt) {
+        switch (sc->state) {
+        case SMART_CUT_HEAD:
+        case SMART_CUT_LEADING:
+            ret = finish_head(sc);
+            if (ret < 0 || sc->state == SMART_CUT_DONE)
+                return ret;
+            /* fall through */
+        case SMART_CUT_COPY:
+            return sc->tail_cut ? finish_tail(sc) : output_queue(sc);
+        }
+        return 0;
+    }
+
+    switch (sc->state) {
+    case SMART_CUT_HEAD:
+        if (!is_key && !sc->in_queue)
+            return 0;
+        if (is_key && pkt->pts != AV_NOPTS_VALUE && pkt->pts >= sc->cut_pts) {
+            sc->keyframe = av_packet_clone(pkt);
+            if (!sc->keyframe)
+                return AVERROR(ENOMEM);
+            sc->keyframe_first = !sc->in_queue || !av_fifo_size(sc->in_queue);
+            sc->state = SMART_CUT_LEADING;
+            return queue_packet_ref(&sc->in_queue, pkt);
+        }
+        if (is_key)
+            free_queue(&sc->in_queue);
+        return queue_packet_ref(&sc->in_queue, pkt);
+    case SMART_CUT_LEADING:
+        /* leading pictures are re-encoded and not copied */
+        if (pkt->pts != AV_NOPTS_VALUE && pkt->pts < sc->keyframe->pts)
+            return queue_packet_ref(&sc->in_queue, pkt);
+        ret = finish_head(sc);
+        if (ret < 0 || sc->state == SMART_CUT_DONE)
+            return ret;
+        /* fall through */
+    case SMART_CUT_COPY:
+        if (sc->end_pts == INT64_MAX)
+            return queue_packet_ref(&sc->out_queue, pkt);
+        if (is_key) {
+            if (sc->tail_cut)
+                return finish_tail(sc);
+            ret = output_queue(sc);
+            if (ret < 0)
+                return ret;
+            /* its leading pictures may still be displayed before the end */
+            if (pkt->pts != AV_NOPTS_VALUE && pkt->pts >= sc->end_pts)
+                sc->end_keyframe_pts = pkt->pts;
+        } else if (sc->end_keyframe_pts != AV_NOPTS_VALUE &&
+                   (pkt->pts == AV_NOPTS_VALUE || pkt->pts >= sc->end_keyframe_pts)) {
+            return finish_tail(sc);
+        }
+        if (pkt->pts != AV_NOPTS_VALUE && pkt->pts >= sc->end_pts)
+            sc->tail_cut = 1;
+        return queue_packet_ref(&sc->in_queue, pkt);
+    }
+    return 0;
+}
+
+int smart_cut_finished(SmartCutContext *sc)
+{
+    return sc->state == SMART_CUT_DONE;
+}
+
+AVPacket *smart_cut_receive_packet(SmartCutContext *sc)
+{
+    av_packet_free(&sc->out_pkt);
+    if (!sc->out_queue || !av_fifo_size(sc->out_queue))
+        return NULL;
+    av_fifo_generic_read(sc->out_queue, &sc->out_pkt, sizeof(sc->out_pkt), NULL);
+    return sc->out_pkt;
+}
+
+void smart_cut_free(SmartCutContext **psc)
+{
+    SmartCutContext *sc = *psc;
+
+    if (!sc)
+        return;
+    free_queue(&sc->in_queue);
+    free_queue(&sc->ref_queue);
+    free_queue(&sc->out_queue);
+    av_packet_free(&sc->keyframe);
+    av_packet_free(&sc->out_pkt);
+    avcodec_free_context(&sc->dec);
+    avcodec_free_context(&sc->enc);
+    av_frame_free(&sc->frame);
+    av_freep(&sc->param_sets);
+    av_freep(psc);
+}
@@ -34,6 +34,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
 #include "libavutil/channel_layout.h"
+#include "libavutil/cpu.h"
 #include "libavutil/display.h"
 #include "libavutil/hash.h"
 #include "libavutil/hdr_dynamic_metadata.h"
@@ -55,6 +56,12 @@
 #include "libpostproc/postprocess.h"
 #include "cmdutils.h"
 
+#if HAVE_FORK
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #include "libavutil/thread.h"
 
 #if !HAVE_THREADS
@@ -87,16 +94,19 @@ const int program_birth_year = 2007;
 static int do_bitexact = 0;
 static int do_count_frames = 0;
 static int do_count_packets = 0;
+static int do_count_from_index = 0;
 static int do_read_frames  = 0;
 static int do_read_packets = 0;
 static int do_show_chapters = 0;
 static int do_show_error   = 0;
 static int do_show_format  = 0;
 static int do_show_frames  = 0;
+static int do_show_gops    = 0;
 static int do_show_packets = 0;
 static int do_show_programs = 0;
 static int do_show_streams = 0;
 static int do_show_stream_disposition = 0;
+static int do_show_stream_keyframes = 0;
 static int do_show_data    = 0;
 static int do_show_program_version  = 0;
 static int do_show_library_versions = 0;
@@ -142,7 +152,7 @@ static int find_stream_info  = 1;
 
 /* section structure definition */
 
-#define SECTION_MAX_NB_CHILDREN 10
+#define SECTION_MAX_NB_CHILDREN 11
 
 struct section {
     int id;             ///< unique id identifying a section
@@ -177,6 +187,8 @@ typedef enum {
     SECTION_ID_FRAME_SIDE_DATA_TIMECODE,
     SECTION_ID_FRAME_LOG,
     SECTION_ID_FRAME_LOGS,
+    SECTION_ID_GOP,
+    SECTION_ID_GOPS,
     SECTION_ID_LIBRARY_VERSION,
     SECTION_ID_LIBRARY_VERSIONS,
     SECTION_ID_PACKET,
@@ -205,6 +217,8 @@ typedef enum {
     SECTION_ID_STREAM_TAGS,
     SECTION_ID_STREAM_SIDE_DATA_LIST,
     SECTION_ID_STREAM_SIDE_DATA,
+    SECTION_ID_STREAM_KEYFRAMES,
+    SECTION_ID_STREAM_KEYFRAME,
     SECTION_ID_SUBTITLE,
 } SectionID;
 
@@ -225,6 +239,8 @@ static struct section sections[] = {
     [SECTION_ID_FRAME_LOGS] =         { SECTION_ID_FRAME_LOGS, "logs", SECTION_FLAG_IS_ARRAY, { SECTION_ID_FRAME_LOG, -1 } },
     [SECTION_ID_FRAME_LOG] =          { SECTION_ID_FRAME_LOG, "log", 0, { -1 },  },
     [SECTION_ID_LIBRARY_VERSIONS] =   { SECTION_ID_LIBRARY_VERSIONS, "library_versions", SECTION_FLAG_IS_ARRAY, { SECTION_ID_LIBRARY_VERSION, -1 } },
+    [SECTION_ID_GOPS] =               { SECTION_ID_GOPS, "gops", SECTION_FLAG_IS_ARRAY, { SECTION_ID_GOP, -1 } },
+    [SECTION_ID_GOP] =                { SECTION_ID_GOP, "gop", 0, { -1 } },
     [SECTION_ID_LIBRARY_VERSION] =    { SECTION_ID_LIBRARY_VERSION, "library_version", 0, { -1 } },
     [SECTION_ID_PACKETS] =            { SECTION_ID_PACKETS, "packets", SECTION_FLAG_IS_ARRAY, { SECTION_ID_PACKET, -1} },
     [SECTION_ID_PACKETS_AND_FRAMES] = { SECTION_ID_PACKETS_AND_FRAMES, "packets_and_frames", SECTION_FLAG_IS_ARRAY, { SECTION_ID_PACKET, -1} },
@@ -247,14 +263,16 @@ static struct section sections[] = {
     [SECTION_ID_PROGRAMS] =                   { SECTION_ID_PROGRAMS, "programs", SECTION_FLAG_IS_ARRAY, { SECTION_ID_PROGRAM, -1 } },
     [SECTION_ID_ROOT] =               { SECTION_ID_ROOT, "root", SECTION_FLAG_IS_WRAPPER,
                                         { SECTION_ID_CHAPTERS, SECTION_ID_FORMAT, SECTION_ID_FRAMES, SECTION_ID_PROGRAMS, SECTION_ID_STREAMS,
-                                          SECTION_ID_PACKETS, SECTION_ID_ERROR, SECTION_ID_PROGRAM_VERSION, SECTION_ID_LIBRARY_VERSIONS,
+                                          SECTION_ID_PACKETS, SECTION_ID_GOPS, SECTION_ID_ERROR, SECTION_ID_PROGRAM_VERSION, SECTION_ID_LIBRARY_VERSIONS,
                                           SECTION_ID_PIXEL_FORMATS, -1} },
     [SECTION_ID_STREAMS] =            { SECTION_ID_STREAMS, "streams", SECTION_FLAG_IS_ARRAY, { SECTION_ID_STREAM, -1 } },
-    [SECTION_ID_STREAM] =             { SECTION_ID_STREAM, "stream", 0, { SECTION_ID_STREAM_DISPOSITION, SECTION_ID_STREAM_TAGS, SECTION_ID_STREAM_SIDE_DATA_LIST, -1 } },
+    [SECTION_ID_STREAM] =             { SECTION_ID_STREAM, "stream", 0, { SECTION_ID_STREAM_DISPOSITION, SECTION_ID_STREAM_TAGS, SECTION_ID_STREAM_SIDE_DATA_LIST, SECTION_ID_STREAM_KEYFRAMES, -1 } },
     [SECTION_ID_STREAM_DISPOSITION] = { SECTION_ID_STREAM_DISPOSITION, "disposition", 0, { -1 }, .unique_name = "stream_disposition" },
     [SECTION_ID_STREAM_TAGS] =        { SECTION_ID_STREAM_TAGS, "tags", SECTION_FLAG_HAS_VARIABLE_FIELDS, { -1 }, .element_name = "tag", .unique_name = "stream_tags" },
     [SECTION_ID_STREAM_SIDE_DATA_LIST] ={ SECTION_ID_STREAM_SIDE_DATA_LIST, "side_data_list", SECTION_FLAG_IS_ARRAY, { SECTION_ID_STREAM_SIDE_DATA, -1 }, .element_name = "side_data", .unique_name = "stream_side_data_list" },
     [SECTION_ID_STREAM_SIDE_DATA] =     { SECTION_ID_STREAM_SIDE_DATA, "side_data", 0, { -1 } },
+    [SECTION_ID_STREAM_KEYFRAMES] =   { SECTION_ID_STREAM_KEYFRAMES, "keyframes", SECTION_FLAG_IS_ARRAY, { SECTION_ID_STREAM_KEYFRAME, -1 }, .element_name = "keyframe" },
+    [SECTION_ID_STREAM_KEYFRAME] =    { SECTION_ID_STREAM_KEYFRAME, "keyframe", 0, { -1 } },
     [SECTION_ID_SUBTITLE] =           { SECTION_ID_SUBTITLE, "subtitle", 0, { -1 } },
 };
 
@@ -263,6 +281,8 @@ static const OptionDef *options;
 /* FFprobe context */
 static const char *input_filename;
 static const char *print_input_filename;
+static const char *batch_input;
+static int batch_jobs;
 static const AVInputFormat *iformat = NULL;
 
 static struct AVHashContext *hash;
@@ -291,6 +311,16 @@ static uint64_t *nb_streams_packets;
 static uint64_t *nb_streams_frames;
 static int *selected_streams;
 
+/* what the index of a stream tells, see -count_from_index */
+typedef struct IndexStats {
+    int complete;               ///< the index has an entry for every packet
+    uint64_t nb_keyframes;
+    int64_t bit_rate;
+    int64_t max_bit_rate;       ///< highest rate over one second
+} IndexStats;
+
+static IndexStats *index_stats;
+
 #if HAVE_THREADS
 pthread_mutex_t log_mutex;
 #endif
@@ -2519,9 +2549,12 @@ static int read_interval_packets(WriterContext *w, InputFile *ifile,
             REALLOCZ_ARRAY_STREAM(nb_streams_frames,  nb_streams, fmt_ctx->nb_streams);
             REALLOCZ_ARRAY_STREAM(nb_streams_packets, nb_streams, fmt_ctx->nb_streams);
             REALLOCZ_ARRAY_STREAM(selected_streams,   nb_streams, fmt_ctx->nb_streams);
+            REALLOCZ_ARRAY_STREAM(index_stats,        nb_streams, fmt_ctx->nb_streams);
             nb_streams = fmt_ctx->nb_streams;
         }
-        if (selected_streams[pkt->stream_index]) {
+        /* packets queued while probing come even from discarded streams */
+        if (selected_streams[pkt->stream_index] &&
+            fmt_ctx->streams[pkt->stream_index]->discard < AVDISCARD_ALL) {
             AVRational tb = ifile->streams[pkt->stream_index].st->time_base;
 
             if (pkt->pts != AV_NOPTS_VALUE)
@@ -2595,6 +2628,178 @@ static int read_packets(WriterContext *w, InputFile *ifile)
     return ret;
 }
 
+typedef struct GopFrame {
+    int64_t pts;
+    int decode_index;
+    enum AVPictureType pict_type;
+} GopFrame;
+
+/* GOP being gathered for a video stream, see -show_gops */
+typedef struct GopState {
+    AVCodecContext *avctx;
+    AVCodecParserContext *parser;
+    GopFrame *frames;           ///< frames from the keyframe on, in decode order
+    unsigned nb_frames;
+    int64_t key_pos;
+    int64_t size;
+    int64_t end_pts;
+    int pts_missing;
+    int types_missing;
+} GopState;
+
+static int compare_gop_frames(const void *a, const void *b)
+{
+    const GopFrame *fa = a, *fb = b;
+    return FFDIFFSIGN(fa->pts, fb->pts);
+}
+
+static void show_gop(WriterContext *w, AVStream *st, GopState *g, int64_t next_key_pts)
+{
+    int64_t key_pts = g->frames[0].pts, duration = AV_NOPTS_VALUE;
+    int i, closed = 1, reorder = 0, b_run = 0, max_b_run = 0;
+    char val_str[128];
+
+    if (!g->pts_missing) {
+        /* leading pictures: decoded after the keyframe but shown before it */
+        for (i = 1; i < g->nb_frames; i++)
+            if (g->frames[i].pts < key_pts)
+                closed = 0;
+        duration = (next_key_pts != AV_NOPTS_VALUE ? next_key_pts : g->end_pts) - key_pts;
+
+        qsort(g->frames, g->nb_frames, sizeof(*g->frames), compare_gop_frames);
+        for (i = 0; i < g->nb_frames; i++) {
+            reorder = FFMAX(reorder, g->frames[i].decode_index - i);
+            b_run   = g->frames[i].pict_type == AV_PICTURE_TYPE_B ? b_run + 1 : 0;
+            max_b_run = FFMAX(max_b_run, b_run);
+        }
+    }
+
+    writer_print_section_header(w, SECTION_ID_GOP);
+    print_int ("stream_index",  st->index);
+    print_ts  ("pts",           key_pts);
+    print_time("pts_time",      key_pts, &st->time_base);
+    print_duration_ts  ("duration",      duration);
+    print_duration_time("duration_time", duration, &st->time_base);
+    if (g->key_pos != -1) print_int    ("pos", g->key_pos);
+    else                  print_str_opt("pos", "N/A");
+    print_val ("size",          g->size, unit_byte_str);
+    print_int ("nb_frames",     g->nb_frames);
+    if (!g->pts_missing) print_int    ("closed", closed);
+    else                 print_str_opt("closed", "N/A");
+    if (!g->pts_missing && !g->types_missing) print_int    ("max_b_frames", max_b_run);
+    else                                      print_str_opt("max_b_frames", "N/A");
+    /* one frame of delay for plain B-frames, one more for each pyramid level */
+    if (!g->pts_missing) print_int    ("b_pyramid_depth", FFMAX(reorder - 1, 0));
+    else                 print_str_opt("b_pyramid_depth", "N/A");
+    writer_print_section_footer(w);
+
+    g->nb_frames     = 0;
+    g->size          = 0;
+    g->end_pts       = INT64_MIN;
+    g->pts_missing   = 0;
+    g->types_missing = 0;
+}
+
+/**
+ * Print the GOPs of the selected video streams. The keyframes and picture
+ * types come from the parser of the codec when there is one, and from the
+ * packet flags otherwise; nothing is decoded.
+ */
+static int show_gops(WriterContext *w, InputFile *ifile)
+{
+    AVFormatContext *fmt_ctx = ifile->fmt_ctx;
+    int nb_gop_streams = fmt_ctx->nb_streams;
+    GopState *gops = av_calloc(nb_gop_streams, sizeof(*gops));
+    AVPacket *pkt = av_packet_alloc();
+    int i, ret = 0;
+
+    if (!gops || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (i = 0; i < nb_gop_streams; i++) {
+        AVStream *st = fmt_ctx->streams[i];
+        GopState *g = &gops[i];
+
+        if (!selected_streams[i] || st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO)
+            continue;
+        g->avctx = avcodec_alloc_context3(NULL);
+        if (!g->avctx) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = avcodec_parameters_to_context(g->avctx, st->codecpar)) < 0)
+            goto end;
+        g->parser = av_parser_init(st->codecpar->codec_id);
+        if (g->parser)
+            g->parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
+        g->end_pts = INT64_MIN;
+    }
+
+    writer_print_section_header(w, SECTION_ID_GOPS);
+    while ((ret = av_read_frame(fmt_ctx, pkt)) >= 0) {
+        GopState *g = pkt->stream_index < nb_gop_streams ? &gops[pkt->stream_index] : NULL;
+        enum AVPictureType pict_type = AV_PICTURE_TYPE_NONE;
+        int key = !!(pkt->flags & AV_PKT_FLAG_KEY);
+        int64_t pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+
+        if (!g || !g->avctx) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        if (g->parser) {
+            uint8_t *data;
+            int size;
+            av_parser_parse2(g->parser, g->avctx, &data, &size, pkt->data, pkt->size,
+                             pkt->pts, pkt->dts, pkt->pos);
+            pict_type = g->parser->pict_type;
+            if (g->parser->key_frame >= 0)
+                key = g->parser->key_frame;
+            else if (pict_type != AV_PICTURE_TYPE_NONE)
+                key = pict_type == AV_PICTURE_TYPE_I;
+        }
+
+        if (key && g->nb_frames)
+            show_gop(w, fmt_ctx->streams[pkt->stream_index], g, pts);
+        /* frames before the first keyframe are not part of any GOP */
+        if (key || g->nb_frames) {
+            if (!g->nb_frames)
+                g->key_pos = pkt->pos;
+            ret = av_reallocp_array(&g->frames, g->nb_frames + 1, sizeof(*g->frames));
+            if (ret < 0) {
+                g->nb_frames = 0;
+                break;
+            }
+            g->frames[g->nb_frames].pts          = pts;
+            g->frames[g->nb_frames].decode_index = g->nb_frames;
+            g->frames[g->nb_frames].pict_type    = pict_type;
+            g->nb_frames++;
+            g->size          += pkt->size;
+            g->pts_missing   |= pkt->pts == AV_NOPTS_VALUE;
+            g->types_missing |= pict_type == AV_PICTURE_TYPE_NONE;
+            if (pts != AV_NOPTS_VALUE)
+                g->end_pts = FFMAX(g->end_pts, pts + pkt->duration);
+        }
+        av_packet_unref(pkt);
+    }
+    for (i = 0; i < nb_gop_streams; i++)
+        if (gops[i].nb_frames)
+            show_gop(w, fmt_ctx->streams[i], &gops[i], AV_NOPTS_VALUE);
+    writer_print_section_footer(w);
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+end:
+    for (i = 0; gops && i < nb_gop_streams; i++) {
+        av_parser_close(gops[i].parser);
+        avcodec_free_context(&gops[i].avctx);
+        av_freep(&gops[i].frames);
+    }
+    av_freep(&gops);
+    av_packet_free(&pkt);
+    return ret;
+}
+
 static int show_stream(WriterContext *w, AVFormatContext *fmt_ctx, int stream_idx, InputStream *ist, int in_program)
 {
     AVStream *stream = ist->st;
@@ -2764,6 +2969,17 @@ static int show_stream(WriterContext *w, AVFormatContext *fmt_ctx, int stream_id
     else                                print_str_opt("nb_read_frames", "N/A");
     if (nb_streams_packets[stream_idx]) print_fmt    ("nb_read_packets", "%"PRIu64, nb_streams_packets[stream_idx]);
     else                                print_str_opt("nb_read_packets", "N/A");
+    if (do_count_from_index && index_stats[stream_idx].complete) {
+        const IndexStats *is = &index_stats[stream_idx];
+        print_fmt("nb_index_keyframes", "%"PRIu64, is->nb_keyframes);
+        if (is->bit_rate > 0) print_val    ("index_bit_rate", is->bit_rate, unit_bit_per_second_str);
+        else                  print_str_opt("index_bit_rate", "N/A");
+        print_val("index_max_bit_rate", is->max_bit_rate, unit_bit_per_second_str);
+    } else if (do_count_from_index) {
+        print_str_opt("nb_index_keyframes", "N/A");
+        print_str_opt("index_bit_rate", "N/A");
+        print_str_opt("index_max_bit_rate", "N/A");
+    }
     if (do_show_data)
         writer_print_data(w, "extradata", par->extradata,
                                           par->extradata_size);
@@ -2809,6 +3025,25 @@ static int show_stream(WriterContext *w, AVFormatContext *fmt_ctx, int stream_id
                             SECTION_ID_STREAM_SIDE_DATA);
     }
 
+    if (do_count_from_index && do_show_stream_keyframes && !in_program &&
+        index_stats[stream->index].complete) {
+        int i, nb_entries = avformat_index_get_entries_count(stream);
+
+        writer_print_section_header(w, SECTION_ID_STREAM_KEYFRAMES);
+        for (i = 0; i < nb_entries; i++) {
+            const AVIndexEntry *e = avformat_index_get_entry(stream, i);
+            if (!(e->flags & AVINDEX_KEYFRAME))
+                continue;
+            writer_print_section_header(w, SECTION_ID_STREAM_KEYFRAME);
+            print_ts  ("timestamp", e->timestamp);
+            print_time("time",      e->timestamp, &stream->time_base);
+            print_fmt ("pos", "%"PRId64, e->pos);
+            print_int ("size",      e->size);
+            writer_print_section_footer(w);
+        }
+        writer_print_section_footer(w);
+    }
+
     writer_print_section_footer(w);
     av_bprint_finalize(&pbuf, NULL);
     fflush(stdout);
@@ -3083,6 +3318,82 @@ static void close_input_file(InputFile *ifile)
     avformat_close_input(&ifile->fmt_ctx);
 }
 
+/**
+ * Fill the packet counts, and the frame counts of the video streams, from the
+ * index of the streams that have an entry for every packet, such as the ones
+ * built from the MP4/MOV sample tables or the AVI idx1 chunk. Matroska cues
+ * only list keyframes, and MP4/MOV edit lists mark entries to be discarded, so
+ * those streams still have to be read.
+ *
+ * @return the number of selected streams that still have to be read
+ */
+static int count_from_index(InputFile *ifile)
+{
+    AVFormatContext *fmt_ctx = ifile->fmt_ctx;
+    int i, j, k, nb_left = 0;
+
+    for (i = 0; i < fmt_ctx->nb_streams; i++) {
+        AVStream *st = fmt_ctx->streams[i];
+        IndexStats *is = &index_stats[i];
+        int nb_entries = avformat_index_get_entries_count(st);
+        int64_t one_sec = av_rescale_q(AV_TIME_BASE, AV_TIME_BASE_Q, st->time_base);
+        int64_t total = 0, window = 0, duration;
+        const AVIndexEntry *first, *last;
+        int nb_empty = 0;
+
+        if (!selected_streams[i])
+            continue;
+        is->complete = st->nb_frames > 0 && nb_entries == st->nb_frames;
+        /* the samples an edit list cuts are still read, and their frames
+         * dropped, so their entries do not tell what reading gives */
+        for (j = 0; is->complete && j < nb_entries; j++)
+            if (avformat_index_get_entry(st, j)->flags & AVINDEX_DISCARD_FRAME)
+                is->complete = 0;
+        if (!is->complete) {
+            av_log(NULL, AV_LOG_VERBOSE, "The index of stream #%d is not complete, reading it\n", i);
+            nb_left++;
+            continue;
+        }
+
+        for (j = k = 0; j < nb_entries; j++) {
+            const AVIndexEntry *e = avformat_index_get_entry(st, j);
+            if (e->flags & AVINDEX_KEYFRAME)
+                is->nb_keyframes++;
+            if (!e->size)
+                nb_empty++;
+            total  += e->size;
+            window += e->size;
+            while (e->timestamp - avformat_index_get_entry(st, k)->timestamp >= one_sec)
+                window -= avformat_index_get_entry(st, k++)->size;
+            is->max_bit_rate = FFMAX(is->max_bit_rate, window * 8);
+        }
+        first    = avformat_index_get_entry(st, 0);
+        last     = avformat_index_get_entry(st, nb_entries - 1);
+        duration = st->duration > 0 ? st->duration : last->timestamp - first->timestamp;
+        if (duration > 0)
+            is->bit_rate = av_rescale(total * 8, st->time_base.den,
+                                      duration * st->time_base.num);
+
+        if (do_count_packets)
+            nb_streams_packets[i] = nb_entries;
+        /* video decoders give one frame per packet, audio decoders can drop
+         * the frames covered by the encoder delay. MPEG-4 packets can hold
+         * two frames (AVI packed bitstream) or none (N-VOP), and empty AVI
+         * chunks give no frame either. */
+        if (do_count_frames) {
+            if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO &&
+                st->codecpar->codec_id != AV_CODEC_ID_MPEG4 && !nb_empty &&
+                (first->flags & AVINDEX_KEYFRAME)) {
+                nb_streams_frames[i] = nb_entries;
+            } else {
+                nb_streams_packets[i] = 0;
+                nb_left++;
+            }
+        }
+    }
+    return nb_left;
+}
+
 static int probe_file(WriterContext *wctx, const char *filename,
                       const char *print_filename)
 {
@@ -3103,6 +3414,7 @@ static int probe_file(WriterContext *wctx, const char *filename,
     REALLOCZ_ARRAY_STREAM(nb_streams_frames,0,ifile.fmt_ctx->nb_streams);
     REALLOCZ_ARRAY_STREAM(nb_streams_packets,0,ifile.fmt_ctx->nb_streams);
     REALLOCZ_ARRAY_STREAM(selected_streams,0,ifile.fmt_ctx->nb_streams);
+    REALLOCZ_ARRAY_STREAM(index_stats,0,ifile.fmt_ctx->nb_streams);
 
     for (i = 0; i < ifile.fmt_ctx->nb_streams; i++) {
         if (stream_specifier) {
@@ -3120,6 +3432,26 @@ static int probe_file(WriterContext *wctx, const char *filename,
             ifile.fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
     }
 
+    if (do_show_gops) {
+        ret = show_gops(wctx, &ifile);
+        CHECK_END;
+        /* read the input again for the packets and frames */
+        if ((do_read_frames || do_read_packets) &&
+            (ret = avformat_seek_file(ifile.fmt_ctx, -1, INT64_MIN, 0, 0, 0)) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Could not seek back to the start after -show_gops\n");
+            goto end;
+        }
+    }
+
+    if (do_count_from_index && !do_show_frames && !do_show_packets && !read_intervals_nb) {
+        /* only read the streams whose counts are not in the index */
+        if (!count_from_index(&ifile))
+            do_read_frames = do_read_packets = 0;
+        for (i = 0; i < ifile.fmt_ctx->nb_streams; i++)
+            if (nb_streams_packets[i] || nb_streams_frames[i])
+                ifile.fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
     if (do_read_frames || do_read_packets) {
         if (do_show_frames && do_show_packets &&
             wctx->writer->flags & WRITER_FLAG_PUT_PACKETS_AND_FRAMES_IN_SAME_CHAPTER)
@@ -3160,6 +3492,7 @@ end:
     av_freep(&nb_streams_frames);
     av_freep(&nb_streams_packets);
     av_freep(&selected_streams);
+    av_freep(&index_stats);
 
     return ret;
 }
@@ -3620,6 +3953,7 @@ DEFINE_OPT_SHOW_SECTION(chapters,         CHAPTERS)
 DEFINE_OPT_SHOW_SECTION(error,            ERROR)
 DEFINE_OPT_SHOW_SECTION(format,           FORMAT)
 DEFINE_OPT_SHOW_SECTION(frames,           FRAMES)
+DEFINE_OPT_SHOW_SECTION(gops,             GOPS)
 DEFINE_OPT_SHOW_SECTION(library_versions, LIBRARY_VERSIONS)
 DEFINE_OPT_SHOW_SECTION(packets,          PACKETS)
 DEFINE_OPT_SHOW_SECTION(pixel_formats,    PIXEL_FORMATS)
@@ -3648,6 +3982,7 @@ static const OptionDef real_options[] = {
     { "show_error",   0, { .func_arg = &opt_show_error },  "show probing error" },
     { "show_format",  0, { .func_arg = &opt_show_format }, "show format/container info" },
     { "show_frames",  0, { .func_arg = &opt_show_frames }, "show frames info" },
+    { "show_gops",    0, { .func_arg = &opt_show_gops }, "show the keyframes and GOP structure of the video streams, without decoding" },
     { "show_format_entry", HAS_ARG, {.func_arg = opt_show_format_entry},
       "show a particular entry from the format/container info", "entry" },
     { "show_entries", HAS_ARG, {.func_arg = opt_show_entries},
@@ -3661,6 +3996,7 @@ static const OptionDef real_options[] = {
     { "show_chapters", 0, { .func_arg = &opt_show_chapters }, "show chapters info" },
     { "count_frames", OPT_BOOL, { &do_count_frames }, "count the number of frames per stream" },
     { "count_packets", OPT_BOOL, { &do_count_packets }, "count the number of packets per stream" },
+    { "count_from_index", OPT_BOOL, { &do_count_from_index }, "take the counts from the index of the streams when it is complete" },
     { "show_program_version",  0, { .func_arg = &opt_show_program_version },  "show ffprobe version" },
     { "show_library_versions", 0, { .func_arg = &opt_show_library_versions }, "show library versions" },
     { "show_versions",         0, { .func_arg = &opt_show_versions }, "show program and library versions" },
@@ -3673,6 +4009,8 @@ static const OptionDef real_options[] = {
     { "default", HAS_ARG | OPT_AUDIO | OPT_VIDEO | OPT_EXPERT, {.func_arg = opt_default}, "generic catch all option", "" },
     { "i", HAS_ARG, {.func_arg = opt_input_file_i}, "read specified file", "input_file"},
     { "print_filename", HAS_ARG, {.func_arg = opt_print_filename}, "override the printed input filename", "print_file"},
+    { "batch", OPT_STRING | HAS_ARG, { &batch_input }, "probe the inputs listed in this file, or - for stdin, writing one JSON line each", "file" },
+    { "batch_jobs", OPT_INT | HAS_ARG, { &batch_jobs }, "number of inputs probed at the same time in batch mode", "n" },
     { "find_stream_info", OPT_BOOL | OPT_INPUT | OPT_EXPERT, { &find_stream_info },
         "read and decode the streams to fill missing information with heuristics" },
     { NULL, },
@@ -3695,6 +4033,263 @@ static inline int check_section_show_entries(int section_id)
             do_show_##varname = 1;                                      \
     } while (0)
 
+#if HAVE_FORK
+/*
+ * Batch mode: the inputs listed in batch_input are probed by up to batch_jobs
+ * processes forked once the libraries are set up, and the JSON output of each
+ * is written on one line. A failing or crashing child only affects the line of
+ * its own input.
+ */
+typedef struct BatchJob {
+    pid_t pid;
+    int fd;             ///< read end of the pipe with the output of the child
+    char *input;
+    AVBPrint out;
+} BatchJob;
+
+static av_noreturn void batch_probe(const char *input, int fd)
+{
+    WriterContext *wctx;
+    int ret;
+
+    if (dup2(fd, STDOUT_FILENO) < 0)
+        _exit(1);
+    close(fd);
+    ret = writer_open(&wctx, &json_writer, "compact=1", sections, FF_ARRAY_ELEMS(sections));
+    if (ret >= 0) {
+        writer_print_section_header(wctx, SECTION_ID_ROOT);
+        ret = probe_file(wctx, input, input);
+        if (ret < 0)
+            show_error(wctx, ret);
+        writer_print_section_footer(wctx);
+        writer_close(&wctx);
+    }
+    fflush(stdout);
+    _exit(ret < 0);
+}
+
+static void batch_write_record(BatchJob *job, int status)
+{
+    AVBPrint buf;
+    char *start, *end = NULL, *p, *q;
+
+    av_bprint_init(&buf, 1, AV_BPRINT_SIZE_UNLIMITED);
+    printf("{\"input\":\"%s\"", json_escape_str(&buf, job->input, NULL));
+
+    /* splice the members of the object written by the child */
+    start = WIFEXITED(status) && av_bprint_is_complete(&job->out) ?
+            strchr(job->out.str, '{') : NULL;
+    if (start)
+        end = strrchr(start, '}');
+    if (end) {
+        int in_string = 0;
+        /* drop the indentation and line breaks outside of the strings */
+        for (p = q = start + 1; p < end; p++) {
+            if (in_string && *p == '\\' && p + 1 < end) {
+                *q++ = *p++;
+                *q++ = *p;
+                continue;
+            }
+            if (*p == '"')
+                in_string = !in_string;
+            if (in_string || !av_isspace(*p))
+                *q++ = *p;
+        }
+        *q = 0;
+        if (start[1])
+            printf(",%s", start + 1);
+    } else if (WIFSIGNALED(status)) {
+        printf(",\"error\":{\"string\":\"terminated by signal %d\"}", WTERMSIG(status));
+    } else {
+        printf(",\"error\":{\"string\":\"no output, exit status %d\"}", WEXITSTATUS(status));
+    }
+    printf("}\n");
+    fflush(stdout);
+    av_bprint_finalize(&buf, NULL);
+}
+
+/* write the record of an input that could not be probed at all */
+static void batch_write_error(const char *input, int err)
+{
+    AVBPrint buf;
+
+    av_bprint_init(&buf, 1, AV_BPRINT_SIZE_UNLIMITED);
+    printf("{\"input\":\"%s\"", json_escape_str(&buf, input, NULL));
+    printf(",\"error\":{\"code\":%d,\"string\":\"%s\"}}\n", err,
+           json_escape_str(&buf, av_err2str(err), NULL));
+    fflush(stdout);
+    av_bprint_finalize(&buf, NULL);
+}
+
+/* read the next non-empty line of the list, of any length, into line */
+static int batch_next_input(FILE *list, AVBPrint *line)
+{
+    char buf[4096];
+
+    av_bprint_clear(line);
+    while (fgets(buf, sizeof(buf), list)) {
+        size_t len = strlen(buf);
+
+        av_bprint_append_data(line, buf, len);
+        if (!av_bprint_is_complete(line))
+            return AVERROR(ENOMEM);
+        if ((!len || buf[len - 1] != '\n') && !feof(list))
+            continue;
+        while (line->len && (line->str[line->len - 1] == '\n' ||
+                             line->str[line->len - 1] == '\r'))
+            line->str[--line->len] = 0;
+        if (line->len)
+            return 1;
+    }
+    /* a last line without a line break */
+    return line->len > 0;
+}
+
+static int batch_start(BatchJob *jobs, int nb_jobs, BatchJob *job, const char *input)
+{
+    int i, fd[2], ret;
+
+    job->input = av_strdup(input);
+    if (!job->input)
+        return AVERROR(ENOMEM);
+    if (pipe(fd) < 0) {
+        ret = AVERROR(errno);
+        av_freep(&job->input);
+        return ret;
+    }
+    /* the child must not write what is still buffered */
+    fflush(stdout);
+    job->pid = fork();
+    if (job->pid < 0) {
+        ret = AVERROR(errno);
+        job->pid = 0;
+        close(fd[0]);
+        close(fd[1]);
+        av_freep(&job->input);
+        return ret;
+    }
+    if (!job->pid) {
+        close(fd[0]);
+        for (i = 0; i < nb_jobs; i++)
+            if (jobs[i].pid)
+                close(jobs[i].fd);
+        batch_probe(input, fd[1]);
+    }
+    close(fd[1]);
+    job->fd = fd[0];
+    av_bprint_init(&job->out, 0, AV_BPRINT_SIZE_UNLIMITED);
+    return 0;
+}
+
+static int run_batch(void)
+{
+    FILE *list = strcmp(batch_input, "-") ? fopen(batch_input, "r") : stdin;
+    int nb_jobs = batch_jobs > 0 ? batch_jobs : av_cpu_count();
+    BatchJob *jobs = av_calloc(nb_jobs, sizeof(*jobs));
+    struct pollfd *fds = av_calloc(nb_jobs, sizeof(*fds));
+    int nb_running = 0, eof = 0, ret = 0, i;
+    AVBPrint line;
+
+    av_bprint_init(&line, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    if (!list) {
+        ret = AVERROR(errno);
+        av_log(NULL, AV_LOG_ERROR, "Cannot open %s: %s\n", batch_input, av_err2str(ret));
+        goto end;
+    }
+    if (!jobs || !fds) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    mark_section_show_entries(SECTION_ID_ERROR, 1, NULL);
+
+    while (!eof || nb_running) {
+        int nb_fds = 0;
+
+        for (i = 0; i < nb_jobs && !eof; i++) {
+            if (jobs[i].pid)
+                continue;
+            if ((ret = batch_next_input(list, &line)) <= 0) {
+                eof = 1;
+                break;
+            }
+            /* only this input fails, the next ones are still probed */
+            if ((ret = batch_start(jobs, nb_jobs, &jobs[i], line.str)) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Cannot start probing %s: %s\n", line.str, av_err2str(ret));
+                batch_write_error(line.str, ret);
+                ret = 0;
+                continue;
+            }
+            nb_running++;
+        }
+
+        for (i = 0; i < nb_jobs; i++) {
+            if (!jobs[i].pid)
+                continue;
+            fds[nb_fds].fd     = jobs[i].fd;
+            fds[nb_fds].events = POLLIN;
+            nb_fds++;
+        }
+        if (!nb_fds)
+            continue;
+        if (poll(fds, nb_fds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            ret = AVERROR(errno);
+            break;
+        }
+
+        for (i = 0, nb_fds = 0; i < nb_jobs; i++) {
+            BatchJob *job = &jobs[i];
+            char buf[4096];
+            ssize_t n;
+            int status;
+
+            if (!job->pid || !fds[nb_fds++].revents)
+                continue;
+            n = read(job->fd, buf, sizeof(buf));
+            if (n > 0) {
+                av_bprint_append_data(&job->out, buf, n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            close(job->fd);
+            while (waitpid(job->pid, &status, 0) < 0 && errno == EINTR)
+                ;
+            batch_write_record(job, status);
+            av_bprint_finalize(&job->out, NULL);
+            av_freep(&job->input);
+            job->pid = 0;
+            nb_running--;
+        }
+    }
+
+    /* only reached early on errors */
+    for (i = 0; i < nb_jobs && jobs; i++) {
+        if (!jobs[i].pid)
+            continue;
+        close(jobs[i].fd);
+        waitpid(jobs[i].pid, NULL, 0);
+        av_bprint_finalize(&jobs[i].out, NULL);
+        av_freep(&jobs[i].input);
+    }
+end:
+    if (list && list != stdin)
+        fclose(list);
+    av_bprint_finalize(&line, NULL);
+    av_free(jobs);
+    av_free(fds);
+    return ret;
+}
+#else
+static int run_batch(void)
+{
+    av_log(NULL, AV_LOG_ERROR, "Batch mode is not supported on this platform\n");
+    return AVERROR(ENOSYS);
+}
+#endif
+
 int main(int argc, char **argv)
 {
     const Writer *w;
@@ -3732,6 +4327,7 @@ int main(int argc, char **argv)
     SET_DO_SHOW(ERROR, error);
     SET_DO_SHOW(FORMAT, format);
     SET_DO_SHOW(FRAMES, frames);
+    SET_DO_SHOW(GOPS, gops);
     SET_DO_SHOW(LIBRARY_VERSIONS, library_versions);
     SET_DO_SHOW(PACKETS, packets);
     SET_DO_SHOW(PIXEL_FORMATS, pixel_formats);
@@ -3742,6 +4338,7 @@ int main(int argc, char **argv)
     SET_DO_SHOW(STREAMS, streams);
     SET_DO_SHOW(STREAM_DISPOSITION, stream_disposition);
     SET_DO_SHOW(PROGRAM_STREAM_DISPOSITION, stream_disposition);
+    SET_DO_SHOW(STREAM_KEYFRAMES, stream_keyframes);
 
     SET_DO_SHOW(CHAPTER_TAGS, chapter_tags);
     SET_DO_SHOW(FORMAT_TAGS, format_tags);
@@ -3798,6 +4395,18 @@ int main(int argc, char **argv)
         goto end;
     }
 
+    if (batch_input) {
+        if (input_filename) {
+            av_log(NULL, AV_LOG_ERROR, "-batch cannot be used with an input file\n");
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        if (w != &json_writer && w != &default_writer)
+            av_log(NULL, AV_LOG_WARNING, "-batch always writes JSON lines, ignoring the output format\n");
+        ret = run_batch();
+        goto end;
+    }
+
     if ((ret = writer_open(&wctx, w, w_args,
                            sections, FF_ARRAY_ELEMS(sections))) >= 0) {
         if (w == &xml_writer)
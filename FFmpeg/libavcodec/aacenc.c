@@ -553,19 +553,272 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+/*
+ * Get the context a job running on the given thread codes with.
+ */
+static AACEncContext *get_worker(AACEncContext *s, int threadnr)
+{
+    AACEncContext *ws;
+
+    if (!s->workers)
+        return s;
+    ws = &s->workers[threadnr];
+    memcpy(ws, s, offsetof(AACEncContext, workers));
+    return ws;
+}
+
+/*
+ * Return the index of the channel element starting at or containing
+ * the given channel, and the first channel of that element.
+ */
+static int find_element(const AACEncContext *s, int channel, int *start_ch)
+{
+    int i, chans;
+
+    *start_ch = 0;
+    for (i = 0; i < s->chan_map[0] - 1; i++) {
+        chans = s->chan_map[i + 1] == TYPE_CPE ? 2 : 1;
+        if (*start_ch + chans > channel)
+            break;
+        *start_ch += chans;
+    }
+    return i;
+}
+
+/*
+ * Choose the window of one channel, transform it and evaluate clipping.
+ */
+static int window_channel_job(AVCodecContext *avctx, void *arg, int channel, int threadnr)
+{
+    AACEncContext *s  = avctx->priv_data;
+    AACEncContext *ws = get_worker(s, threadnr);
+    FFPsyWindowInfo *wi = &s->windows[channel];
+    float *overlap, *samples2, *la;
+    SingleChannelElement *sce;
+    IndividualChannelStream *ics;
+    int start_ch, el, tag, w, k;
+    float clip_avoidance_factor;
+
+    el  = find_element(s, channel, &start_ch);
+    tag = s->chan_map[el + 1];
+    sce = &s->cpe[el].ch[channel - start_ch];
+    ics = &sce->ics;
+    ws->cur_channel = channel;
+    overlap  = &s->planar_samples[channel][0];
+    samples2 = overlap + 1024;
+    la       = samples2 + (448+64);
+    if (s->flushing)
+        la = NULL;
+    if (tag == TYPE_LFE) {
+        wi->window_type[0] = wi->window_type[1] = ONLY_LONG_SEQUENCE;
+        wi->window_shape   = 0;
+        wi->num_windows    = 1;
+        wi->grouping[0]    = 1;
+        wi->clipping[0]    = 0;
+
+        /* Only the lowest 12 coefficients are used in a LFE channel.
+         * The expression below results in only the bottom 8 coefficients
+         * being used for 11.025kHz to 16kHz sample rates.
+         */
+        ics->num_swb = s->samplerate_index >= 8 ? 1 : 3;
+    } else {
+        *wi = s->psy.model->window(&s->psy, samples2, la, channel,
+                                   ics->window_sequence[0]);
+    }
+    ics->window_sequence[1] = ics->window_sequence[0];
+    ics->window_sequence[0] = wi->window_type[0];
+    ics->use_kb_window[1]   = ics->use_kb_window[0];
+    ics->use_kb_window[0]   = wi->window_shape;
+    ics->num_windows        = wi->num_windows;
+    ics->swb_sizes          = s->psy.bands    [ics->num_windows == 8];
+    ics->num_swb            = tag == TYPE_LFE ? ics->num_swb : s->psy.num_bands[ics->num_windows == 8];
+    ics->max_sfb            = FFMIN(ics->max_sfb, ics->num_swb);
+    ics->swb_offset         = wi->window_type[0] == EIGHT_SHORT_SEQUENCE ?
+                                ff_swb_offset_128 [s->samplerate_index]:
+                                ff_swb_offset_1024[s->samplerate_index];
+    ics->tns_max_bands      = wi->window_type[0] == EIGHT_SHORT_SEQUENCE ?
+                                ff_tns_max_bands_128 [s->samplerate_index]:
+                                ff_tns_max_bands_1024[s->samplerate_index];
+
+    for (w = 0; w < ics->num_windows; w++)
+        ics->group_len[w] = wi->grouping[w];
+
+    /* Calculate input sample maximums and evaluate clipping risk */
+    clip_avoidance_factor = 0.0f;
+    for (w = 0; w < ics->num_windows; w++) {
+        const float *wbuf = overlap + w * 128;
+        const int wlen = 2048 / ics->num_windows;
+        float max = 0;
+        int j;
+        /* mdct input is 2 * output */
+        for (j = 0; j < wlen; j++)
+            max = FFMAX(max, fabsf(wbuf[j]));
+        wi->clipping[w] = max;
+    }
+    for (w = 0; w < ics->num_windows; w++) {
+        if (wi->clipping[w] > CLIP_AVOIDANCE_FACTOR) {
+            ics->window_clipping[w] = 1;
+            clip_avoidance_factor = FFMAX(clip_avoidance_factor, wi->clipping[w]);
+        } else {
+            ics->window_clipping[w] = 0;
+        }
+    }
+    if (clip_avoidance_factor > CLIP_AVOIDANCE_FACTOR) {
+        ics->clip_avoidance_factor = CLIP_AVOIDANCE_FACTOR / clip_avoidance_factor;
+    } else {
+        ics->clip_avoidance_factor = 1.0f;
+    }
+
+    apply_window_and_mdct(ws, sce, overlap);
+
+    if (s->options.ltp && s->coder->update_ltp) {
+        s->coder->update_ltp(ws, sce);
+        apply_window[sce->ics.window_sequence[0]](ws->fdsp, sce, &sce->ltp_state[0]);
+        ws->mdct1024.mdct_calc(&ws->mdct1024, sce->lcoeffs, sce->ret_buf);
+    }
+
+    for (k = 0; k < 1024; k++) {
+        if (!(fabs(sce->coeffs[k]) < 1E16)) { // Ensure headroom for energy calculation
+            av_log(avctx, AV_LOG_ERROR, "Input contains (near) NaN/+-Inf\n");
+            return AVERROR(EINVAL);
+        }
+    }
+    avoid_clipping(ws, sce);
+
+    return 0;
+}
+
+/*
+ * Search the quantizers and TNS filter of one channel.
+ */
+static int search_channel_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    AACEncContext *s  = avctx->priv_data;
+    AACEncContext *ws = get_worker(s, threadnr);
+    SingleChannelElement *sce;
+    int channel = *(const int *)arg + jobnr;
+    int start_ch, el;
+
+    el  = find_element(s, channel, &start_ch);
+    sce = &s->cpe[el].ch[channel - start_ch];
+    ws->cur_channel      = channel;
+    ws->cur_type         = s->chan_map[el + 1];
+    ws->psy.bitres.alloc = s->bitres_alloc[el];
+
+    if (s->options.pns && s->coder->mark_pns)
+        s->coder->mark_pns(ws, avctx, sce);
+    s->coder->search_for_quantizers(avctx, ws, sce, s->lambda);
+    if (s->options.tns && s->coder->search_for_tns)
+        s->coder->search_for_tns(ws, sce);
+    if (s->options.tns && s->coder->apply_tns_filt)
+        s->coder->apply_tns_filt(ws, sce);
+
+    return 0;
+}
+
+/*
+ * Apply the stereo and prediction tools to one channel element and write it.
+ */
+static int encode_element_job(AVCodecContext *avctx, void *arg, int el, int threadnr)
+{
+    AACEncContext *s  = avctx->priv_data;
+    AACEncContext *ws = get_worker(s, threadnr);
+    ChannelElement *cpe = &s->cpe[el];
+    SingleChannelElement *sce;
+    int tag   = s->chan_map[el + 1];
+    int chans = tag == TYPE_CPE ? 2 : 1;
+    int i, ch, start_ch = 0, tag_index = 0, changed = 0;
+
+    for (i = 0; i < el; i++) {
+        start_ch  += s->chan_map[i + 1] == TYPE_CPE ? 2 : 1;
+        tag_index += s->chan_map[i + 1] == tag;
+    }
+
+    ws->cur_channel = start_ch;
+    if (s->options.intensity_stereo) { /* Intensity Stereo */
+        if (s->coder->search_for_is)
+            s->coder->search_for_is(ws, avctx, cpe);
+        if (cpe->is_mode) changed = 1;
+        apply_intensity_stereo(cpe);
+    }
+    if (s->options.pred) { /* Prediction */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            ws->cur_channel = start_ch + ch;
+            if (s->options.pred && s->coder->search_for_pred)
+                s->coder->search_for_pred(ws, sce);
+            if (cpe->ch[ch].ics.predictor_present) changed = 1;
+        }
+        if (s->coder->adjust_common_pred)
+            s->coder->adjust_common_pred(ws, cpe);
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            ws->cur_channel = start_ch + ch;
+            if (s->options.pred && s->coder->apply_main_pred)
+                s->coder->apply_main_pred(ws, sce);
+        }
+        ws->cur_channel = start_ch;
+    }
+    if (s->options.mid_side) { /* Mid/Side stereo */
+        if (s->options.mid_side == -1 && s->coder->search_for_ms)
+            s->coder->search_for_ms(ws, cpe);
+        else if (cpe->common_window)
+            memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
+        apply_mid_side_stereo(cpe);
+    }
+    adjust_frame_information(cpe, chans);
+    if (s->options.ltp) { /* LTP */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            ws->cur_channel = start_ch + ch;
+            if (s->coder->search_for_ltp)
+                s->coder->search_for_ltp(ws, sce, cpe->common_window);
+            if (sce->ics.ltp.present) changed = 1;
+        }
+        ws->cur_channel = start_ch;
+        if (s->coder->adjust_common_ltp)
+            s->coder->adjust_common_ltp(ws, cpe);
+    }
+
+    /* Without workers, ws is s and the element goes straight into the packet */
+    if (s->workers)
+        init_put_bits(&ws->pb, s->element_buf + 8192 * start_ch, 8192 * chans);
+    put_bits(&ws->pb, 3, tag);
+    put_bits(&ws->pb, 4, tag_index);
+    if (chans == 2) {
+        put_bits(&ws->pb, 1, cpe->common_window);
+        if (cpe->common_window) {
+            put_ics_info(ws, &cpe->ch[0].ics);
+            if (s->coder->encode_main_pred)
+                s->coder->encode_main_pred(ws, &cpe->ch[0]);
+            if (s->coder->encode_ltp_info)
+                s->coder->encode_ltp_info(ws, &cpe->ch[0], 1);
+            encode_ms_info(&ws->pb, cpe);
+            if (cpe->ms_mode) changed = 1;
+        }
+    }
+    for (ch = 0; ch < chans; ch++) {
+        ws->cur_channel = start_ch + ch;
+        encode_individual_channel(avctx, ws, &cpe->ch[ch], cpe->common_window);
+    }
+    if (s->workers) {
+        s->element_bits[el] = put_bits_count(&ws->pb);
+        flush_put_bits(&ws->pb);
+    }
+    s->coeffs_changed[el] = changed;
+
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
     AACEncContext *s = avctx->priv_data;
-    float **samples = s->planar_samples, *samples2, *la, *overlap;
     ChannelElement *cpe;
     SingleChannelElement *sce;
-    IndividualChannelStream *ics;
-    int i, its, ch, w, chans, tag, start_ch, ret, frame_bits;
+    int i, its, ch, w, chans, tag, start_ch, first_ch, ret, frame_bits;
     int target_bits, rate_bits, too_many_bits, too_few_bits;
-    int ms_mode = 0, is_mode = 0, tns_mode = 0, pred_mode = 0;
-    int chan_el_counter[4];
-    FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
+    int coeffs_changed = 0;
 
     /* add current frame to queue */
     if (frame) {
@@ -583,101 +836,12 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
     if (!avctx->frame_number)
         return 0;
 
-    start_ch = 0;
-    for (i = 0; i < s->chan_map[0]; i++) {
-        FFPsyWindowInfo* wi = windows + start_ch;
-        tag      = s->chan_map[i+1];
-        chans    = tag == TYPE_CPE ? 2 : 1;
-        cpe      = &s->cpe[i];
-        for (ch = 0; ch < chans; ch++) {
-            int k;
-            float clip_avoidance_factor;
-            sce = &cpe->ch[ch];
-            ics = &sce->ics;
-            s->cur_channel = start_ch + ch;
-            overlap  = &samples[s->cur_channel][0];
-            samples2 = overlap + 1024;
-            la       = samples2 + (448+64);
-            if (!frame)
-                la = NULL;
-            if (tag == TYPE_LFE) {
-                wi[ch].window_type[0] = wi[ch].window_type[1] = ONLY_LONG_SEQUENCE;
-                wi[ch].window_shape   = 0;
-                wi[ch].num_windows    = 1;
-                wi[ch].grouping[0]    = 1;
-                wi[ch].clipping[0]    = 0;
-
-                /* Only the lowest 12 coefficients are used in a LFE channel.
-                 * The expression below results in only the bottom 8 coefficients
-                 * being used for 11.025kHz to 16kHz sample rates.
-                 */
-                ics->num_swb = s->samplerate_index >= 8 ? 1 : 3;
-            } else {
-                wi[ch] = s->psy.model->window(&s->psy, samples2, la, s->cur_channel,
-                                              ics->window_sequence[0]);
-            }
-            ics->window_sequence[1] = ics->window_sequence[0];
-            ics->window_sequence[0] = wi[ch].window_type[0];
-            ics->use_kb_window[1]   = ics->use_kb_window[0];
-            ics->use_kb_window[0]   = wi[ch].window_shape;
-            ics->num_windows        = wi[ch].num_windows;
-            ics->swb_sizes          = s->psy.bands    [ics->num_windows == 8];
-            ics->num_swb            = tag == TYPE_LFE ? ics->num_swb : s->psy.num_bands[ics->num_windows == 8];
-            ics->max_sfb            = FFMIN(ics->max_sfb, ics->num_swb);
-            ics->swb_offset         = wi[ch].window_type[0] == EIGHT_SHORT_SEQUENCE ?
-                                        ff_swb_offset_128 [s->samplerate_index]:
-                                        ff_swb_offset_1024[s->samplerate_index];
-            ics->tns_max_bands      = wi[ch].window_type[0] == EIGHT_SHORT_SEQUENCE ?
-                                        ff_tns_max_bands_128 [s->samplerate_index]:
-                                        ff_tns_max_bands_1024[s->samplerate_index];
-
-            for (w = 0; w < ics->num_windows; w++)
-                ics->group_len[w] = wi[ch].grouping[w];
-
-            /* Calculate input sample maximums and evaluate clipping risk */
-            clip_avoidance_factor = 0.0f;
-            for (w = 0; w < ics->num_windows; w++) {
-                const float *wbuf = overlap + w * 128;
-                const int wlen = 2048 / ics->num_windows;
-                float max = 0;
-                int j;
-                /* mdct input is 2 * output */
-                for (j = 0; j < wlen; j++)
-                    max = FFMAX(max, fabsf(wbuf[j]));
-                wi[ch].clipping[w] = max;
-            }
-            for (w = 0; w < ics->num_windows; w++) {
-                if (wi[ch].clipping[w] > CLIP_AVOIDANCE_FACTOR) {
-                    ics->window_clipping[w] = 1;
-                    clip_avoidance_factor = FFMAX(clip_avoidance_factor, wi[ch].clipping[w]);
-                } else {
-                    ics->window_clipping[w] = 0;
-                }
-            }
-            if (clip_avoidance_factor > CLIP_AVOIDANCE_FACTOR) {
-                ics->clip_avoidance_factor = CLIP_AVOIDANCE_FACTOR / clip_avoidance_factor;
-            } else {
-                ics->clip_avoidance_factor = 1.0f;
-            }
+    s->flushing = !frame;
+    avctx->execute2(avctx, window_channel_job, NULL, s->job_ret, s->channels);
+    for (ch = 0; ch < s->channels; ch++)
+        if (s->job_ret[ch] < 0)
+            return s->job_ret[ch];
 
-            apply_window_and_mdct(s, sce, overlap);
-
-            if (s->options.ltp && s->coder->update_ltp) {
-                s->coder->update_ltp(s, sce);
-                apply_window[sce->ics.window_sequence[0]](s->fdsp, sce, &sce->ltp_state[0]);
-                s->mdct1024.mdct_calc(&s->mdct1024, sce->lcoeffs, sce->ret_buf);
-            }
-
-            for (k = 0; k < 1024; k++) {
-                if (!(fabs(cpe->ch[ch].coeffs[k]) < 1E16)) { // Ensure headroom for energy calculation
-                    av_log(avctx, AV_LOG_ERROR, "Input contains (near) NaN/+-Inf\n");
-                    return AVERROR(EINVAL);
-                }
-            }
-            avoid_clipping(s, sce);
-        }
-        start_ch += chans;
-    }
     if ((ret = ff_alloc_packet(avctx, avpkt, 8192 * s->channels)) < 0)
         return ret;
     frame_bits = its = 0;
@@ -686,11 +850,14 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
         if ((avctx->frame_number & 0xFF)==1 && !(avctx->flags & AV_CODEC_FLAG_BITEXACT))
             put_bitstream_info(s, LIBAVCODEC_IDENT);
-        start_ch = 0;
+
+        /* The psy model carries its bit reservoir state from one channel to
+         * the next, so the analysis runs in order; the quantizer search and
+         * TNS are independent for each channel. */
+        start_ch = first_ch = 0;
         target_bits = 0;
-        memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
-            FFPsyWindowInfo* wi = windows + start_ch;
+            FFPsyWindowInfo* wi = s->windows + start_ch;
             const float *coeffs[2];
             tag      = s->chan_map[i+1];
             chans    = tag == TYPE_CPE ? 2 : 1;
@@ -698,8 +865,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             cpe->common_window = 0;
             memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
             memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             for (ch = 0; ch < chans; ch++) {
                 sce = &cpe->ch[ch];
                 coeffs[ch] = sce->coeffs;
@@ -721,13 +886,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
                 s->psy.bitres.alloc /= chans;
             }
-            s->cur_type = tag;
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                if (s->options.pns && s->coder->mark_pns)
-                    s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
-            }
+            s->bitres_alloc[i] = s->psy.bitres.alloc;
             if (chans > 1
                 && wi[0].window_type[0] == wi[1].window_type[0]
                 && wi[0].window_shape   == wi[1].window_shape) {
@@ -740,82 +899,49 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     }
                 }
             }
-            for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
+            if (!s->searched) {
+                /* The first quantizer search may set psy.cutoff, which the
+                 * analysis of the following elements then uses. */
+                for (ch = 0; ch < chans; ch++)
+                    search_channel_job(avctx, &first_ch, ch, 0);
+                if (s->workers)
+                    s->psy.cutoff = s->workers[0].psy.cutoff;
+                s->searched = 1;
+                first_ch = chans;
+            }
+            start_ch += chans;
+        }
+
+        avctx->execute2(avctx, search_channel_job, &first_ch, NULL,
+                        s->channels - first_ch);
+
+        /* PNS draws from the shared noise generator, so it also runs in order */
+        start_ch = 0;
+        for (i = 0; i < s->chan_map[0]; i++) {
+            chans = s->chan_map[i+1] == TYPE_CPE ? 2 : 1;
+            cpe   = &s->cpe[i];
+            for (ch = 0; ch < chans; ch++) {
                 sce = &cpe->ch[ch];
                 s->cur_channel = start_ch + ch;
-                if (s->options.tns && s->coder->search_for_tns)
-                    s->coder->search_for_tns(s, sce);
-                if (s->options.tns && s->coder->apply_tns_filt)
-                    s->coder->apply_tns_filt(s, sce);
                 if (sce->tns.present)
-                    tns_mode = 1;
+                    coeffs_changed = 1;
                 if (s->options.pns && s->coder->search_for_pns)
                     s->coder->search_for_pns(s, avctx, sce);
             }
-            s->cur_channel = start_ch;
-            if (s->options.intensity_stereo) { /* Intensity Stereo */
-                if (s->coder->search_for_is)
-                    s->coder->search_for_is(s, avctx, cpe);
-                if (cpe->is_mode) is_mode = 1;
-                apply_intensity_stereo(cpe);
-            }
-            if (s->options.pred) { /* Prediction */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->search_for_pred)
-                        s->coder->search_for_pred(s, sce);
-                    if (cpe->ch[ch].ics.predictor_present) pred_mode = 1;
-                }
-                if (s->coder->adjust_common_pred)
-                    s->coder->adjust_common_pred(s, cpe);
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->apply_main_pred)
-                        s->coder->apply_main_pred(s, sce);
-                }
-                s->cur_channel = start_ch;
-            }
-            if (s->options.mid_side) { /* Mid/Side stereo */
-                if (s->options.mid_side == -1 && s->coder->search_for_ms)
-                    s->coder->search_for_ms(s, cpe);
-                else if (cpe->common_window)
-                    memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
-                apply_mid_side_stereo(cpe);
-            }
-            adjust_frame_information(cpe, chans);
-            if (s->options.ltp) { /* LTP */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->coder->search_for_ltp)
-                        s->coder->search_for_ltp(s, sce, cpe->common_window);
-                    if (sce->ics.ltp.present) pred_mode = 1;
-                }
-                s->cur_channel = start_ch;
-                if (s->coder->adjust_common_ltp)
-                    s->coder->adjust_common_ltp(s, cpe);
-            }
-            if (chans == 2) {
-                put_bits(&s->pb, 1, cpe->common_window);
-                if (cpe->common_window) {
-                    put_ics_info(s, &cpe->ch[0].ics);
-                    if (s->coder->encode_main_pred)
-                        s->coder->encode_main_pred(s, &cpe->ch[0]);
-                    if (s->coder->encode_ltp_info)
-                        s->coder->encode_ltp_info(s, &cpe->ch[0], 1);
-                    encode_ms_info(&s->pb, cpe);
-                    if (cpe->ms_mode) ms_mode = 1;
-                }
-            }
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                encode_individual_channel(avctx, s, &cpe->ch[ch], cpe->common_window);
-            }
             start_ch += chans;
         }
 
+        avctx->execute2(avctx, encode_element_job, NULL, NULL, s->chan_map[0]);
+
+        start_ch = 0;
+        for (i = 0; i < s->chan_map[0]; i++) {
+            if (s->workers)
+                ff_copy_bits(&s->pb, s->element_buf + 8192 * start_ch, s->element_bits[i]);
+            if (s->coeffs_changed[i])
+                coeffs_changed = 1;
+            start_ch += s->chan_map[i+1] == TYPE_CPE ? 2 : 1;
+        }
+
         if (avctx->flags & AV_CODEC_FLAG_QSCALE) {
             /* When using a constant Q-scale, don't mess with lambda */
             break;
@@ -861,7 +987,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             if (ratio > 0.9f && ratio < 1.1f) {
                 break;
             } else {
-                if (is_mode || ms_mode || tns_mode || pred_mode) {
+                if (coeffs_changed) {
                     for (i = 0; i < s->chan_map[0]; i++) {
                         // Must restore coeffs
                         chans = tag == TYPE_CPE ? 2 : 1;
@@ -899,6 +1025,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int aac_encode_end(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
+    int i;
 
     av_log(avctx, AV_LOG_INFO, "Qavg: %.3f\n", s->lambda_count ? s->lambda_sum / s->lambda_count : NAN);
 
@@ -906,6 +1033,10 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     ff_mdct_end(&s->mdct128);
     ff_psy_end(&s->psy);
     ff_lpc_end(&s->lpc);
+    for (i = 0; i < s->nb_workers; i++)
+        ff_lpc_end(&s->workers[i].lpc);
+    av_freep(&s->workers);
+    av_freep(&s->element_buf);
     if (s->psypp)
         ff_psy_preprocess_end(s->psypp);
     av_freep(&s->buffer.samples);
@@ -947,6 +1078,26 @@ static av_cold int alloc_buffers(AVCodecContext *avctx, AACEncContext *s)
     return 0;
 }
 
+static av_cold int alloc_workers(AVCodecContext *avctx, AACEncContext *s)
+{
+    int i, ret;
+
+    s->workers     = av_calloc(avctx->thread_count, sizeof(*s->workers));
+    s->element_buf = av_malloc(8192 * s->channels);
+    if (!s->workers || !s->element_buf)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < avctx->thread_count; i++) {
+        ret = ff_lpc_init(&s->workers[i].lpc, 2*avctx->frame_size, TNS_MAX_ORDER,
+                          FF_LPC_TYPE_LEVINSON);
+        if (ret < 0)
+            return ret;
+        s->nb_workers++;
+    }
+
+    return 0;
+}
+
 static av_cold int aac_encode_init(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
@@ -1098,6 +1249,12 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
     if (HAVE_MIPSDSP)
         ff_aac_coder_init_mips(s);
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1 &&
+        s->channels > 1) {
+        if ((ret = alloc_workers(avctx, s)) < 0)
+            return ret;
+    }
+
     ff_af_queue_init(avctx, &s->afq);
     ff_aac_tableinit();
 
@@ -1145,7 +1302,8 @@ const AVCodec ff_aac_encoder = {
     .defaults       = aac_encode_defaults,
     .supported_samplerates = mpeg4audio_sample_rates,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_INIT_CLEANUP,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_FLTP,
                                                      AV_SAMPLE_FMT_NONE },
     .priv_class     = &aacenc_class,
@@ -379,7 +379,6 @@ static const AACPCEInfo aac_pce_configs[] = {
 typedef struct AACEncContext {
     AVClass *av_class;
     AACEncOptions options;                       ///< encoding options
-    PutBitContext pb;
     FFTContext mdct1024;                         ///< long (1024 samples) frame transform context
     FFTContext mdct128;                          ///< short (128 samples) frame transform context
     AVFloatDSPContext *fdsp;
@@ -388,7 +387,6 @@ typedef struct AACEncContext {
 
     int profile;                                 ///< copied from avctx
     int needs_pce;                               ///< flag for non-standard layout
-    LPCContext lpc;                              ///< used by TNS
     int samplerate_index;                        ///< MPEG-4 samplerate index
     int channels;                                ///< channel count
     const uint8_t *reorder_map;                  ///< lavc to aac reorder map
@@ -398,20 +396,13 @@ typedef struct AACEncContext {
     FFPsyContext psy;
     struct FFPsyPreprocessContext* psypp;
     const AACCoefficientsEncoder *coder;
-    int cur_channel;                             ///< current channel for coder context
     int random_state;
     float lambda;
     int last_frame_pb_count;                     ///< number of bits for the previous frame
     float lambda_sum;                            ///< sum(lambda), for Qvg reporting
     int lambda_count;                            ///< count(lambda), for Qvg reporting
-    enum RawDataBlockType cur_type;              ///< channel group type cur_channel belongs to
 
     AudioFrameQueue afq;
-    DECLARE_ALIGNED(16, int,   qcoefs)[96];      ///< quantized coefficients
-    DECLARE_ALIGNED(32, float, scoefs)[1024];    ///< scaled coefficients
-
-    uint16_t quantize_band_cost_cache_generation;
-    AACQuantizeBandCostCacheEntry quantize_band_cost_cache[256][128]; ///< memoization area for quantize_band_cost
 
     void (*abs_pow34)(float *out, const float *in, const int size);
     void (*quant_bands)(int *out, const float *in, const float *scaled,
@@ -421,6 +412,34 @@ typedef struct AACEncContext {
     struct {
         float *samples;
     } buffer;
+
+    /* With slice threads, each thread codes into its own copy of the fields
+     * above, and each element is written into its own buffer, the buffers
+     * being concatenated in order afterwards. */
+    struct AACEncContext *workers;
+    int nb_workers;
+    uint8_t *element_buf;                        ///< 8192 bytes per channel
+
+    /* state of the frame being encoded, shared by the channel and element jobs */
+    FFPsyWindowInfo windows[16];                 ///< window decisions for each channel
+    int flushing;                                ///< no lookahead samples are available
+    int searched;                                ///< the quantizer search has run at least once
+    int bitres_alloc[16];                        ///< psy bit allocation for each element
+    int element_bits[16];                        ///< number of bits written for each element
+    int coeffs_changed[16];                      ///< IS, M/S or prediction changed the element coefficients
+    int job_ret[16];                             ///< return codes of the channel jobs
+
+    /* scratch state of the coding functions, private to each worker */
+    PutBitContext pb;
+    LPCContext lpc;                              ///< used by TNS
+    int cur_channel;                             ///< current channel for coder context
+    enum RawDataBlockType cur_type;              ///< channel group type cur_channel belongs to
+
+    DECLARE_ALIGNED(16, int,   qcoefs)[96];      ///< quantized coefficients
+    DECLARE_ALIGNED(32, float, scoefs)[1024];    ///< scaled coefficients
+
+    uint16_t quantize_band_cost_cache_generation;
+    AACQuantizeBandCostCacheEntry quantize_band_cost_cache[256][128]; ///< memoization area for quantize_band_cost
 } AACEncContext;
 
 void ff_aac_dsp_init_x86(AACEncContext *s);
@@ -308,6 +308,19 @@ typedef struct RcOverride{
  * Discard cropping information from SPS.
  */
 #define AV_CODEC_FLAG2_IGNORE_CROP    (1 << 16)
+/**
+ * Keep frame threading but return each frame as soon as it is decoded
+ * instead of after thread_count - 1 frames of delay (decoding only).
+ *
+ * This changes the meaning of AVERROR(EAGAIN) from avcodec_receive_frame():
+ * it no longer implies that more input is needed before a frame can be
+ * returned. While frames are still being decoded by the threads, a later
+ * call may return one without any avcodec_send_packet() in between, so the
+ * caller may poll avcodec_receive_frame() when it has no input to send.
+ * Sending a packet whenever one is available still gives the best
+ * throughput, since the threads only decode ahead with pending input.
+ */
+#define AV_CODEC_FLAG2_LOW_LATENCY_THREADS (1 << 17)
 
 /**
  * Show all frames before the first keyframe
@@ -2024,6 +2037,22 @@ typedef struct AVCodecContext {
      * - decoding: unused
      */
     int (*get_encode_buffer)(struct AVCodecContext *s, AVPacket *pkt, int flags);
+
+    /**
+     * Run the slice threading jobs on a process-wide pool of worker threads
+     * shared by all codec contexts setting this field, instead of creating
+     * thread_count - 1 threads for this context. thread_count still limits
+     * the number of jobs of this context running at the same time.
+     * The value is the number of threads of the pool, -1 for automatic; it is
+     * only used by the context creating the pool. 0 disables the shared pool.
+     * Frame threading is not affected, nor are decoders whose slice jobs wait
+     * on each other or run alongside a main function (VP9 tiles), which keep
+     * their own threads.
+     *
+     * - encoding: Set by user.
+     * - decoding: Set by user.
+     */
+    int thread_pool_size;
 } AVCodecContext;
 
 struct MpegEncContext;
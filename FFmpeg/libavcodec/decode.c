@@ -304,6 +304,20 @@ static inline int decode_simple_internal(AVCodecContext *avctx, AVFrame *frame,
     if (!pkt->data && !avci->draining) {
         av_packet_unref(pkt);
         ret = ff_decode_get_packet(avctx, pkt);
+        if (ret == AVERROR(EAGAIN) && HAVE_THREADS &&
+            avctx->active_thread_type & FF_THREAD_FRAME &&
+            avctx->flags2 & AV_CODEC_FLAG2_LOW_LATENCY_THREADS) {
+            /* no more input for now, return a frame finished meanwhile,
+             * with the same post-processing as the decoded ones */
+            got_frame = 0;
+            ret = ff_thread_get_finished_frame(avctx, frame, &got_frame);
+            if (ret < 0)
+                return ret;
+            if (!got_frame)
+                return AVERROR(EAGAIN);
+            ret = 0;
+            goto finished;
+        }
         if (ret < 0 && ret != AVERROR_EOF)
             return ret;
     }
@@ -340,6 +354,7 @@ static inline int decode_simple_internal(AVCodecContext *avctx, AVFrame *frame,
             }
         }
     }
+finished:
     emms_c();
     actual_got_frame = got_frame;
 
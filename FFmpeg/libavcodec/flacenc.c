@@ -90,7 +90,7 @@ typedef struct FlacSubframe {
     uint64_t rc_sums[32][MAX_PARTITIONS];
 
     int32_t samples[FLAC_MAX_BLOCKSIZE];
-    int32_t residual[FLAC_MAX_BLOCKSIZE+11];
+    int32_t residual[FLAC_MAX_BLOCKSIZE+23]; ///< padded for the SIMD lpc16_encode
 } FlacSubframe;
 
 typedef struct FlacFrame {
@@ -116,7 +116,6 @@ typedef struct FlacEncodeContext {
     uint32_t frame_count;
     uint64_t sample_count;
     uint8_t md5sum[16];
-    FlacFrame frame;
     CompressionOptions options;
     AVCodecContext *avctx;
     LPCContext lpc_ctx;
@@ -128,8 +127,26 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    /* with slice threads, frames are queued and encoded in parallel batches */
+    struct FlacEncodeJob *jobs;
+    int nb_jobs;
+    int nb_queued;               ///< number of frames queued for the next batch
+    int nb_encoded;              ///< number of frames encoded by the last batch
+    int next_output;             ///< next encoded frame of the batch to output
+
+    FlacFrame frame;             ///< must be last, see init_jobs()
 } FlacEncodeContext;
 
+typedef struct FlacEncodeJob {
+    uint8_t *buf;
+    unsigned int buf_size;
+    int size;                    ///< size of the encoded frame or error code
+    int64_t pts;
+    int nb_samples;
+    FlacEncodeContext ctx;       ///< per-frame encoding state, must be last
+} FlacEncodeJob;
+
 
 /**
  * Write streaminfo metadata block to byte array.
@@ -238,6 +255,36 @@ static av_cold void dprint_compression_options(FlacEncodeContext *s)
 }
 
 
+static av_cold int init_jobs(FlacEncodeContext *s)
+{
+    AVCodecContext *avctx = s->avctx;
+    int i, ret;
+
+    s->jobs = av_calloc(avctx->thread_count, sizeof(*s->jobs));
+    if (!s->jobs)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < avctx->thread_count; i++) {
+        FlacEncodeContext *c = &s->jobs[i].ctx;
+
+        /* the frame is the last field and is set up for each frame, so
+         * avoid touching its pages here */
+        memcpy(c, s, offsetof(FlacEncodeContext, frame));
+        c->jobs   = NULL;
+        c->md5ctx = NULL;
+        memset(&c->lpc_ctx, 0, sizeof(c->lpc_ctx));
+        s->nb_jobs++;
+
+        ret = ff_lpc_init(&c->lpc_ctx, avctx->frame_size,
+                          s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+
 static av_cold int flac_encode_init(AVCodecContext *avctx)
 {
     int freq = avctx->sample_rate;
@@ -422,14 +469,22 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
 
     ret = ff_lpc_init(&s->lpc_ctx, avctx->frame_size,
                       s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+    if (ret < 0)
+        return ret;
 
     ff_bswapdsp_init(&s->bdsp);
     ff_flacdsp_init(&s->flac_dsp, avctx->sample_fmt, channels,
                     avctx->bits_per_raw_sample);
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1) {
+        ret = init_jobs(s);
+        if (ret < 0)
+            return ret;
+    }
+
     dprint_compression_options(s);
 
-    return ret;
+    return 0;
 }
 
 
@@ -1276,9 +1331,9 @@ static void write_frame_footer(FlacEncodeContext *s)
 }
 
 
-static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
+static int write_frame(FlacEncodeContext *s, uint8_t *buf, int buf_size)
 {
-    init_put_bits(&s->pb, avpkt->data, avpkt->size);
+    init_put_bits(&s->pb, buf, buf_size);
     write_frame_header(s);
     write_subframes(s);
     write_frame_footer(s);
@@ -1286,10 +1341,11 @@ static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
 }
 
 
-static int update_md5_sum(FlacEncodeContext *s, const void *samples)
+static int update_md5_sum(FlacEncodeContext *s, const void *samples,
+                          int nb_samples)
 {
     const uint8_t *buf;
-    int buf_size = s->frame.blocksize * s->channels *
+    int buf_size = nb_samples * s->channels *
                    ((s->avctx->bits_per_raw_sample + 7) / 8);
 
     if (s->avctx->bits_per_raw_sample > 16 || HAVE_BIGENDIAN) {
@@ -1310,7 +1366,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+        for (i = 0; i < nb_samples * s->channels; i++) {
             int32_t v = samples0[i] >> 8;
             AV_WL24(tmp + 3*i, v);
         }
@@ -1322,6 +1378,136 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
+/**
+ * Encode the samples copied to s->frame.
+ * @return the size of the encoded frame or a negative error code
+ */
+static int compress_frame(FlacEncodeContext *s)
+{
+    int frame_bytes;
+
+    channel_decorrelation(s);
+
+    remove_wasted_bits(s);
+
+    frame_bytes = encode_frame(s);
+
+    /* Fall back on verbatim mode if the compressed frame is larger than it
+       would be if encoded uncompressed. */
+    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
+        s->frame.verbatim_only = 1;
+        frame_bytes = encode_frame(s);
+        if (frame_bytes < 0) {
+            av_log(s->avctx, AV_LOG_ERROR, "Bad frame count\n");
+            return frame_bytes;
+        }
+    }
+
+    return frame_bytes;
+}
+
+
+static int encode_job(AVCodecContext *avctx, void *arg)
+{
+    FlacEncodeJob *job   = arg;
+    FlacEncodeContext *s = &job->ctx;
+    int frame_bytes;
+
+    frame_bytes = compress_frame(s);
+    if (frame_bytes < 0) {
+        job->size = frame_bytes;
+        return 0;
+    }
+
+    av_fast_malloc(&job->buf, &job->buf_size, frame_bytes);
+    if (!job->buf) {
+        job->size = AVERROR(ENOMEM);
+        return 0;
+    }
+
+    job->size = write_frame(s, job->buf, frame_bytes);
+    return 0;
+}
+
+
+static void update_frame_stats(FlacEncodeContext *s, AVPacket *avpkt,
+                               int64_t pts, int nb_samples, int out_bytes)
+{
+    s->sample_count += nb_samples;
+    if (out_bytes > s->max_encoded_framesize)
+        s->max_encoded_framesize = out_bytes;
+    if (out_bytes < s->min_framesize)
+        s->min_framesize = out_bytes;
+
+    avpkt->pts      = pts;
+    avpkt->duration = ff_samples_to_time_base(s->avctx, nb_samples);
+
+    s->next_pts = avpkt->pts + avpkt->duration;
+}
+
+
+static int flac_encode_frame_threaded(AVCodecContext *avctx, AVPacket *avpkt,
+                                      const AVFrame *frame, int *got_packet_ptr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacEncodeJob *job;
+    int ret;
+
+    if (frame) {
+        FlacEncodeContext *c = &s->jobs[s->nb_queued].ctx;
+
+        /* change max_framesize for small final frame */
+        if (frame->nb_samples < s->frame.blocksize)
+            s->max_framesize = ff_flac_get_max_frame_size(frame->nb_samples,
+                                                          s->channels,
+                                                          avctx->bits_per_raw_sample);
+
+        s->frame.blocksize = frame->nb_samples;
+
+        c->max_framesize = s->max_framesize;
+        c->frame_count   = s->frame_count++;
+        init_frame(c, frame->nb_samples);
+        copy_samples(c, frame->data[0]);
+
+        if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+            return ret;
+        }
+
+        s->jobs[s->nb_queued].pts        = frame->pts;
+        s->jobs[s->nb_queued].nb_samples = frame->nb_samples;
+        s->nb_queued++;
+    }
+
+    /* all frames of the previous batch are returned before the next batch
+     * is full, so the jobs can be reused */
+    if (s->next_output == s->nb_encoded && s->nb_queued &&
+        (s->nb_queued == s->nb_jobs || !frame)) {
+        avctx->execute(avctx, encode_job, s->jobs, NULL, s->nb_queued,
+                       sizeof(*s->jobs));
+        s->nb_encoded  = s->nb_queued;
+        s->next_output = 0;
+        s->nb_queued   = 0;
+    }
+
+    if (s->next_output == s->nb_encoded)
+        return 0;
+
+    job = &s->jobs[s->next_output++];
+    if (job->size < 0)
+        return job->size;
+
+    if ((ret = ff_get_encode_buffer(avctx, avpkt, job->size, 0)) < 0)
+        return ret;
+    memcpy(avpkt->data, job->buf, job->size);
+
+    update_frame_stats(s, avpkt, job->pts, job->nb_samples, job->size);
+
+    *got_packet_ptr = 1;
+    return 0;
+}
+
+
 static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                              const AVFrame *frame, int *got_packet_ptr)
 {
@@ -1330,6 +1516,12 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     s = avctx->priv_data;
 
+    if (s->jobs) {
+        ret = flac_encode_frame_threaded(avctx, avpkt, frame, got_packet_ptr);
+        if (ret < 0 || *got_packet_ptr || frame)
+            return ret;
+    }
+
     /* when the last block is reached, update the header in extradata */
     if (!frame) {
         s->max_framesize = s->max_encoded_framesize;
@@ -1363,43 +1555,22 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     copy_samples(s, frame->data[0]);
 
-    channel_decorrelation(s);
-
-    remove_wasted_bits(s);
-
-    frame_bytes = encode_frame(s);
-
-    /* Fall back on verbatim mode if the compressed frame is larger than it
-       would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
-        s->frame.verbatim_only = 1;
-        frame_bytes = encode_frame(s);
-        if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
-            return frame_bytes;
-        }
-    }
+    frame_bytes = compress_frame(s);
+    if (frame_bytes < 0)
+        return frame_bytes;
 
     if ((ret = ff_get_encode_buffer(avctx, avpkt, frame_bytes, 0)) < 0)
         return ret;
 
-    out_bytes = write_frame(s, avpkt);
+    out_bytes = write_frame(s, avpkt->data, avpkt->size);
 
     s->frame_count++;
-    s->sample_count += frame->nb_samples;
-    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
+    if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
         av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
         return ret;
     }
-    if (out_bytes > s->max_encoded_framesize)
-        s->max_encoded_framesize = out_bytes;
-    if (out_bytes < s->min_framesize)
-        s->min_framesize = out_bytes;
 
-    avpkt->pts      = frame->pts;
-    avpkt->duration = ff_samples_to_time_base(avctx, frame->nb_samples);
-
-    s->next_pts = avpkt->pts + avpkt->duration;
+    update_frame_stats(s, avpkt, frame->pts, frame->nb_samples, out_bytes);
 
     av_shrink_packet(avpkt, out_bytes);
 
@@ -1411,10 +1582,16 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     FlacEncodeContext *s = avctx->priv_data;
+    int i;
 
     av_freep(&s->md5ctx);
     av_freep(&s->md5_buffer);
     ff_lpc_end(&s->lpc_ctx);
+    for (i = 0; i < s->nb_jobs; i++) {
+        av_freep(&s->jobs[i].buf);
+        ff_lpc_end(&s->jobs[i].ctx.lpc_ctx);
+    }
+    av_freep(&s->jobs);
     return 0;
 }
 
@@ -1463,7 +1640,7 @@ const AVCodec ff_flac_encoder = {
     .type           = AVMEDIA_TYPE_AUDIO,
     .id             = AV_CODEC_ID_FLAC,
     .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
-                      AV_CODEC_CAP_SMALL_LAST_FRAME,
+                      AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(FlacEncodeContext),
     .init           = flac_encode_init,
     .encode2        = flac_encode_frame,
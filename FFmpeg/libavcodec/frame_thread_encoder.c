@@ -50,7 +50,7 @@ typedef struct{
     AVCodecContext *parent_avctx;
     pthread_mutex_t buffer_mutex;
 
-    pthread_mutex_t task_fifo_mutex; /* Used to guard (next_)task_index */
+    pthread_mutex_t task_fifo_mutex; /* Used to guard (next_)task_index and nb_tasks_queued */
     pthread_cond_t task_fifo_cond;
 
     unsigned pthread_init_cnt;
@@ -60,22 +60,72 @@ typedef struct{
     pthread_cond_t finished_task_cond;
 
     unsigned next_task_index;
+    unsigned nb_tasks_queued;
     unsigned task_index;
     unsigned finished_task_index;
 
     pthread_t worker[MAX_THREADS];
     atomic_int exit;
+
+    /* Hand the frames to the workers in turn instead of to the first idle
+     * one, for the encoders whose output depends on which frames a worker
+     * has seen before. */
+    int round_robin;
+
+    /* In round robin mode, the workers share state with each other (the
+     * rate control of the parent context). They update it in input order:
+     * shared_turn is the number of input frames that have had their turn,
+     * frame_seq the input frame each worker is coding. */
+    pthread_mutex_t shared_mutex;
+    pthread_cond_t shared_cond;
+    unsigned shared_turn;
+    unsigned frame_seq[MAX_THREADS];
 } ThreadContext;
 
 #define OFF(member) offsetof(ThreadContext, member)
 DEFINE_OFFSET_ARRAY(ThreadContext, thread_ctx, pthread_init_cnt,
-                    (OFF(buffer_mutex), OFF(task_fifo_mutex), OFF(finished_task_mutex)),
-                    (OFF(task_fifo_cond), OFF(finished_task_cond)));
+                    (OFF(buffer_mutex), OFF(task_fifo_mutex), OFF(finished_task_mutex),
+                     OFF(shared_mutex)),
+                    (OFF(task_fifo_cond), OFF(finished_task_cond), OFF(shared_cond)));
 #undef OFF
 
+/* Must be called with shared_mutex locked. */
+static void wait_shared_turn(ThreadContext *c, unsigned frame_seq)
+{
+    while ((int)(c->shared_turn - frame_seq) < 0 && !atomic_load(&c->exit))
+        pthread_cond_wait(&c->shared_cond, &c->shared_mutex);
+}
+
+AVCodecContext *ff_frame_thread_encoder_lock_shared(AVCodecContext *avctx)
+{
+    ThreadContext *c = avctx->internal->frame_thread_encoder;
+
+    if (!c || !c->round_robin)
+        return NULL;
+
+    pthread_mutex_lock(&c->shared_mutex);
+    wait_shared_turn(c, c->frame_seq[avctx->internal->frame_thread_index]);
+    return c->parent_avctx;
+}
+
+void ff_frame_thread_encoder_unlock_shared(AVCodecContext *avctx)
+{
+    ThreadContext *c = avctx->internal->frame_thread_encoder;
+
+    c->shared_turn = c->frame_seq[avctx->internal->frame_thread_index] + 1;
+    pthread_cond_broadcast(&c->shared_cond);
+    pthread_mutex_unlock(&c->shared_mutex);
+}
+
 static void * attribute_align_arg worker(void *v){
     AVCodecContext *avctx = v;
     ThreadContext *c = avctx->internal->frame_thread_encoder;
+    /* In round robin mode, worker i encodes the frames i, i + thread_count,
+     * i + 2 * thread_count... so that the frames seen by each encoder
+     * instance, and with them its rate control state and output, do not
+     * depend on the scheduling. */
+    unsigned task_seq   = avctx->internal->frame_thread_index;
+    unsigned rr_index   = task_seq;
 
     while (!atomic_load(&c->exit)) {
         int got_packet = 0, ret;
@@ -85,15 +135,24 @@ static void * attribute_align_arg worker(void *v){
         unsigned task_index;
 
         pthread_mutex_lock(&c->task_fifo_mutex);
-        while (c->next_task_index == c->task_index || atomic_load(&c->exit)) {
+        while ((c->round_robin ? (int)(c->nb_tasks_queued - task_seq) <= 0
+                               : c->next_task_index == c->task_index) ||
+               atomic_load(&c->exit)) {
             if (atomic_load(&c->exit)) {
                 pthread_mutex_unlock(&c->task_fifo_mutex);
                 goto end;
             }
             pthread_cond_wait(&c->task_fifo_cond, &c->task_fifo_mutex);
         }
-        task_index         = c->next_task_index;
-        c->next_task_index = (c->next_task_index + 1) % c->max_tasks;
+        if (c->round_robin) {
+            task_index = rr_index;
+            c->frame_seq[avctx->internal->frame_thread_index] = task_seq;
+            task_seq  += avctx->internal->frame_thread_count;
+            rr_index   = (rr_index + avctx->internal->frame_thread_count) % c->max_tasks;
+        } else {
+            task_index         = c->next_task_index;
+            c->next_task_index = (c->next_task_index + 1) % c->max_tasks;
+        }
         pthread_mutex_unlock(&c->task_fifo_mutex);
         /* The main thread ensures that any two outstanding tasks have
          * different indices, ergo each worker thread owns its element
@@ -104,6 +163,17 @@ static void * attribute_align_arg worker(void *v){
         pkt   = task->outdata;
 
         ret = avctx->codec->encode2(avctx, pkt, frame, &got_packet);
+        if (c->round_robin) {
+            /* pass on the turn if the encoder did not take it */
+            unsigned frame_seq = c->frame_seq[avctx->internal->frame_thread_index];
+            pthread_mutex_lock(&c->shared_mutex);
+            wait_shared_turn(c, frame_seq);
+            if (c->shared_turn == frame_seq) {
+                c->shared_turn++;
+                pthread_cond_broadcast(&c->shared_cond);
+            }
+            pthread_mutex_unlock(&c->shared_mutex);
+        }
         if(got_packet) {
             int ret2 = av_packet_make_refcounted(pkt);
             if (ret >= 0 && ret2 < 0)
@@ -176,6 +246,31 @@ av_cold int ff_frame_thread_encoder_init(AVCodecContext *avctx)
         }
     }
 
+    if (avctx->codec_id == AV_CODEC_ID_MPEG2VIDEO ||
+        avctx->codec_id == AV_CODEC_ID_MPEG4) {
+        /* Frame threads change the rate controlled output, so they are only
+         * used if they are asked for alone; the default thread type keeps
+         * slice threading. */
+        if (avctx->thread_type & FF_THREAD_SLICE) {
+            avctx->thread_type &= ~FF_THREAD_FRAME;
+            return 0;
+        }
+        /* Only intra-only encodes have independent frames. VBV constraints
+         * and 2-pass statistics are not shared among the workers either. */
+        if (avctx->gop_size > 1 || avctx->max_b_frames ||
+            avctx->rc_buffer_size || avctx->rc_max_rate || avctx->rc_min_rate ||
+            avctx->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2) ||
+            (avctx->codec_id == AV_CODEC_ID_MPEG4 &&
+             avctx->workaround_bugs & FF_BUG_MS)) {
+            av_log(avctx, AV_LOG_VERBOSE,
+                   "Frame threading is only supported for intra-only %s encoding "
+                   "without VBV or 2-pass rate control, disabling frame threading\n",
+                   avctx->codec->name);
+            avctx->thread_type &= ~FF_THREAD_FRAME;
+            return 0;
+        }
+    }
+
     if(!avctx->thread_count) {
         avctx->thread_count = av_cpu_count();
         avctx->thread_count = FFMIN(avctx->thread_count, MAX_THREADS);
@@ -193,6 +288,8 @@ av_cold int ff_frame_thread_encoder_init(AVCodecContext *avctx)
         return AVERROR(ENOMEM);
 
     c->parent_avctx = avctx;
+    c->round_robin  = avctx->codec_id == AV_CODEC_ID_MPEG2VIDEO ||
+                      avctx->codec_id == AV_CODEC_ID_MPEG4;
 
     ret = ff_pthread_init(c, thread_ctx_offsets);
     if (ret < 0)
@@ -235,6 +332,8 @@ av_cold int ff_frame_thread_encoder_init(AVCodecContext *avctx)
             goto fail;
         av_assert0(!thread_avctx->internal->frame_thread_encoder);
         thread_avctx->internal->frame_thread_encoder = c;
+        thread_avctx->internal->frame_thread_index   = i;
+        thread_avctx->internal->frame_thread_count   = avctx->thread_count;
         if ((ret = pthread_create(&c->worker[i], NULL, worker, thread_avctx))) {
             ret = AVERROR(ret);
             goto fail;
@@ -266,6 +365,11 @@ av_cold void ff_frame_thread_encoder_free(AVCodecContext *avctx)
         pthread_cond_broadcast(&c->task_fifo_cond);
         pthread_mutex_unlock(&c->task_fifo_mutex);
 
+        /* wake the workers waiting for the turn of a frame that is dropped */
+        pthread_mutex_lock(&c->shared_mutex);
+        pthread_cond_broadcast(&c->shared_cond);
+        pthread_mutex_unlock(&c->shared_mutex);
+
         for (int i = 0; i < avctx->thread_count; i++)
             pthread_join(c->worker[i], NULL);
     }
@@ -292,7 +396,12 @@ int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
         pthread_mutex_lock(&c->task_fifo_mutex);
         c->task_index = (c->task_index + 1) % c->max_tasks;
-        pthread_cond_signal(&c->task_fifo_cond);
+        c->nb_tasks_queued++;
+        /* in round robin mode only one specific worker can take the task */
+        if (c->round_robin)
+            pthread_cond_broadcast(&c->task_fifo_cond);
+        else
+            pthread_cond_signal(&c->task_fifo_cond);
         pthread_mutex_unlock(&c->task_fifo_mutex);
     }
 
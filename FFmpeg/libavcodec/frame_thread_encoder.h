@@ -32,4 +32,21 @@ void ff_frame_thread_encoder_free(AVCodecContext *avctx);
 int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                                  AVFrame *frame, int *got_packet_ptr);
 
+/**
+ * Lock the state shared by the workers of a frame thread encoder, once the
+ * input frames before the one being encoded by avctx have had their turn.
+ * Only the workers of MPEG-2 and MPEG-4, which get the frames round robin,
+ * share state.
+ *
+ * @param avctx a worker context
+ * @return the parent context, whose private data holds the shared state, or
+ *         NULL if avctx shares no state; nothing is locked then
+ */
+AVCodecContext *ff_frame_thread_encoder_lock_shared(AVCodecContext *avctx);
+
+/**
+ * Unlock the shared state and hand the turn to the next input frame.
+ */
+void ff_frame_thread_encoder_unlock_shared(AVCodecContext *avctx);
+
 #endif /* AVCODEC_FRAME_THREAD_ENCODER_H */
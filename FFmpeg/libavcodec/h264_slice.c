@@ -2654,6 +2654,170 @@ static void decode_finish_row(const H264Context *h, H264SliceContext *sl)
                               h->picture_structure == PICT_BOTTOM_FIELD);
 }
 
+typedef struct DeblockRow {
+    int mb_y;
+    int start_x, end_x;
+    int finish;                 ///< the row is complete, call decode_finish_row()
+} DeblockRow;
+
+typedef struct H264DeblockThread {
+#if HAVE_THREADS
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+    int exit;
+
+    const H264Context *h;
+    /* copy of the slice context taken at the start of the slice, the
+     * filter caches of the decoding thread cannot be shared */
+    H264SliceContext sl;
+
+    DeblockRow *rows;
+    unsigned int rows_allocated;
+    int nb_rows;                ///< rows queued by the decoding thread
+    int nb_released;            ///< rows whose row below is reconstructed
+    int nb_done;                ///< rows filtered
+} H264DeblockThread;
+
+#if HAVE_THREADS
+static void *deblock_thread_main(void *arg)
+{
+    H264DeblockThread *dbt = arg;
+
+    pthread_mutex_lock(&dbt->mutex);
+    for (;;) {
+        DeblockRow row;
+
+        while (!dbt->exit && dbt->nb_done == dbt->nb_released)
+            pthread_cond_wait(&dbt->cond, &dbt->mutex);
+        if (dbt->exit)
+            break;
+        row = dbt->rows[dbt->nb_done];
+        pthread_mutex_unlock(&dbt->mutex);
+
+        dbt->sl.mb_y = row.mb_y;
+        loop_filter(dbt->h, &dbt->sl, row.start_x, row.end_x);
+        if (row.finish)
+            decode_finish_row(dbt->h, &dbt->sl);
+
+        pthread_mutex_lock(&dbt->mutex);
+        dbt->nb_done++;
+        pthread_cond_broadcast(&dbt->cond);
+    }
+    pthread_mutex_unlock(&dbt->mutex);
+    return NULL;
+}
+
+static H264DeblockThread *deblock_thread_get(H264Context *h)
+{
+    H264DeblockThread *dbt = h->dbt;
+
+    if (dbt)
+        return dbt;
+
+    dbt = av_mallocz(sizeof(*dbt));
+    if (!dbt)
+        goto fail;
+    if (pthread_mutex_init(&dbt->mutex, NULL)) {
+        av_freep(&dbt);
+        goto fail;
+    }
+    if (pthread_cond_init(&dbt->cond, NULL)) {
+        pthread_mutex_destroy(&dbt->mutex);
+        av_freep(&dbt);
+        goto fail;
+    }
+    if (pthread_create(&dbt->thread, NULL, deblock_thread_main, dbt)) {
+        pthread_cond_destroy(&dbt->cond);
+        pthread_mutex_destroy(&dbt->mutex);
+        av_freep(&dbt);
+        goto fail;
+    }
+    h->dbt = dbt;
+    return dbt;
+fail:
+    av_log(h->avctx, AV_LOG_WARNING, "Could not start the deblocking thread\n");
+    h->deblock_thread = 0;
+    return NULL;
+}
+
+static void deblock_thread_start(H264DeblockThread *dbt, const H264SliceContext *sl)
+{
+    pthread_mutex_lock(&dbt->mutex);
+    dbt->h  = sl->h264;
+    dbt->sl = *sl;
+    dbt->nb_rows = dbt->nb_released = dbt->nb_done = 0;
+    pthread_mutex_unlock(&dbt->mutex);
+}
+
+static void deblock_thread_queue(H264DeblockThread *dbt, const H264SliceContext *sl,
+                                 int start_x, int end_x, int finish)
+{
+    DeblockRow *row;
+
+    pthread_mutex_lock(&dbt->mutex);
+    row = &dbt->rows[dbt->nb_rows++];
+    row->mb_y    = sl->mb_y;
+    row->start_x = start_x;
+    row->end_x   = end_x;
+    row->finish  = finish;
+    /* the intra prediction of the next row needs this one unfiltered */
+    dbt->nb_released = dbt->nb_rows - 1;
+    pthread_cond_broadcast(&dbt->cond);
+    pthread_mutex_unlock(&dbt->mutex);
+}
+
+/* filter all the queued rows and wait for them */
+static void deblock_thread_flush(H264DeblockThread *dbt)
+{
+    pthread_mutex_lock(&dbt->mutex);
+    dbt->nb_released = dbt->nb_rows;
+    pthread_cond_broadcast(&dbt->cond);
+    while (dbt->nb_done < dbt->nb_rows)
+        pthread_cond_wait(&dbt->cond, &dbt->mutex);
+    pthread_mutex_unlock(&dbt->mutex);
+}
+#endif
+
+void ff_h264_deblock_thread_free(H264Context *h)
+{
+    H264DeblockThread *dbt = h->dbt;
+
+    if (!dbt)
+        return;
+#if HAVE_THREADS
+    pthread_mutex_lock(&dbt->mutex);
+    dbt->exit = 1;
+    pthread_cond_broadcast(&dbt->cond);
+    pthread_mutex_unlock(&dbt->mutex);
+    pthread_join(dbt->thread, NULL);
+    pthread_cond_destroy(&dbt->cond);
+    pthread_mutex_destroy(&dbt->mutex);
+#endif
+    av_freep(&dbt->rows);
+    av_freep(&h->dbt);
+}
+
+/**
+ * Filter the macroblocks start_x to end_x - 1 of the current row, then
+ * finish the row if it is complete. With the deblocking thread, the row is
+ * only queued.
+ */
+static void filter_row(const H264Context *h, H264SliceContext *sl,
+                       int start_x, int end_x, int finish)
+{
+#if HAVE_THREADS
+    if (sl->deblock_thread) {
+        deblock_thread_queue(sl->deblock_thread, sl, start_x, end_x, finish);
+        return;
+    }
+#endif
+    loop_filter(h, sl, start_x, end_x);
+    if (finish)
+        decode_finish_row(h, sl);
+}
+
 static void er_add_slice(H264SliceContext *sl,
                          int startx, int starty,
                          int endx, int endy, int status)
@@ -2687,6 +2851,12 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
 
     av_assert0(h->block_offset[15] == (4 * ((scan8[15] - scan8[0]) & 7) << h->pixel_shift) + 4 * sl->linesize * ((scan8[15] - scan8[0]) >> 3));
 
+#if HAVE_THREADS
+    if (sl->deblock_thread) {
+        deblock_thread_start(sl->deblock_thread, sl);
+        sl->deblocking_filter = 0;
+    }
+#endif
     if (h->postpone_filter)
         sl->deblocking_filter = 0;
 
@@ -2748,7 +2918,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                 er_add_slice(sl, sl->resync_mb_x, sl->resync_mb_y, sl->mb_x - 1,
                              sl->mb_y, ER_MB_END);
                 if (sl->mb_x >= lf_x_start)
-                    loop_filter(h, sl, lf_x_start, sl->mb_x + 1);
+                    filter_row(h, sl, lf_x_start, sl->mb_x + 1, 0);
                 goto finish;
             }
             if (sl->cabac.bytestream > sl->cabac.bytestream_end + 2 )
@@ -2764,9 +2934,8 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
             }
 
             if (++sl->mb_x >= h->mb_width) {
-                loop_filter(h, sl, lf_x_start, sl->mb_x);
+                filter_row(h, sl, lf_x_start, sl->mb_x, 1);
                 sl->mb_x = lf_x_start = 0;
-                decode_finish_row(h, sl);
                 ++sl->mb_y;
                 if (FIELD_OR_MBAFF_PICTURE(h)) {
                     ++sl->mb_y;
@@ -2781,7 +2950,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                 er_add_slice(sl, sl->resync_mb_x, sl->resync_mb_y, sl->mb_x - 1,
                              sl->mb_y, ER_MB_END);
                 if (sl->mb_x > lf_x_start)
-                    loop_filter(h, sl, lf_x_start, sl->mb_x);
+                    filter_row(h, sl, lf_x_start, sl->mb_x, 0);
                 goto finish;
             }
         }
@@ -2821,9 +2990,8 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
             }
 
             if (++sl->mb_x >= h->mb_width) {
-                loop_filter(h, sl, lf_x_start, sl->mb_x);
+                filter_row(h, sl, lf_x_start, sl->mb_x, 1);
                 sl->mb_x = lf_x_start = 0;
-                decode_finish_row(h, sl);
                 ++sl->mb_y;
                 if (FIELD_OR_MBAFF_PICTURE(h)) {
                     ++sl->mb_y;
@@ -2857,7 +3025,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                     er_add_slice(sl, sl->resync_mb_x, sl->resync_mb_y,
                                  sl->mb_x - 1, sl->mb_y, ER_MB_END);
                     if (sl->mb_x > lf_x_start)
-                        loop_filter(h, sl, lf_x_start, sl->mb_x);
+                        filter_row(h, sl, lf_x_start, sl->mb_x, 0);
 
                     goto finish;
                 } else {
@@ -2900,7 +3068,28 @@ int ff_h264_execute_decode_slices(H264Context *h)
         h->slice_ctx[0].next_slice_idx = h->mb_width * h->mb_height;
         h->postpone_filter = 0;
 
-        ret = decode_slice(avctx, &h->slice_ctx[0]);
+        sl = &h->slice_ctx[0];
+#if HAVE_THREADS
+        /* MBAFF frames and field pictures are filtered by the decoding thread */
+        if (h->deblock_thread && sl->deblocking_filter &&
+            !FRAME_MBAFF(h) && h->picture_structure == PICT_FRAME &&
+            deblock_thread_get(h)) {
+            av_fast_malloc(&h->dbt->rows, &h->dbt->rows_allocated,
+                           (h->mb_height + 1) * sizeof(*h->dbt->rows));
+            if (!h->dbt->rows) {
+                ret = AVERROR(ENOMEM);
+                goto finish;
+            }
+            sl->deblock_thread = h->dbt;
+        }
+#endif
+        ret = decode_slice(avctx, sl);
+#if HAVE_THREADS
+        if (sl->deblock_thread) {
+            deblock_thread_flush(sl->deblock_thread);
+            sl->deblock_thread = NULL;
+        }
+#endif
         h->mb_y = h->slice_ctx[0].mb_y;
         if (ret < 0)
             goto finish;
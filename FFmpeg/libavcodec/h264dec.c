@@ -349,6 +349,7 @@ static av_cold int h264_decode_end(AVCodecContext *avctx)
     H264Context *h = avctx->priv_data;
     int i;
 
+    ff_h264_deblock_thread_free(h);
     ff_h264_remove_all_refs(h);
     ff_h264_free_tables(h);
 
@@ -1063,6 +1064,7 @@ static const AVOption h264_options[] = {
     { "nal_length_size", "nal_length_size", OFFSET(nal_length_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 4, VDX },
     { "enable_er", "Enable error resilience on damaged frames (unsafe)", OFFSET(enable_er), AV_OPT_TYPE_BOOL, { .i64 = -1 }, -1, 1, VD },
     { "x264_build", "Assume this x264 version if no x264 version found in any SEI", OFFSET(x264_build), AV_OPT_TYPE_INT, {.i64 = -1}, -1, INT_MAX, VD },
+    { "deblock_thread", "Run the deblocking filter of single slice frames on a separate thread", OFFSET(deblock_thread), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, VD },
     { NULL },
 };
 
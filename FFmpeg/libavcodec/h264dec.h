@@ -342,6 +342,9 @@ typedef struct H264SliceContext {
     int delta_poc[2];
     int curr_pic_num;
     int max_pic_num;
+
+    /* set while the slice is decoded with the deblocking thread */
+    struct H264DeblockThread *deblock_thread;
 } H264SliceContext;
 
 /**
@@ -386,6 +389,13 @@ typedef struct H264Context {
      */
     int postpone_filter;
 
+    /**
+     * Filters single slice frames on a separate thread, one macroblock row
+     * behind the entropy decoding and reconstruction. Allocated on first use
+     * when the deblock_thread option is set.
+     */
+    struct H264DeblockThread *dbt;
+
     /*
      * Set to 1 when the current picture is IDR, 0 otherwise.
      */
@@ -563,6 +573,7 @@ typedef struct H264Context {
     int height_from_caller;
 
     int enable_er;
+    int deblock_thread;
 
     H264SEIContext sei;
 
@@ -861,6 +872,8 @@ void ff_h264_draw_horiz_band(const H264Context *h, H264SliceContext *sl, int y,
  */
 int ff_h264_queue_decode_slice(H264Context *h, const H2645NAL *nal);
 int ff_h264_execute_decode_slices(H264Context *h);
+
+void ff_h264_deblock_thread_free(H264Context *h);
 int ff_h264_update_thread_context(AVCodecContext *dst,
                                   const AVCodecContext *src);
 int ff_h264_update_thread_context_for_user(AVCodecContext *dst,
@@ -84,6 +84,12 @@
  * internal logic derive them from AVCodecInternal.last_pkt_props.
  */
 #define FF_CODEC_CAP_SETS_FRAME_PROPS       (1 << 8)
+/**
+ * The slice threading jobs of the codec wait on the progress of other jobs
+ * of the same call, so all of them must run at the same time. Such codecs
+ * keep their own slice threads even if thread_pool_size is set.
+ */
+#define FF_CODEC_CAP_SLICE_THREAD_SYNC_JOBS (1 << 9)
 
 /**
  * AVCodec.codec_tags termination value
@@ -162,6 +168,15 @@ typedef struct AVCodecInternal {
 
     void *frame_thread_encoder;
 
+    /**
+     * Set for the worker contexts of the frame thread encoder: the index of
+     * the worker and the number of workers. For MPEG-2 and MPEG-4, the worker
+     * encodes the input frames frame_thread_index + k * frame_thread_count
+     * of the parent context.
+     */
+    int frame_thread_index;
+    int frame_thread_count;
+
     EncodeSimpleContext es;
 
     /**
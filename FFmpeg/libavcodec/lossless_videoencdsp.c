@@ -88,11 +88,22 @@ static void sub_left_predict_c(uint8_t *dst, uint8_t *src,
     }
 }
 
+static int sum_abs_bytes_c(const uint8_t *src, intptr_t w)
+{
+    int i, sum = 0;
+
+    for (i = 0; i < w; i++)
+        sum += FFABS((int8_t)src[i]);
+
+    return sum;
+}
+
 av_cold void ff_llvidencdsp_init(LLVidEncDSPContext *c)
 {
     c->diff_bytes      = diff_bytes_c;
     c->sub_median_pred = sub_median_pred_c;
     c->sub_left_predict = sub_left_predict_c;
+    c->sum_abs_bytes   = sum_abs_bytes_c;
 
     if (ARCH_X86)
         ff_llvidencdsp_init_x86(c);
@@ -37,6 +37,12 @@ typedef struct LLVidEncDSPContext {
 
     void (*sub_left_predict)(uint8_t *dst, uint8_t *src,
                           ptrdiff_t stride, ptrdiff_t width, int height);
+
+    /**
+     * Sum of the absolute values of w bytes interpreted as signed,
+     * used as the cost of a prediction residual.
+     */
+    int (*sum_abs_bytes)(const uint8_t *src, intptr_t w);
 } LLVidEncDSPContext;
 
 void ff_llvidencdsp_init(LLVidEncDSPContext *c);
@@ -1421,28 +1421,17 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
-static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
-                             int Al, const uint8_t *mb_bitmask,
-                             int mb_bitmask_size,
-                             const AVFrame *reference)
+/* Decode the MCUs from mb_start to mb_end (excluded) in raster order. */
+static int decode_scan_mcus(MJpegDecodeContext *s, int nb_components, int Ah,
+                            int Al, GetBitContext *mb_bitmask_gb,
+                            const AVFrame *reference, int mb_start, int mb_end)
 {
-    int i, mb_x, mb_y, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
+    int i, mb, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
     uint8_t *data[MAX_COMPONENTS];
     const uint8_t *reference_data[MAX_COMPONENTS];
     int linesize[MAX_COMPONENTS];
-    GetBitContext mb_bitmask_gb = {0}; // initialize to silence gcc warning
     int bytes_per_pixel = 1 + (s->bits > 8);
 
-    if (mb_bitmask) {
-        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
-            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
-            return AVERROR_INVALIDDATA;
-        }
-        init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
-    }
-
-    s->restart_count = 0;
-
     av_pix_fmt_get_chroma_sub_sample(s->avctx->pix_fmt, &chroma_h_shift,
                                      &chroma_v_shift);
     chroma_width  = AV_CEIL_RSHIFT(s->width,  chroma_h_shift);
@@ -1453,95 +1442,192 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
         data[c] = s->picture_ptr->data[c];
         reference_data[c] = reference ? reference->data[c] : NULL;
         linesize[c] = s->linesize[c];
-        s->coefs_finished[c] |= 1;
     }
 
-    for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
-        for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
-            const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
+    for (mb = mb_start; mb < mb_end; mb++) {
+        const int mb_x    = mb % s->mb_width;
+        const int mb_y    = mb / s->mb_width;
+        const int copy_mb = mb_bitmask_gb && !get_bits1(mb_bitmask_gb);
 
-            if (s->restart_interval && !s->restart_count)
-                s->restart_count = s->restart_interval;
+        if (s->restart_interval && !s->restart_count)
+            s->restart_count = s->restart_interval;
+
+        if (get_bits_left(&s->gb) < 0) {
+            av_log(s->avctx, AV_LOG_ERROR, "overread %d\n",
+                   -get_bits_left(&s->gb));
+            return AVERROR_INVALIDDATA;
+        }
+        for (i = 0; i < nb_components; i++) {
+            uint8_t *ptr;
+            int n, h, v, x, y, c, j;
+            int block_offset;
+            n = s->nb_blocks[i];
+            c = s->comp_index[i];
+            h = s->h_scount[i];
+            v = s->v_scount[i];
+            x = 0;
+            y = 0;
+            for (j = 0; j < n; j++) {
+                block_offset = (((linesize[c] * (v * mb_y + y) * 8) +
+                                 (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
+
+                if (s->interlaced && s->bottom_field)
+                    block_offset += linesize[c] >> 1;
+                if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
+                    && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)) {
+                    ptr = data[c] + block_offset;
+                } else
+                    ptr = NULL;
+                if (!s->progressive) {
+                    if (copy_mb) {
+                        if (ptr)
+                            mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
+                                            linesize[c], s->avctx->lowres);
 
-            if (get_bits_left(&s->gb) < 0) {
-                av_log(s->avctx, AV_LOG_ERROR, "overread %d\n",
-                       -get_bits_left(&s->gb));
-                return AVERROR_INVALIDDATA;
-            }
-            for (i = 0; i < nb_components; i++) {
-                uint8_t *ptr;
-                int n, h, v, x, y, c, j;
-                int block_offset;
-                n = s->nb_blocks[i];
-                c = s->comp_index[i];
-                h = s->h_scount[i];
-                v = s->v_scount[i];
-                x = 0;
-                y = 0;
-                for (j = 0; j < n; j++) {
-                    block_offset = (((linesize[c] * (v * mb_y + y) * 8) +
-                                     (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
-
-                    if (s->interlaced && s->bottom_field)
-                        block_offset += linesize[c] >> 1;
-                    if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
-                        && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)) {
-                        ptr = data[c] + block_offset;
-                    } else
-                        ptr = NULL;
-                    if (!s->progressive) {
-                        if (copy_mb) {
-                            if (ptr)
-                                mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
-                                                linesize[c], s->avctx->lowres);
-
-                        } else {
-                            s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
-                                             s->dc_index[i], s->ac_index[i],
-                                             s->quant_matrixes[s->quant_sindex[i]]) < 0) {
-                                av_log(s->avctx, AV_LOG_ERROR,
-                                       "error y=%d x=%d\n", mb_y, mb_x);
-                                return AVERROR_INVALIDDATA;
-                            }
-                            if (ptr) {
-                                s->idsp.idct_put(ptr, linesize[c], s->block);
-                                if (s->bits & 7)
-                                    shift_output(s, ptr, linesize[c]);
-                            }
-                        }
                     } else {
-                        int block_idx  = s->block_stride[c] * (v * mb_y + y) +
-                                         (h * mb_x + x);
-                        int16_t *block = s->blocks[c][block_idx];
-                        if (Ah)
-                            block[0] += get_bits1(&s->gb) *
-                                        s->quant_matrixes[s->quant_sindex[i]][0] << Al;
-                        else if (decode_dc_progressive(s, block, i, s->dc_index[i],
-                                                       s->quant_matrixes[s->quant_sindex[i]],
-                                                       Al) < 0) {
+                        s->bdsp.clear_block(s->block);
+                        if (decode_block(s, s->block, i,
+                                         s->dc_index[i], s->ac_index[i],
+                                         s->quant_matrixes[s->quant_sindex[i]]) < 0) {
                             av_log(s->avctx, AV_LOG_ERROR,
                                    "error y=%d x=%d\n", mb_y, mb_x);
                             return AVERROR_INVALIDDATA;
                         }
+                        if (ptr) {
+                            s->idsp.idct_put(ptr, linesize[c], s->block);
+                            if (s->bits & 7)
+                                shift_output(s, ptr, linesize[c]);
+                        }
                     }
-                    ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
-                    ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
-                            mb_x, mb_y, x, y, c, s->bottom_field,
-                            (v * mb_y + y) * 8, (h * mb_x + x) * 8);
-                    if (++x == h) {
-                        x = 0;
-                        y++;
+                } else {
+                    int block_idx  = s->block_stride[c] * (v * mb_y + y) +
+                                     (h * mb_x + x);
+                    int16_t *block = s->blocks[c][block_idx];
+                    if (Ah)
+                        block[0] += get_bits1(&s->gb) *
+                                    s->quant_matrixes[s->quant_sindex[i]][0] << Al;
+                    else if (decode_dc_progressive(s, block, i, s->dc_index[i],
+                                                   s->quant_matrixes[s->quant_sindex[i]],
+                                                   Al) < 0) {
+                        av_log(s->avctx, AV_LOG_ERROR,
+                               "error y=%d x=%d\n", mb_y, mb_x);
+                        return AVERROR_INVALIDDATA;
                     }
                 }
+                ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
+                ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
+                        mb_x, mb_y, x, y, c, s->bottom_field,
+                        (v * mb_y + y) * 8, (h * mb_x + x) * 8);
+                if (++x == h) {
+                    x = 0;
+                    y++;
+                }
             }
-
-            handle_rstn(s, nb_components);
         }
+
+        handle_rstn(s, nb_components);
     }
     return 0;
 }
 
+typedef struct MJpegScanArgs {
+    MJpegDecodeContext *s;
+    int nb_components, Ah, Al;
+    int nb_intervals;
+} MJpegScanArgs;
+
+/*
+ * Decode a run of consecutive restart intervals. The intervals are split
+ * evenly over the jobs, and each run starts right after an RSTn marker
+ * (or at the start of the scan) with the DC predictors reset, like the
+ * serial decoder does when it meets the marker.
+ */
+static int decode_restart_intervals(AVCodecContext *avctx, void *arg,
+                                    int jobnr, int threadnr)
+{
+    const MJpegScanArgs *a = arg;
+    MJpegDecodeContext  *s = a->s;
+    MJpegDecodeContext *ts = &s->slice_ctx[threadnr];
+    int nb_jobs = FFMIN(a->nb_intervals, avctx->thread_count);
+    int first   = a->nb_intervals *  jobnr      / nb_jobs;
+    int last    = a->nb_intervals * (jobnr + 1) / nb_jobs;
+    int nb_mbs  = s->mb_width * s->mb_height;
+    int i, start;
+
+    /* the scan data starts byte aligned after the SOS header */
+    start = first ? s->restart_markers[first - 1] + 2 : get_bits_count(&s->gb) >> 3;
+    init_get_bits8(&ts->gb, s->gb.buffer + start,
+                   s->gb.buffer_end - s->gb.buffer - start);
+    for (i = 0; i < a->nb_components; i++)
+        ts->last_dc[i] = (4 << s->bits);
+    ts->restart_count = 0;
+
+    return decode_scan_mcus(ts, a->nb_components, a->Ah, a->Al, NULL, NULL,
+                            first * s->restart_interval,
+                            FFMIN(last * s->restart_interval, nb_mbs));
+}
+
+static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
+                             int Al, const uint8_t *mb_bitmask,
+                             int mb_bitmask_size,
+                             const AVFrame *reference)
+{
+    AVCodecContext *avctx = s->avctx;
+    GetBitContext mb_bitmask_gb = {0}; // initialize to silence gcc warning
+    int i, nb_intervals = 0;
+
+    if (mb_bitmask) {
+        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
+            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
+            return AVERROR_INVALIDDATA;
+        }
+        init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
+    }
+
+    s->restart_count = 0;
+
+    for (i = 0; i < nb_components; i++)
+        s->coefs_finished[s->comp_index[i]] |= 1;
+
+    /* Restart intervals can be decoded in parallel if the positions of all
+     * their markers are known, otherwise decode the scan in order. */
+    if (s->restart_interval)
+        nb_intervals = (s->mb_width * s->mb_height + s->restart_interval - 1) /
+                       s->restart_interval;
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1 &&
+        !s->progressive && !mb_bitmask && nb_intervals > 1 &&
+        s->nb_restart_markers == nb_intervals - 1 &&
+        s->gb.buffer == s->buffer) {
+        MJpegScanArgs args = { s, nb_components, Ah, Al, nb_intervals };
+        int nb_jobs = FFMIN(nb_intervals, avctx->thread_count);
+
+        if (!s->slice_ctx) {
+            s->slice_ctx = av_malloc_array(avctx->thread_count, sizeof(*s->slice_ctx));
+            s->slice_ret = av_malloc_array(avctx->thread_count, sizeof(*s->slice_ret));
+            if (!s->slice_ctx || !s->slice_ret) {
+                av_freep(&s->slice_ctx);
+                av_freep(&s->slice_ret);
+                return AVERROR(ENOMEM);
+            }
+        }
+        for (i = 0; i < avctx->thread_count; i++)
+            memcpy(&s->slice_ctx[i], s, sizeof(*s));
+
+        avctx->execute2(avctx, decode_restart_intervals, &args, s->slice_ret, nb_jobs);
+
+        /* the whole scan has been consumed */
+        skip_bits_long(&s->gb, get_bits_left(&s->gb));
+        for (i = 0; i < nb_jobs; i++)
+            if (s->slice_ret[i] < 0)
+                return s->slice_ret[i];
+        return 0;
+    }
+
+    return decode_scan_mcus(s, nb_components, Ah, Al,
+                            mb_bitmask ? &mb_bitmask_gb : NULL, reference,
+                            0, s->mb_width * s->mb_height);
+}
+
 static int mjpeg_decode_scan_progressive_ac(MJpegDecodeContext *s, int ss,
                                             int se, int Ah, int Al)
 {
@@ -2202,6 +2288,22 @@ found:
     return val;
 }
 
+static void add_restart_marker(MJpegDecodeContext *s, int pos)
+{
+    int *markers;
+
+    if (s->nb_restart_markers < 0)
+        return;
+    markers = av_fast_realloc(s->restart_markers, &s->restart_markers_size,
+                              (s->nb_restart_markers + 1) * sizeof(*markers));
+    if (!markers) {
+        s->nb_restart_markers = -1;
+        return;
+    }
+    s->restart_markers = markers;
+    s->restart_markers[s->nb_restart_markers++] = pos;
+}
+
 int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                          const uint8_t **buf_ptr, const uint8_t *buf_end,
                          const uint8_t **unescaped_buf_ptr,
@@ -2229,6 +2331,8 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
             }                                         \
         } while (0)
 
+        s->nb_restart_markers = 0;
+
         if (s->avctx->codec_id == AV_CODEC_ID_THP) {
             ptr = buf_end;
             copy_data_segment(0);
@@ -2257,6 +2361,9 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                         copy_data_segment(1);
                         if (x)
                             break;
+                    } else {
+                        /* the marker is kept, remember where it ends up */
+                        add_restart_marker(s, dst - s->buffer + (ptr - 2 - src));
                     }
                 }
             }
@@ -2965,6 +3072,9 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     av_frame_free(&s->smv_frame);
 
     av_freep(&s->buffer);
+    av_freep(&s->restart_markers);
+    av_freep(&s->slice_ctx);
+    av_freep(&s->slice_ret);
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
@@ -3022,7 +3132,7 @@ const AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .receive_frame  = ff_mjpeg_receive_frame,
     .flush          = decode_flush,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
     .profiles       = NULL_IF_CONFIG_SMALL(ff_mjpeg_profiles),
@@ -125,6 +125,11 @@ typedef struct MJpegDecodeContext {
 
     int restart_interval;
     int restart_count;
+    int *restart_markers;            ///< offsets of the RSTn markers in the unescaped scan
+    unsigned int restart_markers_size;
+    int nb_restart_markers;          ///< number of RSTn markers in the scan, -1 if unknown
+    struct MJpegDecodeContext *slice_ctx; ///< per-thread copies for slice threaded scans
+    int *slice_ret;                  ///< return values of the slice threaded jobs
 
     int buggy_avid;
     int cs_itu601;
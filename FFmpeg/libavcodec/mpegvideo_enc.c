@@ -1718,6 +1718,12 @@ int ff_mpv_encode_picture(AVCodecContext *avctx, AVPacket *pkt,
 
     s->vbv_ignore_qmax = 0;
 
+    /* A frame thread worker must output every frame in the call that codes
+     * it. Frame threads only run encodes without B-frames, which need no
+     * delay; the MPEG-2 sequence header still signals low_delay as set. */
+    if (avctx->internal->frame_thread_encoder)
+        s->low_delay = 1;
+
     s->picture_in_gop_number++;
 
     if (load_input_picture(s, pic_arg) < 0)
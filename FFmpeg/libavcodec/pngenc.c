@@ -46,6 +46,22 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+/**
+ * A band of rows that is filtered and deflated on its own by a slice thread.
+ */
+typedef struct PNGEncBand {
+    z_stream zstream;            ///< raw deflate stream, unused for the first band
+    uint8_t *crow_base;
+    unsigned int crow_base_size;
+    uint8_t *dict;
+    unsigned int dict_size;
+    uint8_t *buf;                ///< compressed data of the band
+    unsigned int buf_size;
+    int len;
+    uint32_t adler;              ///< Adler-32 of the filtered rows of the band
+    int in_len;
+} PNGEncBand;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -78,6 +94,11 @@ typedef struct PNGEncContext {
     APNGFctlChunk last_frame_fctl;
     uint8_t *last_frame_packet;
     size_t last_frame_packet_size;
+
+    PNGEncBand *bands;
+    int *band_ret;
+    int max_bands;               ///< number of allocated bands, 0 without slice threads
+    int nb_bands;                ///< number of bands of the current frame
 } PNGEncContext;
 
 static void png_get_interlaced_row(uint8_t *dst, int row_size,
@@ -200,15 +221,12 @@ static uint8_t *png_choose_filter(PNGEncContext *s, uint8_t *dst,
     if (!top && pred)
         pred = PNG_FILTER_VALUE_SUB;
     if (pred == PNG_FILTER_VALUE_MIXED) {
-        int i;
         int cost, bcost = INT_MAX;
         uint8_t *buf1 = dst, *buf2 = dst + size + 16;
         for (pred = 0; pred < 5; pred++) {
             png_filter_row(s, buf1 + 1, pred, src, top, size, bpp);
             buf1[0] = pred;
-            cost = 0;
-            for (i = 0; i <= size; i++)
-                cost += abs((int8_t) buf1[i]);
+            cost = s->llvidencdsp.sum_abs_bytes(buf1, size + 1);
             if (cost < bcost) {
                 bcost = cost;
                 FFSWAP(uint8_t *, buf1, buf2);
@@ -290,6 +308,167 @@ static int png_write_row(AVCodecContext *avctx, const uint8_t *data, int size)
     return 0;
 }
 
+/* Rows are only split into bands when each one gets at least this much data. */
+#define PNG_BAND_MIN_SIZE (128 * 1024)
+
+static int band_deflate(PNGEncBand *b, z_stream *zstream,
+                        const uint8_t *data, int size, int flush)
+{
+    int ret;
+
+    zstream->next_in  = data;
+    zstream->avail_in = size;
+    do {
+        if (!zstream->avail_out) {
+            int len = zstream->next_out - b->buf;
+            if (b->buf_size > INT_MAX / 2 ||
+                av_reallocp(&b->buf, 2 * b->buf_size) < 0) {
+                b->buf_size = 0;
+                return AVERROR(ENOMEM);
+            }
+            b->buf_size        *= 2;
+            zstream->next_out   = b->buf + len;
+            zstream->avail_out  = b->buf_size - len;
+        }
+        ret = deflate(zstream, flush);
+        if (ret != Z_OK && ret != Z_STREAM_END)
+            return AVERROR_EXTERNAL;
+    } while (zstream->avail_in || !zstream->avail_out ||
+             (flush == Z_FINISH && ret != Z_STREAM_END));
+
+    return 0;
+}
+
+/**
+ * Filter and deflate one band of rows. The first band continues the zlib
+ * stream of the frame, the others are raw deflate data primed with the
+ * filtered rows in front of them, so that the concatenation of all bands is
+ * a single zlib stream once the Adler-32 trailer is appended.
+ */
+static int encode_band(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s   = avctx->priv_data;
+    const AVFrame *p   = arg;
+    PNGEncBand *b      = &s->bands[jobnr];
+    z_stream *zstream  = jobnr ? &b->zstream : &s->zstream;
+    int bpp            = s->bits_per_pixel >> 3;
+    int row_size       = (p->width * s->bits_per_pixel + 7) >> 3;
+    int y_start        = p->height *  jobnr      / s->nb_bands;
+    int y_end          = p->height * (jobnr + 1) / s->nb_bands;
+    int last           = jobnr == s->nb_bands - 1;
+    uint8_t *ptr, *top, *crow_buf, *crow;
+    int y, ret;
+
+    av_fast_malloc(&b->crow_base, &b->crow_base_size,
+                   (row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+    av_fast_malloc(&b->buf, &b->buf_size,
+                   deflateBound(zstream, (y_end - y_start) * (row_size + 1)) + 64);
+    if (!b->crow_base || !b->buf)
+        return AVERROR(ENOMEM);
+    // pixel data should be aligned, but there's a control byte before it
+    crow_buf = b->crow_base + 15;
+
+    if (y_start) {
+        /* the preceding rows filter to the same bytes as in their own band */
+        int dict_rows = FFMIN(y_start, (32768 + row_size) / (row_size + 1));
+        int dict_len  = dict_rows * (row_size + 1);
+
+        av_fast_malloc(&b->dict, &b->dict_size, dict_len);
+        if (!b->dict)
+            return AVERROR(ENOMEM);
+        top = y_start > dict_rows ? p->data[0] + (y_start - dict_rows - 1) * p->linesize[0] : NULL;
+        for (y = y_start - dict_rows; y < y_start; y++) {
+            ptr  = p->data[0] + y * p->linesize[0];
+            crow = png_choose_filter(s, crow_buf, ptr, top, row_size, bpp);
+            memcpy(b->dict + (y - y_start + dict_rows) * (row_size + 1), crow, row_size + 1);
+            top  = ptr;
+        }
+        if (dict_len > 32768)
+            ret = deflateSetDictionary(zstream, b->dict + dict_len - 32768, 32768);
+        else
+            ret = deflateSetDictionary(zstream, b->dict, dict_len);
+        if (ret != Z_OK)
+            return AVERROR_EXTERNAL;
+    }
+
+    b->adler  = adler32(0, NULL, 0);
+    b->in_len = (y_end - y_start) * (row_size + 1);
+    zstream->next_out  = b->buf;
+    zstream->avail_out = b->buf_size;
+    top = y_start ? p->data[0] + (y_start - 1) * p->linesize[0] : NULL;
+    for (y = y_start; y < y_end; y++) {
+        ptr  = p->data[0] + y * p->linesize[0];
+        crow = png_choose_filter(s, crow_buf, ptr, top, row_size, bpp);
+        b->adler = adler32(b->adler, crow, row_size + 1);
+        ret = band_deflate(b, zstream, crow, row_size + 1, Z_NO_FLUSH);
+        if (ret < 0)
+            return ret;
+        top = ptr;
+    }
+    /* a sync flush byte-aligns the data, so the next band can be appended */
+    ret = band_deflate(b, zstream, NULL, 0, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret < 0)
+        return ret;
+    b->len = zstream->next_out - b->buf;
+
+    return 0;
+}
+
+static void png_write_buffered(AVCodecContext *avctx, const uint8_t *data, int size)
+{
+    PNGEncContext *s = avctx->priv_data;
+
+    while (size > 0) {
+        int len = FFMIN(size, s->zstream.avail_out);
+
+        memcpy(s->zstream.next_out, data, len);
+        s->zstream.next_out  += len;
+        s->zstream.avail_out -= len;
+        data += len;
+        size -= len;
+        if (!s->zstream.avail_out) {
+            png_write_image_data(avctx, s->buf, IOBUF_SIZE);
+            s->zstream.avail_out = IOBUF_SIZE;
+            s->zstream.next_out  = s->buf;
+        }
+    }
+}
+
+static int encode_frame_bands(AVCodecContext *avctx, const AVFrame *p)
+{
+    PNGEncContext *s = avctx->priv_data;
+    uint32_t adler;
+    uint8_t trailer[4];
+    int i, ret = 0;
+
+    avctx->execute2(avctx, encode_band, (void *)p, s->band_ret, s->nb_bands);
+
+    for (i = 0; i < s->nb_bands; i++) {
+        if (s->band_ret[i] < 0) {
+            ret = s->band_ret[i];
+            goto the_end;
+        }
+    }
+
+    s->zstream.avail_out = IOBUF_SIZE;
+    s->zstream.next_out  = s->buf;
+    adler = s->bands[0].adler;
+    for (i = 0; i < s->nb_bands; i++) {
+        png_write_buffered(avctx, s->bands[i].buf, s->bands[i].len);
+        if (i)
+            adler = adler32_combine(adler, s->bands[i].adler, s->bands[i].in_len);
+    }
+    AV_WB32(trailer, adler);
+    png_write_buffered(avctx, trailer, 4);
+    if (s->zstream.avail_out < IOBUF_SIZE)
+        png_write_image_data(avctx, s->buf, IOBUF_SIZE - s->zstream.avail_out);
+
+the_end:
+    for (i = 0; i < s->nb_bands; i++)
+        deflateReset(i ? &s->bands[i].zstream : &s->zstream);
+    return ret;
+}
+
 #define AV_WB32_PNG(buf, n) AV_WB32(buf, lrint((n) * 100000))
 static int png_get_chrm(enum AVColorPrimaries prim,  uint8_t *buf)
 {
@@ -442,6 +621,13 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
+    if (s->max_bands && !s->is_progressive) {
+        int64_t size = (int64_t)pict->height * (row_size + 1);
+        s->nb_bands = FFMIN3(s->max_bands, pict->height, size / PNG_BAND_MIN_SIZE);
+        if (s->nb_bands > 1)
+            return encode_frame_bands(avctx, pict);
+    }
+
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
     if (!crow_base) {
         ret = AVERROR(ENOMEM);
@@ -1076,14 +1262,46 @@ static av_cold int png_enc_init(AVCodecContext *avctx)
     if (deflateInit2(&s->zstream, compression_level, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
         return -1;
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1) {
+        int i;
+
+        s->bands    = av_calloc(avctx->thread_count, sizeof(*s->bands));
+        s->band_ret = av_calloc(avctx->thread_count, sizeof(*s->band_ret));
+        if (!s->bands || !s->band_ret)
+            return AVERROR(ENOMEM);
+        for (i = 1; i < avctx->thread_count; i++) {
+            z_stream *zstream = &s->bands[i].zstream;
+
+            zstream->zalloc = ff_png_zalloc;
+            zstream->zfree  = ff_png_zfree;
+            zstream->opaque = NULL;
+            if (deflateInit2(zstream, compression_level, Z_DEFLATED, -15, 8,
+                             Z_DEFAULT_STRATEGY) != Z_OK)
+                return -1;
+            s->max_bands = i + 1;
+        }
+    }
+
     return 0;
 }
 
 static av_cold int png_enc_close(AVCodecContext *avctx)
 {
     PNGEncContext *s = avctx->priv_data;
+    int i;
 
     deflateEnd(&s->zstream);
+    for (i = 0; i < s->max_bands; i++) {
+        PNGEncBand *b = &s->bands[i];
+
+        if (i)
+            deflateEnd(&b->zstream);
+        av_freep(&b->crow_base);
+        av_freep(&b->dict);
+        av_freep(&b->buf);
+    }
+    av_freep(&s->bands);
+    av_freep(&s->band_ret);
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1123,7 +1341,7 @@ const AVCodec ff_png_encoder = {
     .init           = png_enc_init,
     .close          = png_enc_close,
     .encode2        = encode_png,
-    .capabilities   = AV_CODEC_CAP_FRAME_THREADS,
+    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA,
         AV_PIX_FMT_RGB48BE, AV_PIX_FMT_RGBA64BE,
@@ -1133,7 +1351,7 @@ const AVCodec ff_png_encoder = {
         AV_PIX_FMT_MONOBLACK, AV_PIX_FMT_NONE
     },
     .priv_class     = &pngenc_class,
-    .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE,
+    .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_INIT_CLEANUP,
 };
 
 const AVCodec ff_apng_encoder = {
@@ -1141,7 +1359,8 @@ const AVCodec ff_apng_encoder = {
     .long_name      = NULL_IF_CONFIG_SMALL("APNG (Animated Portable Network Graphics) image"),
     .type           = AVMEDIA_TYPE_VIDEO,
     .id             = AV_CODEC_ID_APNG,
-    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
     .close          = png_enc_close,
@@ -1155,5 +1374,5 @@ const AVCodec ff_apng_encoder = {
         AV_PIX_FMT_NONE
     },
     .priv_class     = &pngenc_class,
-    .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE,
+    .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_INIT_CLEANUP,
 };
@@ -140,6 +140,7 @@ typedef struct FrameThreadContext {
 
     int next_decoding;             ///< The next context to submit a packet to.
     int next_finished;             ///< The next context to return output from.
+    int nb_pending;                ///< Number of submitted packets whose output was not returned yet.
 
     int delaying;                  /**<
                                     * Set for the first N packets, where N is the number of threads.
@@ -496,10 +497,37 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     fctx->prev_thread = p;
     fctx->next_decoding++;
+    fctx->nb_pending++;
 
     return 0;
 }
 
+static int receive_frame(PerThreadContext *p, AVFrame *picture,
+                         int *got_picture_ptr)
+{
+    FrameThreadContext *fctx = p->parent;
+    int err;
+
+    av_frame_move_ref(picture, p->frame);
+    *got_picture_ptr = p->got_frame;
+    picture->pkt_dts = p->avpkt->dts;
+    err = p->result;
+
+    /*
+     * A later call with avkpt->size == 0 may loop over all threads,
+     * including this one, searching for a frame/error to return before being
+     * stopped by the "finished != fctx->next_finished" condition.
+     * Make sure we don't mistakenly return the same frame/error again.
+     */
+    p->got_frame = 0;
+    p->result = 0;
+
+    if (fctx->nb_pending > 0)
+        fctx->nb_pending--;
+
+    return err;
+}
+
 int ff_thread_decode_frame(AVCodecContext *avctx,
                            AVFrame *picture, int *got_picture_ptr,
                            AVPacket *avpkt)
@@ -522,6 +550,25 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
     if (err)
         goto finish;
 
+    /*
+     * In low latency mode, return the oldest frame only once it is finished
+     * and keep accepting packets while there are idle threads; block only
+     * when all threads are busy.
+     */
+
+    if (avctx->flags2 & AV_CODEC_FLAG2_LOW_LATENCY_THREADS && avpkt->size) {
+        p = &fctx->threads[fctx->next_finished];
+        if (atomic_load(&p->state) != STATE_INPUT_READY &&
+            fctx->nb_pending < avctx->thread_count - (avctx->codec_id == AV_CODEC_ID_FFV1)) {
+            if (fctx->next_decoding >= avctx->thread_count)
+                fctx->next_decoding = 0;
+            *got_picture_ptr = 0;
+            err = avpkt->size;
+            goto finish;
+        }
+        fctx->delaying = 0;
+    }
+
     /*
      * If we're still receiving the initial packets, don't return a frame.
      */
@@ -554,19 +601,7 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
             pthread_mutex_unlock(&p->progress_mutex);
         }
 
-        av_frame_move_ref(picture, p->frame);
-        *got_picture_ptr = p->got_frame;
-        picture->pkt_dts = p->avpkt->dts;
-        err = p->result;
-
-        /*
-         * A later call with avkpt->size == 0 may loop over all threads,
-         * including this one, searching for a frame/error to return before being
-         * stopped by the "finished != fctx->next_finished" condition.
-         * Make sure we don't mistakenly return the same frame/error again.
-         */
-        p->got_frame = 0;
-        p->result = 0;
+        err = receive_frame(p, picture, got_picture_ptr);
 
         if (finished >= avctx->thread_count) finished = 0;
     } while (!avpkt->size && !*got_picture_ptr && err >= 0 && finished != fctx->next_finished);
@@ -585,6 +620,29 @@ finish:
     return err;
 }
 
+int ff_thread_get_finished_frame(AVCodecContext *avctx,
+                                 AVFrame *picture, int *got_picture_ptr)
+{
+    FrameThreadContext *fctx = avctx->internal->thread_ctx;
+    PerThreadContext *p = &fctx->threads[fctx->next_finished];
+    int err;
+
+    *got_picture_ptr = 0;
+    if (!fctx->nb_pending || atomic_load(&p->state) != STATE_INPUT_READY)
+        return 0;
+
+    async_unlock(fctx);
+
+    err = receive_frame(p, picture, got_picture_ptr);
+    update_context_from_thread(avctx, p->avctx, 1);
+
+    if (++fctx->next_finished >= avctx->thread_count)
+        fctx->next_finished = 0;
+
+    async_lock(fctx);
+    return err;
+}
+
 void ff_thread_report_progress(ThreadFrame *f, int n, int field)
 {
     PerThreadContext *p;
@@ -914,6 +972,7 @@ void ff_thread_flush(AVCodecContext *avctx)
     }
 
     fctx->next_decoding = fctx->next_finished = 0;
+    fctx->nb_pending = 0;
     fctx->delaying = 1;
     fctx->prev_thread = NULL;
     for (i = 0; i < avctx->thread_count; i++) {
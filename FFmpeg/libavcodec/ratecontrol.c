@@ -29,6 +29,7 @@
 #include "libavutil/internal.h"
 
 #include "avcodec.h"
+#include "frame_thread_encoder.h"
 #include "internal.h"
 #include "ratecontrol.h"
 #include "mpegutils.h"
@@ -865,7 +866,7 @@ void ff_get_2pass_fcode(MpegEncContext *s)
 
 // FIXME rd or at least approx for dquant
 
-float ff_rate_estimate_qscale(MpegEncContext *s, int dry_run)
+static float estimate_qscale(MpegEncContext *s, int picture_number, int dry_run)
 {
     float q;
     int qmin, qmax;
@@ -873,7 +874,6 @@ float ff_rate_estimate_qscale(MpegEncContext *s, int dry_run)
     double diff;
     double short_term_q;
     double fps;
-    int picture_number = s->picture_number;
     int64_t wanted_bits;
     RateControlContext *rcc = &s->rc_context;
     AVCodecContext *a       = s->avctx;
@@ -1026,3 +1026,60 @@ float ff_rate_estimate_qscale(MpegEncContext *s, int dry_run)
     }
     return q;
 }
+
+/* Copy the rate control state that the workers of a frame thread encoder
+ * share, that is everything but the per context setup and the statistics
+ * of the last coded frame. */
+static void copy_shared_state(RateControlContext *dst, const RateControlContext *src)
+{
+    memcpy(dst->pred, src->pred, sizeof(dst->pred));
+    dst->buffer_index           = src->buffer_index;
+    dst->short_term_qsum        = src->short_term_qsum;
+    dst->short_term_qcount      = src->short_term_qcount;
+    dst->pass1_rc_eq_output_sum = src->pass1_rc_eq_output_sum;
+    dst->pass1_wanted_bits      = src->pass1_wanted_bits;
+    memcpy(dst->last_qscale_for, src->last_qscale_for, sizeof(dst->last_qscale_for));
+    memcpy(dst->i_cplx_sum,      src->i_cplx_sum,      sizeof(dst->i_cplx_sum));
+    memcpy(dst->p_cplx_sum,      src->p_cplx_sum,      sizeof(dst->p_cplx_sum));
+    memcpy(dst->mv_bits_sum,     src->mv_bits_sum,     sizeof(dst->mv_bits_sum));
+    memcpy(dst->qscale_sum,      src->qscale_sum,      sizeof(dst->qscale_sum));
+    memcpy(dst->frame_count,     src->frame_count,     sizeof(dst->frame_count));
+    dst->last_non_b_pict_type   = src->last_non_b_pict_type;
+}
+
+float ff_rate_estimate_qscale(MpegEncContext *s, int dry_run)
+{
+    AVCodecContext *parent;
+    MpegEncContext *shared;
+    int picture_number, coded, pending;
+    float q;
+
+    if (!CONFIG_FRAME_THREAD_ENCODER || dry_run ||
+        !(parent = ff_frame_thread_encoder_lock_shared(s->avctx)))
+        return estimate_qscale(s, s->picture_number, dry_run);
+
+    /* The workers of a frame thread encoder share the rate control state of
+     * the parent context and take turns in input order. Each adds the bits
+     * of the frame it coded before, so the state does not depend on the
+     * scheduling. The frames that the other workers are still coding are
+     * not counted yet; assume that they are as large as the counted ones,
+     * or hit the target before any is counted. */
+    shared = parent->priv_data;
+    shared->total_bits += s->frame_bits;
+    picture_number = 0;
+    for (int i = 0; i < FF_ARRAY_ELEMS(shared->rc_context.frame_count); i++)
+        picture_number += shared->rc_context.frame_count[i];
+    pending = FFMIN(picture_number, s->avctx->internal->frame_thread_count - 1);
+    coded   = picture_number - pending;
+    s->total_bits = shared->total_bits +
+                    (coded ? pending * shared->total_bits / coded
+                           : pending * s->bit_rate / get_fps(s->avctx));
+    copy_shared_state(&s->rc_context, &shared->rc_context);
+
+    q = estimate_qscale(s, picture_number, 0);
+
+    copy_shared_state(&shared->rc_context, &s->rc_context);
+    ff_frame_thread_encoder_unlock_shared(s->avctx);
+
+    return q;
+}
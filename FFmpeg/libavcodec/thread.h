@@ -60,6 +60,15 @@ void ff_thread_flush(AVCodecContext *avctx);
 int ff_thread_decode_frame(AVCodecContext *avctx, AVFrame *picture,
                            int *got_picture_ptr, AVPacket *avpkt);
 
+/**
+ * Return the oldest pending frame if its thread has already finished
+ * decoding it, without submitting a new packet and without blocking.
+ * *got_picture_ptr will be 0 if no such frame is available.
+ * Used with AV_CODEC_FLAG2_LOW_LATENCY_THREADS when no input is available.
+ */
+int ff_thread_get_finished_frame(AVCodecContext *avctx, AVFrame *picture,
+                                 int *got_picture_ptr);
+
 /**
  * If the codec defines update_thread_context(), call this
  * when they are ready for the next thread to start decoding
@@ -125,6 +125,42 @@ WEIGHT_FUNC_HALF_MM 4, 0
 INIT_XMM sse2
 WEIGHT_FUNC_HALF_MM 8, 8
 
+; two rows per iteration, one in each 128-bit lane
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+cglobal h264_weight_16, 6, 6, 8
+    add        r5, r5
+    inc        r5
+    movd      xm3, r4d
+    movd      xm5, r5d
+    movd      xm6, r3d
+    pslld     xm5, xm6
+    psrld     xm5, 1
+    vpbroadcastw m3, xm3
+    vpbroadcastw m5, xm5
+    pxor       m7, m7
+    sar       r2d, 1
+    lea        r3, [r1*2]
+.nextrow:
+    movu      xm0, [r0]
+    vinserti128 m0, m0, [r0+r1], 1
+    punpckhbw  m1, m0, m7
+    punpcklbw  m0, m7
+    pmullw     m0, m3
+    pmullw     m1, m3
+    paddsw     m0, m5
+    paddsw     m1, m5
+    psraw      m0, xm6
+    psraw      m1, xm6
+    packuswb   m0, m1
+    mova     [r0], xm0
+    vextracti128 [r0+r1], m0, 1
+    add        r0, r3
+    dec       r2d
+    jnz .nextrow
+    RET
+%endif
+
 %macro BIWEIGHT_SETUP 0
 %if ARCH_X86_64
 %define off_regd r7d
@@ -146,17 +182,28 @@ WEIGHT_FUNC_HALF_MM 8, 8
     sub       r4d, 1
 .normal:
 %if cpuflag(ssse3)
-    movd       m4, r5d
-    movd       m0, r6d
+    movd      xm4, r5d
+    movd      xm0, r6d
 %else
     movd       m3, r5d
     movd       m4, r6d
 %endif
+%if mmsize == 32
+    movd      xm5, off_regd
+    movd      xm6, r4d
+    pslld     xm5, xm6
+    psrld     xm5, 1
+%else
     movd       m5, off_regd
     movd       m6, r4d
     pslld      m5, m6
     psrld      m5, 1
-%if cpuflag(ssse3)
+%endif
+%if cpuflag(avx2)
+    punpcklbw xm4, xm0
+    vpbroadcastw m4, xm4
+    vpbroadcastw m5, xm5
+%elif cpuflag(ssse3)
     punpcklbw  m4, m0
     pshuflw    m4, m4, 0
     pshuflw    m5, m5, 0
@@ -272,8 +319,8 @@ BIWEIGHT_FUNC_HALF_MM 8, 8
     pmaddubsw  m2, m4
     paddsw     m0, m5
     paddsw     m2, m5
-    psraw      m0, m6
-    psraw      m2, m6
+    psraw      m0, xm6
+    psraw      m2, xm6
     packuswb   m0, m2
 %endmacro
 
@@ -318,3 +365,28 @@ cglobal h264_biweight_8, 7, 8, 8
     dec        r3d
     jnz .nextrow
     REP_RET
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+cglobal h264_biweight_16, 7, 8, 7
+    BIWEIGHT_SETUP
+    movifnidn r3d, r3m
+    sar       r3d, 1
+    lea        r4, [r2*2]
+
+.nextrow:
+    movu      xm0, [r0]
+    movu      xm1, [r1]
+    vinserti128 m0, m0, [r0+r2], 1
+    vinserti128 m1, m1, [r1+r2], 1
+    punpckhbw  m2, m0, m1
+    punpcklbw  m0, m1
+    BIWEIGHT_SSSE3_OP
+    mova     [r0], xm0
+    vextracti128 [r0+r2], m0, 1
+    add        r0, r4
+    add        r1, r4
+    dec       r3d
+    jnz .nextrow
+    RET
+%endif
@@ -81,6 +81,40 @@ static void sub_median_pred_mmxext(uint8_t *dst, const uint8_t *src1,
     *left     = src2[w - 1];
 }
 
+static int sum_abs_bytes_sse2(const uint8_t *src, intptr_t w)
+{
+    x86_reg i = -(w & ~15);
+    int sum;
+
+    src += w & ~15;
+    /* |x| of a signed byte is the unsigned distance of x ^ 0x80 from 0x80 */
+    __asm__ volatile (
+        "movd       %3, %%xmm2          \n\t"
+        "pshufd $0, %%xmm2, %%xmm2      \n\t"
+        "pxor   %%xmm3, %%xmm3          \n\t"
+        "test       %1, %1              \n\t"
+        " jz 2f                         \n\t"
+        "1:                             \n\t"
+        "movdqu (%2, %1), %%xmm0        \n\t"
+        "pxor   %%xmm2, %%xmm0          \n\t"
+        "psadbw %%xmm2, %%xmm0          \n\t"
+        "paddq  %%xmm0, %%xmm3          \n\t"
+        "add       $16, %1              \n\t"
+        " jnz 1b                        \n\t"
+        "2:                             \n\t"
+        "pshufd $0xee, %%xmm3, %%xmm0   \n\t"
+        "paddq  %%xmm0, %%xmm3          \n\t"
+        "movd   %%xmm3, %0              \n\t"
+        : "=r" (sum), "+r" (i)
+        : "r" (src), "r" (0x80808080)
+          XMM_CLOBBERS_ONLY("%xmm0", "%xmm2", "%xmm3"));
+
+    for (i = 0; i < (w & 15); i++)
+        sum += FFABS((int8_t)src[i]);
+
+    return sum;
+}
+
 #endif /* HAVE_INLINE_ASM */
 
 av_cold void ff_llvidencdsp_init_x86(LLVidEncDSPContext *c)
@@ -95,6 +129,9 @@ av_cold void ff_llvidencdsp_init_x86(LLVidEncDSPContext *c)
     if (INLINE_MMXEXT(cpu_flags)) {
         c->sub_median_pred = sub_median_pred_mmxext;
     }
+    if (INLINE_SSE2(cpu_flags)) {
+        c->sum_abs_bytes = sum_abs_bytes_sse2;
+    }
 #endif /* HAVE_INLINE_ASM */
 
     if (EXTERNAL_SSE2(cpu_flags)) {
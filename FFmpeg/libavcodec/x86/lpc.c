@@ -28,6 +28,7 @@
 
 DECLARE_ASM_CONST(16, double, pd_1)[2] = { 1.0, 1.0 };
 DECLARE_ASM_CONST(16, double, pd_2)[2] = { 2.0, 2.0 };
+DECLARE_ASM_CONST(32, double, pd_1_0)[4] = { 1.0, 0.0, 1.0, 0.0 };
 
 #if HAVE_SSE2_INLINE
 
@@ -149,6 +150,100 @@ static void lpc_compute_autocorr_sse2(const double *data, int len, int lag,
 
 #endif /* HAVE_SSE2_INLINE */
 
+#if HAVE_AVX2_INLINE
+
+/* Same per-lag accumulation order as the SSE2 version, i.e. even and odd
+ * products summed separately, so that the results are bit-identical. Each
+ * ymm register holds the two partial sums of two lags. */
+static void lpc_compute_autocorr_avx2(const double *data, int len, int lag,
+                                      double *autoc)
+{
+    int j;
+
+    if((x86_reg)data & 15)
+        data++;
+
+    for(j=0; j+3<=lag; j+=4){
+        x86_reg i = -len*sizeof(double);
+        __asm__ volatile(
+            "vmovapd   "MANGLE(pd_1_0)", %%ymm0         \n\t"
+            "vmovapd   %%ymm0, %%ymm1                   \n\t"
+            "1:                                         \n\t"
+            "vbroadcastf128   (%2,%0), %%ymm2           \n\t"
+            "vmovupd          (%3,%0), %%xmm3           \n\t"
+            "vinsertf128 $1, -8(%3,%0), %%ymm3, %%ymm3  \n\t"
+            "vmovupd       -16(%3,%0), %%xmm4           \n\t"
+            "vinsertf128 $1,-24(%3,%0), %%ymm4, %%ymm4  \n\t"
+            "vmulpd    %%ymm2, %%ymm3, %%ymm3           \n\t"
+            "vmulpd    %%ymm2, %%ymm4, %%ymm4           \n\t"
+            "vaddpd    %%ymm3, %%ymm0, %%ymm0           \n\t"
+            "vaddpd    %%ymm4, %%ymm1, %%ymm1           \n\t"
+            "add       $16,    %0                       \n\t"
+            "jl 1b                                      \n\t"
+            "vhaddpd   %%ymm1, %%ymm0, %%ymm0           \n\t"
+            "vextractf128 $1, %%ymm0, %%xmm1            \n\t"
+            "vmovlpd   %%xmm0,   (%1)                   \n\t"
+            "vmovlpd   %%xmm1,  8(%1)                   \n\t"
+            "vmovhpd   %%xmm0, 16(%1)                   \n\t"
+            "vmovhpd   %%xmm1, 24(%1)                   \n\t"
+            "vzeroupper                                 \n\t"
+            :"+&r"(i)
+            :"r"(autoc+j), "r"(data+len), "r"(data+len-j)
+             NAMED_CONSTRAINTS_ARRAY_ADD(pd_1_0)
+            :"memory"
+             XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4")
+        );
+    }
+
+    if(j+1<=lag){
+        x86_reg i = -len*sizeof(double);
+        __asm__ volatile(
+            "vmovapd   "MANGLE(pd_1_0)", %%ymm0         \n\t"
+            "1:                                         \n\t"
+            "vbroadcastf128   (%2,%0), %%ymm2           \n\t"
+            "vmovupd          (%3,%0), %%xmm3           \n\t"
+            "vinsertf128 $1, -8(%3,%0), %%ymm3, %%ymm3  \n\t"
+            "vmulpd    %%ymm2, %%ymm3, %%ymm3           \n\t"
+            "vaddpd    %%ymm3, %%ymm0, %%ymm0           \n\t"
+            "add       $16,    %0                       \n\t"
+            "jl 1b                                      \n\t"
+            "vextractf128 $1, %%ymm0, %%xmm1            \n\t"
+            "vhaddpd   %%xmm1, %%xmm0, %%xmm0           \n\t"
+            "vmovlpd   %%xmm0,  (%1)                    \n\t"
+            "vmovhpd   %%xmm0, 8(%1)                    \n\t"
+            "vzeroupper                                 \n\t"
+            :"+&r"(i)
+            :"r"(autoc+j), "r"(data+len), "r"(data+len-j)
+             NAMED_CONSTRAINTS_ARRAY_ADD(pd_1_0)
+            :"memory"
+             XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3")
+        );
+        j += 2;
+    }
+
+    if(j==lag){
+        x86_reg i = -len*sizeof(double);
+        __asm__ volatile(
+            "vmovsd    "MANGLE(pd_1)", %%xmm0           \n\t"
+            "1:                                         \n\t"
+            "vmovapd          (%2,%0), %%xmm2           \n\t"
+            "vmulpd           (%3,%0), %%xmm2, %%xmm2   \n\t"
+            "vaddpd    %%xmm2, %%xmm0, %%xmm0           \n\t"
+            "add       $16,    %0                       \n\t"
+            "jl 1b                                      \n\t"
+            "vhaddpd   %%xmm0, %%xmm0, %%xmm0           \n\t"
+            "vmovsd    %%xmm0, (%1)                     \n\t"
+            :"+&r"(i)
+            :"r"(autoc+j), "r"(data+len), "r"(data+len-j)
+             NAMED_CONSTRAINTS_ARRAY_ADD(pd_1)
+            :"memory"
+             XMM_CLOBBERS(, "%xmm0", "%xmm2")
+        );
+    }
+}
+
+#endif /* HAVE_AVX2_INLINE */
+
 av_cold void ff_lpc_init_x86(LPCContext *c)
 {
 #if HAVE_SSE2_INLINE
@@ -158,5 +253,9 @@ av_cold void ff_lpc_init_x86(LPCContext *c)
         c->lpc_apply_welch_window = lpc_apply_welch_window_sse2;
         c->lpc_compute_autocorr   = lpc_compute_autocorr_sse2;
     }
+#if HAVE_AVX2_INLINE
+    if (INLINE_AVX2(cpu_flags))
+        c->lpc_compute_autocorr   = lpc_compute_autocorr_avx2;
+#endif
 #endif /* HAVE_SSE2_INLINE */
 }
@@ -554,6 +554,374 @@ PIX_SAD(mmx)
 
 #endif /* HAVE_INLINE_ASM */
 
+#if HAVE_AVX2_INLINE
+
+/* The 16 pixel wide functions put two rows into each ymm register. */
+#define LOAD2_16(reg, row0, row1)                                       \
+    "vmovdqu " row0 ", %%xmm" #reg "                              \n\t" \
+    "vinserti128 $1, " row1 ", %%ymm" #reg ", %%ymm" #reg "       \n\t"
+
+#define HSUM_D(acc, tmp, dst)                                           \
+    "vextracti128 $1, %%ymm" #acc ", %%xmm" #tmp "                \n\t" \
+    "vpaddd  %%xmm" #tmp ", %%xmm" #acc ", %%xmm" #acc "          \n\t" \
+    "vpshufd $0xee, %%xmm" #acc ", %%xmm" #tmp "                  \n\t" \
+    "vpaddd  %%xmm" #tmp ", %%xmm" #acc ", %%xmm" #acc "          \n\t" \
+    "vpshufd $0x55, %%xmm" #acc ", %%xmm" #tmp "                  \n\t" \
+    "vpaddd  %%xmm" #tmp ", %%xmm" #acc ", %%xmm" #acc "          \n\t" \
+    "vmovd   %%xmm" #acc ", " dst "                               \n\t"
+
+static int sad16_avx2(MpegEncContext *v, uint8_t *pix1, uint8_t *pix2,
+                      ptrdiff_t stride, int h)
+{
+    x86_reg rows = h;
+    int sum;
+
+    __asm__ volatile (
+        "vpxor   %%ymm4, %%ymm4, %%ymm4                 \n\t"
+        "1:                                             \n\t"
+        LOAD2_16(0, "(%1)", "(%1, %4)")
+        LOAD2_16(1, "(%2)", "(%2, %4)")
+        "vpsadbw %%ymm1, %%ymm0, %%ymm0                 \n\t"
+        "vpaddd  %%ymm0, %%ymm4, %%ymm4                 \n\t"
+        "lea     (%1, %4, 2), %1                        \n\t"
+        "lea     (%2, %4, 2), %2                        \n\t"
+        "sub     $2, %3                                 \n\t"
+        "jg 1b                                          \n\t"
+        HSUM_D(4, 0, "%0")
+        "vzeroupper                                     \n\t"
+        : "=r" (sum), "+r" (pix1), "+r" (pix2), "+r" (rows)
+        : "r" ((x86_reg) stride)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm4"));
+
+    return sum;
+}
+
+static int sad16_x2_avx2(MpegEncContext *v, uint8_t *pix1, uint8_t *pix2,
+                         ptrdiff_t stride, int h)
+{
+    x86_reg rows = h;
+    int sum;
+
+    __asm__ volatile (
+        "vpxor   %%ymm4, %%ymm4, %%ymm4                 \n\t"
+        "1:                                             \n\t"
+        LOAD2_16(0, "(%1)", "(%1, %4)")
+        LOAD2_16(1, "(%2)", "(%2, %4)")
+        LOAD2_16(2, "1(%2)", "1(%2, %4)")
+        "vpavgb  %%ymm2, %%ymm1, %%ymm1                 \n\t"
+        "vpsadbw %%ymm1, %%ymm0, %%ymm0                 \n\t"
+        "vpaddd  %%ymm0, %%ymm4, %%ymm4                 \n\t"
+        "lea     (%1, %4, 2), %1                        \n\t"
+        "lea     (%2, %4, 2), %2                        \n\t"
+        "sub     $2, %3                                 \n\t"
+        "jg 1b                                          \n\t"
+        HSUM_D(4, 0, "%0")
+        "vzeroupper                                     \n\t"
+        : "=r" (sum), "+r" (pix1), "+r" (pix2), "+r" (rows)
+        : "r" ((x86_reg) stride)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm4"));
+
+    return sum;
+}
+
+static int sad16_y2_avx2(MpegEncContext *v, uint8_t *pix1, uint8_t *pix2,
+                         ptrdiff_t stride, int h)
+{
+    x86_reg rows = h;
+    int sum;
+
+    __asm__ volatile (
+        "vpxor   %%ymm4, %%ymm4, %%ymm4                 \n\t"
+        "1:                                             \n\t"
+        LOAD2_16(0, "(%1)", "(%1, %4)")
+        LOAD2_16(1, "(%2)", "(%2, %4)")
+        LOAD2_16(2, "(%2, %4)", "(%2, %4, 2)")
+        "vpavgb  %%ymm2, %%ymm1, %%ymm1                 \n\t"
+        "vpsadbw %%ymm1, %%ymm0, %%ymm0                 \n\t"
+        "vpaddd  %%ymm0, %%ymm4, %%ymm4                 \n\t"
+        "lea     (%1, %4, 2), %1                        \n\t"
+        "lea     (%2, %4, 2), %2                        \n\t"
+        "sub     $2, %3                                 \n\t"
+        "jg 1b                                          \n\t"
+        HSUM_D(4, 0, "%0")
+        "vzeroupper                                     \n\t"
+        : "=r" (sum), "+r" (pix1), "+r" (pix2), "+r" (rows)
+        : "r" ((x86_reg) stride)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm4"));
+
+    return sum;
+}
+
+/* 8 pixel wide blocks put four rows into each ymm register. */
+#define LOAD4_8(reg, tmp, ptr, stride, stride3)                         \
+    "vmovq   (" ptr "), %%xmm" #reg "                             \n\t" \
+    "vmovhps (" ptr ", " stride "), %%xmm" #reg ", %%xmm" #reg "  \n\t" \
+    "vmovq   (" ptr ", " stride ", 2), %%xmm" #tmp "              \n\t" \
+    "vmovhps (" ptr ", " stride3 "), %%xmm" #tmp ", %%xmm" #tmp " \n\t" \
+    "vinserti128 $1, %%xmm" #tmp ", %%ymm" #reg ", %%ymm" #reg "  \n\t"
+
+static int sad8_avx2(MpegEncContext *v, uint8_t *pix1, uint8_t *pix2,
+                     ptrdiff_t stride, int h)
+{
+    x86_reg rows = h;
+    int sum;
+
+    __asm__ volatile (
+        "vpxor   %%ymm4, %%ymm4, %%ymm4                 \n\t"
+        "cmp     $4, %3                                 \n\t"
+        "jl 2f                                          \n\t"
+        "1:                                             \n\t"
+        LOAD4_8(0, 2, "%1", "%4", "%5")
+        LOAD4_8(1, 3, "%2", "%4", "%5")
+        "vpsadbw %%ymm1, %%ymm0, %%ymm0                 \n\t"
+        "vpaddd  %%ymm0, %%ymm4, %%ymm4                 \n\t"
+        "lea     (%1, %4, 4), %1                        \n\t"
+        "lea     (%2, %4, 4), %2                        \n\t"
+        "sub     $4, %3                                 \n\t"
+        "cmp     $4, %3                                 \n\t"
+        "jge 1b                                         \n\t"
+        "2:                                             \n\t"
+        "test    %3, %3                                 \n\t"
+        "jz 3f                                          \n\t"
+        "vmovq   (%1), %%xmm0                           \n\t"
+        "vmovhps (%1, %4), %%xmm0, %%xmm0               \n\t"
+        "vmovq   (%2), %%xmm1                           \n\t"
+        "vmovhps (%2, %4), %%xmm1, %%xmm1               \n\t"
+        "vpsadbw %%xmm1, %%xmm0, %%xmm0                 \n\t"
+        "vpaddd  %%ymm0, %%ymm4, %%ymm4                 \n\t"
+        "3:                                             \n\t"
+        HSUM_D(4, 0, "%0")
+        "vzeroupper                                     \n\t"
+        : "=r" (sum), "+r" (pix1), "+r" (pix2), "+r" (rows)
+        : "r" ((x86_reg) stride), "r" ((x86_reg) stride * 3)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4"));
+
+    return sum;
+}
+
+static int sse16_avx2(MpegEncContext *v, uint8_t *pix1, uint8_t *pix2,
+                      ptrdiff_t stride, int h)
+{
+    x86_reg rows = h;
+    int sum;
+
+    __asm__ volatile (
+        "vpxor     %%ymm4, %%ymm4, %%ymm4               \n\t"
+        "1:                                             \n\t"
+        "vpmovzxbw (%1), %%ymm0                         \n\t"
+        "vpmovzxbw (%2), %%ymm1                         \n\t"
+        "vpsubw    %%ymm1, %%ymm0, %%ymm0               \n\t"
+        "vpmaddwd  %%ymm0, %%ymm0, %%ymm0               \n\t"
+        "vpaddd    %%ymm0, %%ymm4, %%ymm4               \n\t"
+        "add       %4, %1                               \n\t"
+        "add       %4, %2                               \n\t"
+        "dec       %3                                   \n\t"
+        "jg 1b                                          \n\t"
+        HSUM_D(4, 0, "%0")
+        "vzeroupper                                     \n\t"
+        : "=r" (sum), "+r" (pix1), "+r" (pix2), "+r" (rows)
+        : "r" ((x86_reg) stride)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm4"));
+
+    return sum;
+}
+
+static int vsad_intra16_avx2(MpegEncContext *v, uint8_t *pix, uint8_t *dummy,
+                             ptrdiff_t stride, int h)
+{
+    x86_reg rows = h - 2;
+    int sum;
+
+    __asm__ volatile (
+        "vmovdqu (%1), %%xmm4                           \n\t"
+        "vpsadbw (%1, %3), %%xmm4, %%xmm4               \n\t"
+        "test    %2, %2                                 \n\t"
+        "jle 2f                                         \n\t"
+        "1:                                             \n\t"
+        "add     %3, %1                                 \n\t"
+        LOAD2_16(0, "(%1)", "(%1, %3)")
+        LOAD2_16(1, "(%1, %3)", "(%1, %3, 2)")
+        "vpsadbw %%ymm1, %%ymm0, %%ymm0                 \n\t"
+        "vpaddd  %%ymm0, %%ymm4, %%ymm4                 \n\t"
+        "add     %3, %1                                 \n\t"
+        "sub     $2, %2                                 \n\t"
+        "jg 1b                                          \n\t"
+        "2:                                             \n\t"
+        HSUM_D(4, 0, "%0")
+        "vzeroupper                                     \n\t"
+        : "=r" (sum), "+r" (pix), "+r" (rows)
+        : "r" ((x86_reg) stride)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm4"));
+
+    return sum;
+}
+
+DECLARE_ALIGNED(32, static const uint16_t, hf_noise_mask)[16] = {
+    0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+    0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0,
+};
+
+/* sum of |(s[x] - s[x + stride]) - (s[x + 1] - s[x + stride + 1])| over the
+ * 15 horizontal and h - 1 vertical pixel pairs of a 16 pixel wide block */
+static int hf_noise16_avx2(uint8_t *pix, ptrdiff_t stride, int h)
+{
+    x86_reg rows = h - 1;
+    int sum;
+
+    __asm__ volatile (
+        "vpxor      %%ymm4, %%ymm4, %%ymm4              \n\t"
+        "vpcmpeqw   %%ymm5, %%ymm5, %%ymm5              \n\t"
+        "vpsrlw     $15, %%ymm5, %%ymm5                 \n\t"
+        "vpmovzxbw  (%1), %%ymm0                        \n\t"
+        "1:                                             \n\t"
+        "add        %3, %1                              \n\t"
+        "vpmovzxbw  (%1), %%ymm1                        \n\t"
+        "vpsubw     %%ymm1, %%ymm0, %%ymm2              \n\t"
+        "vmovdqa    %%ymm1, %%ymm0                      \n\t"
+        "vperm2i128 $0x81, %%ymm2, %%ymm2, %%ymm3       \n\t"
+        "vpalignr   $2, %%ymm2, %%ymm3, %%ymm3          \n\t"
+        "vpsubw     %%ymm3, %%ymm2, %%ymm2              \n\t"
+        "vpabsw     %%ymm2, %%ymm2                      \n\t"
+        "vpand      %4, %%ymm2, %%ymm2                  \n\t"
+        "vpmaddwd   %%ymm5, %%ymm2, %%ymm2              \n\t"
+        "vpaddd     %%ymm2, %%ymm4, %%ymm4              \n\t"
+        "dec        %2                                  \n\t"
+        "jg 1b                                          \n\t"
+        HSUM_D(4, 0, "%0")
+        "vzeroupper                                     \n\t"
+        : "=r" (sum), "+r" (pix), "+r" (rows)
+        : "r" ((x86_reg) stride), "m" (*hf_noise_mask)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5"));
+
+    return sum;
+}
+
+static int nsse16_avx2(MpegEncContext *c, uint8_t *pix1, uint8_t *pix2,
+                       ptrdiff_t stride, int h)
+{
+    int score1 = sse16_avx2(c, pix1, pix2, stride, h);
+    int score2 = hf_noise16_avx2(pix1, stride, h) -
+                 hf_noise16_avx2(pix2, stride, h);
+
+    if (c)
+        return score1 + FFABS(score2) * c->avctx->nsse_weight;
+    else
+        return score1 + FFABS(score2) * 8;
+}
+
+#if ARCH_X86_64
+
+#define SUMSUB_AVX2(a, b)                                               \
+    "vpaddw  %%ymm" #b ", %%ymm" #a ", %%ymm" #a "                \n\t" \
+    "vpaddw  %%ymm" #b ", %%ymm" #b ", %%ymm" #b "                \n\t" \
+    "vpsubw  %%ymm" #a ", %%ymm" #b ", %%ymm" #b "                \n\t"
+
+/* same butterflies as HADAMARD8 in me_cmp.asm */
+#define HADAMARD8_AVX2(r0, r1, r2, r3, r4, r5, r6, r7)                  \
+    SUMSUB_AVX2(r0, r1) SUMSUB_AVX2(r2, r3)                             \
+    SUMSUB_AVX2(r4, r5) SUMSUB_AVX2(r6, r7)                             \
+    SUMSUB_AVX2(r0, r2) SUMSUB_AVX2(r1, r3)                             \
+    SUMSUB_AVX2(r4, r6) SUMSUB_AVX2(r5, r7)                             \
+    SUMSUB_AVX2(r0, r4) SUMSUB_AVX2(r1, r5)                             \
+    SUMSUB_AVX2(r2, r6) SUMSUB_AVX2(r3, r7)
+
+#define UNPCK_AVX2(op, a, b, lo, hi)                                    \
+    "vpunpckl" op " %%ymm" #b ", %%ymm" #a ", %%ymm" #lo "        \n\t" \
+    "vpunpckh" op " %%ymm" #b ", %%ymm" #a ", %%ymm" #hi "        \n\t"
+
+#define DIFF_ROW_AVX2(reg, row1, row2)                                  \
+    "vpmovzxbw " row1 ", %%ymm" #reg "                            \n\t" \
+    "vpmovzxbw " row2 ", %%ymm8                                   \n\t" \
+    "vpsubw    %%ymm8, %%ymm" #reg ", %%ymm" #reg "               \n\t"
+
+/* Two horizontally adjacent 8x8 blocks are transformed at once, each in one
+ * 128-bit lane, since all word shuffles of the transpose stay in-lane. */
+static int hadamard8_diff8x16_avx2(uint8_t *src1, uint8_t *src2,
+                                   ptrdiff_t stride)
+{
+    int sum;
+
+    __asm__ volatile (
+        DIFF_ROW_AVX2(0, "(%1)",         "(%2)")
+        DIFF_ROW_AVX2(1, "(%1, %3)",     "(%2, %3)")
+        DIFF_ROW_AVX2(2, "(%1, %3, 2)",  "(%2, %3, 2)")
+        DIFF_ROW_AVX2(3, "(%1, %4)",     "(%2, %4)")
+        "lea (%1, %3, 4), %1                            \n\t"
+        "lea (%2, %3, 4), %2                            \n\t"
+        DIFF_ROW_AVX2(4, "(%1)",         "(%2)")
+        DIFF_ROW_AVX2(5, "(%1, %3)",     "(%2, %3)")
+        DIFF_ROW_AVX2(6, "(%1, %3, 2)",  "(%2, %3, 2)")
+        DIFF_ROW_AVX2(7, "(%1, %4)",     "(%2, %4)")
+        HADAMARD8_AVX2(0, 1, 2, 3, 4, 5, 6, 7)
+        UNPCK_AVX2("wd",   0,  1,  8,  9)
+        UNPCK_AVX2("wd",   2,  3, 10, 11)
+        UNPCK_AVX2("wd",   4,  5, 12, 13)
+        UNPCK_AVX2("wd",   6,  7, 14, 15)
+        UNPCK_AVX2("dq",   8, 10,  0,  1)
+        UNPCK_AVX2("dq",   9, 11,  2,  3)
+        UNPCK_AVX2("dq",  12, 14,  4,  5)
+        UNPCK_AVX2("dq",  13, 15,  6,  7)
+        UNPCK_AVX2("qdq",  0,  4,  8,  9)
+        UNPCK_AVX2("qdq",  1,  5, 10, 11)
+        UNPCK_AVX2("qdq",  2,  6, 12, 13)
+        UNPCK_AVX2("qdq",  3,  7, 14, 15)
+        HADAMARD8_AVX2(8, 9, 10, 11, 12, 13, 14, 15)
+        "vpabsw   %%ymm8,  %%ymm8                       \n\t"
+        "vpabsw   %%ymm9,  %%ymm9                       \n\t"
+        "vpabsw   %%ymm10, %%ymm10                      \n\t"
+        "vpabsw   %%ymm11, %%ymm11                      \n\t"
+        "vpabsw   %%ymm12, %%ymm12                      \n\t"
+        "vpabsw   %%ymm13, %%ymm13                      \n\t"
+        "vpabsw   %%ymm14, %%ymm14                      \n\t"
+        "vpabsw   %%ymm15, %%ymm15                      \n\t"
+        /* each coefficient is at most 64 * 255, so two still fit in int16 */
+        "vpaddw   %%ymm9,  %%ymm8,  %%ymm8              \n\t"
+        "vpaddw   %%ymm11, %%ymm10, %%ymm10             \n\t"
+        "vpaddw   %%ymm13, %%ymm12, %%ymm12             \n\t"
+        "vpaddw   %%ymm15, %%ymm14, %%ymm14             \n\t"
+        "vpcmpeqw %%ymm9,  %%ymm9,  %%ymm9              \n\t"
+        "vpsrlw   $15,     %%ymm9,  %%ymm9              \n\t"
+        "vpmaddwd %%ymm9,  %%ymm8,  %%ymm8              \n\t"
+        "vpmaddwd %%ymm9,  %%ymm10, %%ymm10             \n\t"
+        "vpmaddwd %%ymm9,  %%ymm12, %%ymm12             \n\t"
+        "vpmaddwd %%ymm9,  %%ymm14, %%ymm14             \n\t"
+        "vpaddd   %%ymm10, %%ymm8,  %%ymm8              \n\t"
+        "vpaddd   %%ymm14, %%ymm12, %%ymm12             \n\t"
+        "vpaddd   %%ymm12, %%ymm8,  %%ymm8              \n\t"
+        HSUM_D(8, 0, "%0")
+        "vzeroupper                                     \n\t"
+        : "=r" (sum), "+r" (src1), "+r" (src2)
+        : "r" ((x86_reg) stride), "r" ((x86_reg) stride * 3)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2",  "%xmm3",  "%xmm4",  "%xmm5",
+                         "%xmm6", "%xmm7", "%xmm8",  "%xmm9",  "%xmm10", "%xmm11",
+                         "%xmm12", "%xmm13", "%xmm14", "%xmm15"));
+
+    return sum;
+}
+
+static int hadamard8_diff16_avx2(MpegEncContext *s, uint8_t *src1,
+                                 uint8_t *src2, ptrdiff_t stride, int h)
+{
+    int sum = hadamard8_diff8x16_avx2(src1, src2, stride);
+
+    if (h == 16)
+        sum += hadamard8_diff8x16_avx2(src1 + 8 * stride, src2 + 8 * stride,
+                                       stride);
+    return sum;
+}
+
+#endif /* ARCH_X86_64 */
+
+#endif /* HAVE_AVX2_INLINE */
+
 av_cold void ff_me_cmp_init_x86(MECmpContext *c, AVCodecContext *avctx)
 {
     int cpu_flags = av_get_cpu_flags();
@@ -649,4 +1017,23 @@ av_cold void ff_me_cmp_init_x86(MECmpContext *c, AVCodecContext *avctx)
         c->hadamard8_diff[1] = ff_hadamard8_diff_ssse3;
 #endif
     }
+
+#if HAVE_AVX2_INLINE
+    if (INLINE_AVX2(cpu_flags) && !(cpu_flags & AV_CPU_FLAG_AVXSLOW)) {
+        c->sad[0]        = sad16_avx2;
+        c->sad[1]        = sad8_avx2;
+        c->pix_abs[0][0] = sad16_avx2;
+        c->pix_abs[0][1] = sad16_x2_avx2;
+        c->pix_abs[0][2] = sad16_y2_avx2;
+        c->pix_abs[1][0] = sad8_avx2;
+
+        c->sse[0]  = sse16_avx2;
+        c->nsse[0] = nsse16_avx2;
+
+        c->vsad[4] = vsad_intra16_avx2;
+#if ARCH_X86_64
+        c->hadamard8_diff[0] = hadamard8_diff16_avx2;
+#endif
+    }
+#endif /* HAVE_AVX2_INLINE */
 }
@@ -19,6 +19,10 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <time.h>
+
+#include "config.h"
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/buffer.h"
@@ -33,6 +37,7 @@
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -1353,16 +1358,40 @@ static int ff_filter_activate_default(AVFilterContext *filter)
      [buffersrc1][testsrc1][buffersrc2][testsrc2]concat=v=2).
  */
 
+/* CPU time of the calling thread in microseconds, 0 where not available */
+static int64_t thread_cpu_time(void)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000;
+#endif
+    return 0;
+}
+
 int ff_filter_activate(AVFilterContext *filter)
 {
+    int collect_stats = filter->graph->collect_stats;
+    int64_t start = 0, cpu_start = 0;
     int ret;
 
+    if (collect_stats) {
+        start     = av_gettime_relative();
+        cpu_start = thread_cpu_time();
+    }
+
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
     filter->ready = 0;
     ret = filter->filter->activate ? filter->filter->activate(filter) :
           ff_filter_activate_default(filter);
+    if (collect_stats) {
+        filter->nb_activations++;
+        filter->activation_time     += av_gettime_relative() - start;
+        filter->activation_cpu_time += thread_cpu_time()     - cpu_start;
+    }
     if (ret == FFERROR_NOT_READY)
         ret = 0;
     return ret;
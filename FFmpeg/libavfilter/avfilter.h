@@ -470,6 +470,17 @@ struct AVFilterContext {
      * configured.
      */
     int extra_hw_frames;
+
+    /**
+     * Number of times this filter was activated, and wall-clock and CPU time
+     * spent in these activations in microseconds. The CPU time is that of the
+     * thread running the activation, so it excludes the slice threads of the
+     * graph, and it is 0 where the system cannot measure it. Only updated
+     * while AVFilterGraph.collect_stats is set; set by libavfilter.
+     */
+    int64_t nb_activations;
+    int64_t activation_time;
+    int64_t activation_cpu_time;
 };
 
 /**
@@ -898,6 +909,14 @@ typedef struct AVFilterGraph {
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
 
+    /**
+     * If nonzero, AVFilterContext.nb_activations,
+     * AVFilterContext.activation_time and AVFilterContext.activation_cpu_time
+     * are updated for the filters of this graph. May be set at any time by
+     * the caller.
+     */
+    int collect_stats;
+
     /**
      * Private fields
      *
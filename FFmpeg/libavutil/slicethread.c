@@ -25,6 +25,8 @@
 
 #if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
 
+typedef struct SliceThreadPool SliceThreadPool;
+
 typedef struct WorkerContext {
     AVSliceThread   *ctx;
     pthread_mutex_t mutex;
@@ -49,8 +51,36 @@ struct AVSliceThread {
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
+
+    /* shared pool mode, all protected by pool->mutex */
+    SliceThreadPool *pool;
+    AVSliceThread   *next;          ///< next context waiting for pool workers
+    int             queued;
+    int             nb_slots;       ///< number of claimed thread slots
+    int             nb_running;     ///< number of slots still running jobs
+};
+
+/**
+ * Process-wide pool of worker threads shared by the contexts created with
+ * avpriv_slicethread_create_shared(). Idle workers take a thread slot from
+ * the context at the head of the queue and move it to the tail, so that the
+ * workers are distributed round-robin over the contexts with pending jobs.
+ */
+struct SliceThreadPool {
+    pthread_t       *threads;
+    int             nb_threads;
+    int             refcount;
+    int             finished;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    AVSliceThread   *head;
+    AVSliceThread   *tail;
 };
 
+static AVMutex shared_pool_lock = AV_MUTEX_INITIALIZER;
+static SliceThreadPool *shared_pool;
+
 static int run_jobs(AVSliceThread *ctx)
 {
     unsigned nb_jobs    = ctx->nb_jobs;
@@ -92,6 +122,169 @@ static void *attribute_align_arg thread_worker(void *v)
     }
 }
 
+static void pool_enqueue(SliceThreadPool *pool, AVSliceThread *ctx)
+{
+    if (pool->tail)
+        pool->tail->next = ctx;
+    else
+        pool->head = ctx;
+    pool->tail  = ctx;
+    ctx->queued = 1;
+}
+
+static void pool_dequeue(SliceThreadPool *pool, AVSliceThread *ctx)
+{
+    AVSliceThread **p = &pool->head, *prev = NULL;
+
+    while (*p != ctx) {
+        prev = *p;
+        p    = &prev->next;
+    }
+    *p = ctx->next;
+    if (pool->tail == ctx)
+        pool->tail = prev;
+    ctx->next   = NULL;
+    ctx->queued = 0;
+}
+
+/* must be called with pool->mutex locked */
+static int pool_claim_slot(AVSliceThread *ctx)
+{
+    if (ctx->nb_slots >= ctx->nb_active_threads ||
+        atomic_load_explicit(&ctx->current_job, memory_order_acquire) >= ctx->nb_jobs)
+        return -1;
+    ctx->nb_running++;
+    return ctx->nb_slots++;
+}
+
+/* jobs are handed out in order to whichever slot asks first, so the oldest
+ * unfinished job is always running even if some slots are claimed late */
+static void pool_run_slot(AVSliceThread *ctx, int slot)
+{
+    unsigned nb_jobs = ctx->nb_jobs;
+    unsigned job;
+
+    while ((job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs)
+        ctx->worker_func(ctx->priv, job, slot, nb_jobs, ctx->nb_active_threads);
+}
+
+/* must be called with pool->mutex locked */
+static void pool_release_slot(AVSliceThread *ctx)
+{
+    if (!--ctx->nb_running)
+        pthread_cond_signal(&ctx->done_cond);
+}
+
+static void *attribute_align_arg pool_worker(void *v)
+{
+    SliceThreadPool *pool = v;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->finished) {
+        AVSliceThread *ctx = pool->head;
+        int slot;
+
+        if (!ctx) {
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+            continue;
+        }
+
+        slot = pool_claim_slot(ctx);
+        pool_dequeue(pool, ctx);
+        if (slot < 0)
+            continue;
+        if (ctx->nb_slots < ctx->nb_active_threads)
+            pool_enqueue(pool, ctx);
+        pthread_mutex_unlock(&pool->mutex);
+
+        pool_run_slot(ctx, slot);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool_release_slot(ctx);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+static void pool_free(SliceThreadPool *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->finished = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->nb_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    av_freep(&pool->threads);
+    av_free(pool);
+}
+
+static int pool_alloc(SliceThreadPool **ppool, int nb_threads)
+{
+    SliceThreadPool *pool;
+    int ret;
+
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+
+    pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return AVERROR(ENOMEM);
+    pool->threads = av_calloc(nb_threads, sizeof(*pool->threads));
+    if (!pool->threads) {
+        av_free(pool);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    for (; pool->nb_threads < nb_threads; pool->nb_threads++) {
+        if (ret = pthread_create(&pool->threads[pool->nb_threads], NULL, pool_worker, pool)) {
+            pool_free(pool);
+            return AVERROR(ret);
+        }
+    }
+
+    *ppool = pool;
+    return 0;
+}
+
+static void pool_execute(AVSliceThread *ctx)
+{
+    SliceThreadPool *pool = ctx->pool;
+    int slot;
+
+    atomic_store_explicit(&ctx->current_job, 0, memory_order_relaxed);
+
+    pthread_mutex_lock(&pool->mutex);
+    ctx->nb_slots   = 0;
+    ctx->nb_running = 0;
+    pool_enqueue(pool, ctx);
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    /* the calling thread runs jobs too, so that progress does not depend on
+     * pool workers becoming idle */
+    pthread_mutex_lock(&pool->mutex);
+    while ((slot = pool_claim_slot(ctx)) >= 0) {
+        pthread_mutex_unlock(&pool->mutex);
+        pool_run_slot(ctx, slot);
+        pthread_mutex_lock(&pool->mutex);
+        pool_release_slot(ctx);
+    }
+    while (ctx->nb_running)
+        pthread_cond_wait(&ctx->done_cond, &pool->mutex);
+    if (ctx->queued)
+        pool_dequeue(pool, ctx);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
@@ -162,6 +355,53 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     return nb_threads;
 }
 
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     void (*main_func)(void *priv),
+                                     int nb_threads, int pool_size)
+{
+    AVSliceThread *ctx;
+    int ret;
+
+    av_assert0(nb_threads >= 0 && pool_size >= 0);
+    /* main_func runs alongside the jobs and may wait on them, so they must
+     * not depend on pool threads becoming idle */
+    if (main_func)
+        return avpriv_slicethread_create(pctx, priv, worker_func, main_func, nb_threads);
+    if (!nb_threads) {
+        int nb_cpus = av_cpu_count();
+        if (nb_cpus > 1)
+            nb_threads = nb_cpus + 1;
+        else
+            nb_threads = 1;
+    }
+
+    *pctx = ctx = av_mallocz(sizeof(*ctx));
+    if (!ctx)
+        return AVERROR(ENOMEM);
+
+    ff_mutex_lock(&shared_pool_lock);
+    if (!shared_pool && (ret = pool_alloc(&shared_pool, pool_size)) < 0) {
+        ff_mutex_unlock(&shared_pool_lock);
+        av_freep(pctx);
+        return ret;
+    }
+    shared_pool->refcount++;
+    ctx->pool = shared_pool;
+    ff_mutex_unlock(&shared_pool_lock);
+
+    ctx->priv        = priv;
+    ctx->worker_func = worker_func;
+    ctx->nb_threads  = nb_threads;
+
+    atomic_init(&ctx->first_job, 0);
+    atomic_init(&ctx->current_job, 0);
+    pthread_mutex_init(&ctx->done_mutex, NULL);
+    pthread_cond_init(&ctx->done_cond, NULL);
+
+    return nb_threads;
+}
+
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
 {
     int nb_workers, i, is_last = 0;
@@ -169,6 +409,10 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     av_assert0(nb_jobs > 0);
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
+    if (ctx->pool) {
+        pool_execute(ctx);
+        return;
+    }
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
     atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads, memory_order_relaxed);
     nb_workers             = ctx->nb_active_threads;
@@ -206,6 +450,19 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
         return;
 
     ctx = *pctx;
+    if (ctx->pool) {
+        ff_mutex_lock(&shared_pool_lock);
+        if (!--ctx->pool->refcount) {
+            pool_free(ctx->pool);
+            shared_pool = NULL;
+        }
+        ff_mutex_unlock(&shared_pool_lock);
+        pthread_cond_destroy(&ctx->done_cond);
+        pthread_mutex_destroy(&ctx->done_mutex);
+        av_freep(pctx);
+        return;
+    }
+
     nb_workers = ctx->nb_threads;
     if (!ctx->main_func)
         nb_workers--;
@@ -243,6 +500,15 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     return AVERROR(ENOSYS);
 }
 
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     void (*main_func)(void *priv),
+                                     int nb_threads, int pool_size)
+{
+    *pctx = NULL;
+    return AVERROR(ENOSYS);
+}
+
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
 {
     av_assert0(0);
@@ -35,6 +35,31 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*main_func)(void *priv),
                               int nb_threads);
 
+/**
+ * Create slice threading context running its jobs on a process-wide pool of
+ * worker threads shared by all contexts created with this function, plus the
+ * thread calling avpriv_slicethread_execute().
+ * The pool is created by the first such context and destroyed together with
+ * the last one.
+ * Jobs are started in order, but not necessarily all at the same time, so a
+ * job may wait on jobs with a lower number only.
+ * A context with a main_func gets threads of its own, as with
+ * avpriv_slicethread_create(), since main_func runs alongside the jobs.
+ * @param pctx slice threading context returned here
+ * @param priv private pointer to be passed to callback function
+ * @param worker_func callback function to be executed
+ * @param main_func special callback function, called from main thread, may be NULL
+ * @param nb_threads maximum number of jobs run concurrently for this context,
+ *                   0 for automatic, must be >= 0
+ * @param pool_size number of threads of the pool if it is created by this
+ *                  call, 0 for automatic, must be >= 0
+ * @return return number of threads or negative AVERROR on failure
+ */
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     void (*main_func)(void *priv),
+                                     int nb_threads, int pool_size);
+
 /**
  * Execute slice threading.
  * @param ctx slice threading context
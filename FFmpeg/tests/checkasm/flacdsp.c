@@ -21,6 +21,7 @@
 #include <string.h>
 #include "checkasm.h"
 #include "libavcodec/flacdsp.h"
+#include "libavcodec/mathops.h"
 #include "libavutil/common.h"
 #include "libavutil/internal.h"
 #include "libavutil/intreadwrite.h"
@@ -54,6 +55,39 @@ static void check_decorrelate(uint8_t **ref_dst, uint8_t **ref_src, uint8_t **ne
     bench_new(new_dst, (int32_t **)new_src, channels, BUF_SIZE / sizeof(int32_t), 8);
 }
 
+#define LPC_BUF_SIZE 4608
+
+static void check_lpc_encode(FLACDSPContext *h)
+{
+    LOCAL_ALIGNED_32(int32_t, smp,     [LPC_BUF_SIZE + 32]);
+    LOCAL_ALIGNED_32(int32_t, ref_res, [LPC_BUF_SIZE + 32]);
+    LOCAL_ALIGNED_32(int32_t, new_res, [LPC_BUF_SIZE + 32]);
+    int32_t coefs[32];
+    int i, order;
+
+    declare_func(void, int32_t *res, const int32_t *smp, int len, int order,
+                 const int32_t *coefs, int shift);
+
+    for (i = 0; i < LPC_BUF_SIZE + 32; i++)
+        smp[i] = sign_extend(rnd(), 16);
+
+    for (order = 1; order <= 32; order++) {
+        if (check_func(h->lpc16_encode, "flac_enc_lpc_16_%d", order)) {
+            int len   = LPC_BUF_SIZE - (rnd() & 255);
+            int shift = rnd() % 15;
+
+            for (i = 0; i < order; i++)
+                coefs[i] = sign_extend(rnd(), 11);
+
+            call_ref(ref_res, smp, len, order, coefs, shift);
+            call_new(new_res, smp, len, order, coefs, shift);
+            if (memcmp(ref_res, new_res, len * sizeof(*ref_res)))
+                fail();
+            bench_new(new_res, smp, LPC_BUF_SIZE, order, coefs, shift);
+        }
+    }
+}
+
 void checkasm_check_flacdsp(void)
 {
     LOCAL_ALIGNED_16(uint8_t, ref_dst, [BUF_SIZE*MAX_CHANNELS]);
@@ -88,4 +122,8 @@ void checkasm_check_flacdsp(void)
     }
 
     report("decorrelate");
+
+    ff_flacdsp_init(&h, AV_SAMPLE_FMT_S16, 2, 16);
+    check_lpc_encode(&h);
+    report("lpc_encode");
 }
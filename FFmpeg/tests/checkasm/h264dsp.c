@@ -439,6 +439,100 @@ static void check_loop_filter_intra(void)
     }
 }
 
+#define WEIGHT_STRIDE 64
+
+/* heights used with each block width, zero terminated */
+static const uint8_t weight_heights[4][4] = {
+    { 16, 8 }, { 16, 8, 4 }, { 8, 4, 2 }, { 4, 2 },
+};
+
+static void check_weight(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, dst,  [16 * WEIGHT_STRIDE]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [16 * WEIGHT_STRIDE]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [16 * WEIGHT_STRIDE]);
+    H264DSPContext h;
+    int bit_depth, i, j, k;
+
+    declare_func_emms(AV_CPU_FLAG_MMX, void, uint8_t *block, ptrdiff_t stride,
+                      int height, int log2_denom, int weight, int offset);
+
+    for (bit_depth = 8; bit_depth <= 10; bit_depth++) {
+        uint32_t mask = pixel_mask[bit_depth - 8];
+        ff_h264dsp_init(&h, bit_depth, 1);
+        for (i = 0; i < 4; i++) {
+            for (j = 0; weight_heights[i][j]; j++) {
+                int height = weight_heights[i][j];
+                if (check_func(h.weight_h264_pixels_tab[i], "h264_weight_%dx%d_%dbpp",
+                               16 >> i, height, bit_depth)) {
+                    int log2_denom = rnd() % 8;
+                    int weight     = (int)(rnd() % 128) - 64;
+                    int offset     = (int)(rnd() % 128) - 64;
+
+                    for (k = 0; k < 16 * WEIGHT_STRIDE; k += 4)
+                        AV_WN32A(dst + k, rnd() & mask);
+                    memcpy(dst0, dst, 16 * WEIGHT_STRIDE);
+                    memcpy(dst1, dst, 16 * WEIGHT_STRIDE);
+                    call_ref(dst0, WEIGHT_STRIDE, height, log2_denom, weight, offset);
+                    call_new(dst1, WEIGHT_STRIDE, height, log2_denom, weight, offset);
+                    if (memcmp(dst0, dst1, 16 * WEIGHT_STRIDE)) {
+                        fprintf(stderr, "weight: log2_denom:%d weight:%d offset:%d\n",
+                                log2_denom, weight, offset);
+                        fail();
+                    }
+                    bench_new(dst1, WEIGHT_STRIDE, height, log2_denom, weight, offset);
+                }
+            }
+        }
+    }
+}
+
+static void check_biweight(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,  [16 * WEIGHT_STRIDE]);
+    LOCAL_ALIGNED_32(uint8_t, dst,  [16 * WEIGHT_STRIDE]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [16 * WEIGHT_STRIDE]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [16 * WEIGHT_STRIDE]);
+    H264DSPContext h;
+    int bit_depth, i, j, k;
+
+    declare_func_emms(AV_CPU_FLAG_MMX, void, uint8_t *dst, uint8_t *src,
+                      ptrdiff_t stride, int height, int log2_denom,
+                      int weightd, int weights, int offset);
+
+    for (bit_depth = 8; bit_depth <= 10; bit_depth++) {
+        uint32_t mask = pixel_mask[bit_depth - 8];
+        ff_h264dsp_init(&h, bit_depth, 1);
+        for (i = 0; i < 4; i++) {
+            for (j = 0; weight_heights[i][j]; j++) {
+                int height = weight_heights[i][j];
+                if (check_func(h.biweight_h264_pixels_tab[i], "h264_biweight_%dx%d_%dbpp",
+                               16 >> i, height, bit_depth)) {
+                    int log2_denom = rnd() % 8;
+                    int weightd    = (int)(rnd() % 64) - 32;
+                    int weights    = (int)(rnd() % 64) - 32;
+                    int offset     = (int)(rnd() % 128) - 64;
+
+                    for (k = 0; k < 16 * WEIGHT_STRIDE; k += 4) {
+                        AV_WN32A(src + k, rnd() & mask);
+                        AV_WN32A(dst + k, rnd() & mask);
+                    }
+                    memcpy(dst0, dst, 16 * WEIGHT_STRIDE);
+                    memcpy(dst1, dst, 16 * WEIGHT_STRIDE);
+                    call_ref(dst0, src, WEIGHT_STRIDE, height, log2_denom, weightd, weights, offset);
+                    call_new(dst1, src, WEIGHT_STRIDE, height, log2_denom, weightd, weights, offset);
+                    if (memcmp(dst0, dst1, 16 * WEIGHT_STRIDE)) {
+                        fprintf(stderr, "biweight: log2_denom:%d weightd:%d weights:%d offset:%d\n",
+                                log2_denom, weightd, weights, offset);
+                        fail();
+                    }
+                    bench_new(dst1, src, WEIGHT_STRIDE, height, log2_denom, weightd, weights, offset);
+                }
+            }
+        }
+    }
+}
+
 void checkasm_check_h264dsp(void)
 {
     check_idct();
@@ -450,4 +544,10 @@ void checkasm_check_h264dsp(void)
 
     check_loop_filter_intra();
     report("loop_filter_intra");
+
+    check_weight();
+    report("weight");
+
+    check_biweight();
+    report("biweight");
 }
@@ -101,6 +101,29 @@ static void check_sub_left_pred(LLVidEncDSPContext *c)
     }
 }
 
+static void check_sum_abs_bytes(LLVidEncDSPContext *c)
+{
+    int i;
+    LOCAL_ALIGNED_32(uint8_t, src, [MAX_STRIDE + 1]);
+
+    declare_func(int, const uint8_t *src, intptr_t w);
+
+    randomize_buffers(src, MAX_STRIDE);
+    src[MAX_STRIDE] = 0x80;
+
+    if (check_func(c->sum_abs_bytes, "sum_abs_bytes")) {
+        for (i = 0; i < 5; i ++) {
+            /* odd start to match the filter type byte in front of a PNG row */
+            if (call_ref(src + (i & 1), planes[i].w) !=
+                call_new(src + (i & 1), planes[i].w))
+                fail();
+        }
+        if (call_ref(src + 1, MAX_STRIDE) != call_new(src + 1, MAX_STRIDE))
+            fail();
+        bench_new(src + 1, MAX_STRIDE);
+    }
+}
+
 void checkasm_check_llviddspenc(void)
 {
     LLVidEncDSPContext c;
@@ -111,4 +134,7 @@ void checkasm_check_llviddspenc(void)
 
     check_sub_left_pred(&c);
     report("sub_left_predict");
+
+    check_sum_abs_bytes(&c);
+    report("sum_abs_bytes");
 }
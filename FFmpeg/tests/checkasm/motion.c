@@ -0,0 +1,139 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/mem_internal.h"
+
+#include "libavcodec/avcodec.h"
+#include "libavcodec/me_cmp.h"
+
+#include "checkasm.h"
+
+/* 16 pixel wide blocks are tested with h 8 and 16, the x86 versions of the
+ * 8 pixel wide ones only support h 8. */
+#define STRIDE   64
+#define BUF_SIZE (STRIDE * 18)
+
+/* The second block is the first one plus a small difference, like for a
+ * real motion search, so that the saturating 16 bit sums of the hadamard
+ * SIMD versions do not overflow. */
+static void fill_blocks(uint8_t *pix1, uint8_t *pix2)
+{
+    int i;
+
+    for (i = 0; i < BUF_SIZE; i++) {
+        pix1[i] = rnd();
+        pix2[i] = av_clip_uint8(pix1[i] + (int)(rnd() % 65) - 32);
+    }
+}
+
+static void check_cmp(me_cmp_func *funcs, const char *name, int nb_funcs,
+                      uint8_t *pix1, uint8_t *pix2)
+{
+    static const int widths[] = { 16, 8, 4 };
+    int i, h;
+
+    declare_func_emms(AV_CPU_FLAG_MMX, int, struct MpegEncContext *c,
+                      uint8_t *blk1, uint8_t *blk2, ptrdiff_t stride, int h);
+
+    for (i = 0; i < nb_funcs; i++) {
+        int w = widths[i];
+
+        if (!funcs[i] || !check_func(funcs[i], "%s_%d", name, w))
+            continue;
+        for (h = 8; h <= FFMAX(w, 8); h *= 2) {
+            /* the reference block may start at any pixel */
+            int offset = rnd() % (STRIDE - 2 * w);
+            int ref, new;
+
+            fill_blocks(pix1, pix2);
+            ref = call_ref(NULL, pix1, pix2 + offset, STRIDE, h);
+            new = call_new(NULL, pix1, pix2 + offset, STRIDE, h);
+            if (ref != new) {
+                fprintf(stderr, "%s_%d h %d: %d != %d\n", name, w, h, ref, new);
+                fail();
+            }
+        }
+        bench_new(NULL, pix1, pix2 + 1, STRIDE, FFMAX(w, 8));
+    }
+}
+
+static void check_pix_abs(me_cmp_func funcs[2][4], uint8_t *pix1, uint8_t *pix2)
+{
+    static const char *const suffix[] = { "", "_x2", "_y2", "_xy2" };
+    int i, j, h;
+
+    declare_func_emms(AV_CPU_FLAG_MMX, int, struct MpegEncContext *c,
+                      uint8_t *blk1, uint8_t *blk2, ptrdiff_t stride, int h);
+
+    for (i = 0; i < 2; i++) {
+        int w = 16 >> i;
+
+        for (j = 0; j < 4; j++) {
+            if (!check_func(funcs[i][j], "pix_abs%d%s", w, suffix[j]))
+                continue;
+            for (h = 8; h <= w; h *= 2) {
+                int offset = rnd() % (STRIDE - 2 * w);
+                int ref, new;
+
+                fill_blocks(pix1, pix2);
+                ref = call_ref(NULL, pix1, pix2 + offset, STRIDE, h);
+                new = call_new(NULL, pix1, pix2 + offset, STRIDE, h);
+                if (ref != new) {
+                    fprintf(stderr, "pix_abs%d%s h %d: %d != %d\n",
+                            w, suffix[j], h, ref, new);
+                    fail();
+                }
+            }
+            bench_new(NULL, pix1, pix2 + 1, STRIDE, FFMAX(w, 8));
+        }
+    }
+}
+
+void checkasm_check_motion(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, pix1, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, pix2, [BUF_SIZE]);
+    AVCodecContext avctx = {
+        .flags = AV_CODEC_FLAG_BITEXACT,
+    };
+    MECmpContext c = { 0 };
+
+    ff_me_cmp_init(&c, &avctx);
+
+    check_pix_abs(c.pix_abs, pix1, pix2);
+    report("pix_abs");
+
+    check_cmp(c.sad, "sad", 2, pix1, pix2);
+    report("sad");
+
+    check_cmp(c.sse, "sse", 3, pix1, pix2);
+    report("sse");
+
+    check_cmp(c.nsse, "nsse", 2, pix1, pix2);
+    report("nsse");
+
+    check_cmp(c.hadamard8_diff, "hadamard8_diff", 2, pix1, pix2);
+    report("hadamard8_diff");
+
+    check_cmp(c.vsad, "vsad", 2, pix1, pix2);
+    check_cmp(c.vsad + 4, "vsad_intra", 2, pix1, pix2);
+    report("vsad");
+}
@@ -135,6 +135,110 @@ ffmpeg(){
     run ffmpeg${PROGSUF}${EXECSUF} ${ffmpeg_args}
 }
 
+# runs each argument as a job of a worker, prints what the jobs write to
+# stdout and then the replies, sorted since the jobs may end in any order
+worker(){
+    replies="${outdir}/${test}.replies"
+    cleanfiles="$cleanfiles $replies"
+    printf '%s\n' "$@" |
+        run ffmpeg${PROGSUF}${EXECSUF} -nostats -cpuflags $cpuflags -worker_jobs 2 -worker_reply_fd 4 4>"$replies" || return
+    sort "$replies"
+}
+
+# stream copies an MPEG-4 file with a keyframe every 10 frames using
+# -smart_cut and the given options, then decodes the result
+smart_cut(){
+    src="${outdir}/${test}.avi"
+    cut="${outdir}/${test}.nut"
+    cleanfiles="$cleanfiles $src $cut"
+    ffmpeg -f lavfi -i testsrc2=d=3:r=10:s=176x144 -c:v mpeg4 -g 10 -qscale 4 \
+        -bitexact -y $(target_path $src) || return
+    ffmpeg -i $(target_path $src) "$@" -c copy -smart_cut -bitexact -y $(target_path $cut) || return
+    framecrc -i $(target_path $cut)
+}
+
+chunked_encode(){
+    src="${outdir}/${test}.avi"
+    out="${outdir}/${test}.nut"
+    cleanfiles="$cleanfiles $src $out"
+    ffmpeg -f lavfi -i testsrc2=d=3:r=10:s=176x144 -c:v mpeg4 -g 10 -qscale 4 \
+        -bitexact -y $(target_path $src) || return
+    ffmpeg -i $(target_path $src) "$@" -bitexact -y $(target_path $out) || return
+    framecrc -i $(target_path $out)
+}
+
+# prints the md5 of the remuxed file, whose layout differs between the box
+# rewrite and the normal path, and its frames
+fast_remux(){
+    src="${outdir}/${test}.src.mov"
+    out="${outdir}/${test}.mov"
+    cleanfiles="$cleanfiles $src $out"
+    ffmpeg -f lavfi -i testsrc2=d=1:r=10:s=176x144 -f lavfi -i sine=d=1 \
+        -c:v mpeg4 -qscale 4 -c:a pcm_s16le -bitexact -y $(target_path $src) || return
+    ffmpeg -i $(target_path $src) "$@" -c copy -fast_remux -bitexact -y $(target_path $out) || return
+    do_md5sum $out | awk '{print $1}'
+    framecrc -i $(target_path $out) -c copy
+}
+
+# probes a MP4 file and a stream copy of it starting at 0.5s, whose edit list
+# makes the decoder drop the frames before that
+probe_edit_list(){
+    src="${outdir}/${test}.src.mp4"
+    cut="${outdir}/${test}.mp4"
+    cleanfiles="$cleanfiles $src $cut"
+    ffmpeg -f lavfi -i testsrc2=d=3:r=10:s=176x144 -c:v mpeg2video -g 10 -bf 0 -qscale 4 \
+        -bitexact -y $(target_path $src) || return
+    ffmpeg -ss 0.5 -i $(target_path $src) -c copy -bitexact -y $(target_path $cut) || return
+    run ffprobe${PROGSUF}${EXECSUF} -bitexact "$@" $(target_path $src) || return
+    run ffprobe${PROGSUF}${EXECSUF} -bitexact "$@" $(target_path $cut)
+}
+
+# probes a list of two copies of a file and a missing file in batch mode; the
+# lines come in the order the inputs are done, so they are sorted
+probe_batch(){
+    src="${outdir}/${test}.nut"
+    list="${outdir}/${test}.list"
+    cleanfiles="$cleanfiles $src $list"
+    ffmpeg -f lavfi -i testsrc2=d=1:r=5:s=64x64 -c:v rawvideo -bitexact -y $(target_path $src) || return
+    printf '%s\n' $(target_path $src) $(target_path ${outdir}/${test}.missing) $(target_path $src) > $list
+    run ffprobe${PROGSUF}${EXECSUF} -bitexact -batch $(target_path $list) "$@" |
+        sed "s|$(target_path $outdir)/||g" | sort
+}
+
+# probes the GOPs of MPEG-2 video with two B-frames between the references
+probe_gops(){
+    src="${outdir}/${test}.nut"
+    cleanfiles="$cleanfiles $src"
+    ffmpeg -f lavfi -i testsrc2=d=3:r=10:s=176x144 -c:v mpeg2video -g 12 -bf 2 -qscale 4 \
+        -bitexact -y $(target_path $src) || return
+    run ffprobe${PROGSUF}${EXECSUF} -bitexact -show_gops "$@" $(target_path $src)
+}
+
+# runs ffmpeg with -profile_report and prints the report, with the times,
+# which vary between runs, replaced by 0
+profile_report(){
+    report="${outdir}/${test}.json"
+    cleanfiles="$cleanfiles $report"
+    ffmpeg "$@" -profile_report $(target_path $report) || return
+    sed -E -e 's/"(time_us|wall_time_us|cpu_time_us|max_latency_us)":[0-9]+/"\1":0/g' \
+        -e 's/"latency_hist":\[[0-9,]*\]/"latency_hist":[]/g' "$report"
+}
+
+# runs framecrc on an MPEG-2 stream whose size changes from 176x144 to
+# 352x288 after 5 frames, with the given input and output options
+size_change(){
+    in_opts=$1
+    out_opts=$2
+    src1="${outdir}/${test}-1.m2v"
+    src2="${outdir}/${test}-2.m2v"
+    cleanfiles="$cleanfiles $src1 $src2"
+    for size in 176x144:$src1 352x288:$src2; do
+        ffmpeg -f lavfi -i testsrc2=d=1:r=5:s=${size%%:*} -c:v mpeg2video -qscale 4 -g 1 \
+            -bitexact -f mpeg2video -y $(target_path ${size#*:}) || return
+    done
+    framecrc $in_opts -f mpegvideo -i concat:$(target_path $src1)\|$(target_path $src2) $out_opts
+}
+
 ffprobe_demux(){
     filename=$1
     shift
@@ -170,6 +170,10 @@ FATE_ACODEC-$(call ENCDEC, WAVPACK, WV) += fate-acodec-wavpack
 fate-acodec-wavpack: FMT = wv
 fate-acodec-wavpack: CODEC = wavpack -compression_level 1
 
+# frame threads returning each frame as soon as it is decoded
+FATE_ACODEC-$(call ENCDEC, WAVPACK, WV) += fate-acodec-wavpack-low-latency-threads
+fate-acodec-wavpack-low-latency-threads: CMD = threads=4 thread_type=frame enc_dec wav $(SRC) wv "-b:a 128k -c wavpack -compression_level 1" wav "-c pcm_s16le" "" "-flags2 +low_latency_threads"
+
 FATE_ACODEC-$(call ENCDEC, TTA, TTA) += fate-acodec-tta
 fate-acodec-tta: FMT = tta
 
@@ -41,6 +41,57 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -auto_conversion_filters -idct simpl
 FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+# encoder threads and a muxing thread, with the frame limits checked by the main
+# thread, same output as without the threads
+FATE_FFMPEG-$(call ALLYES, TESTSRC2_FILTER SINE_FILTER LAVFI_INDEV MPEG4_ENCODER PCM_S16LE_ENCODER FRAMECRC_MUXER) += fate-ffmpeg-enc-thread
+fate-ffmpeg-enc-thread: CMD = framecrc -f lavfi -i testsrc2=d=2:r=25:s=176x144 -f lavfi -i sine=d=2 \
+  -c:v mpeg4 -qscale 5 -c:a pcm_s16le -frames:v 20 -frames:a 30 -enc_thread_queue_size 8 -mux_thread_queue_size 1M -fflags +bitexact
+
+# -fs counts the packets queued for the muxing thread as written, the
+# output stops after the 6th frame of 38016 bytes, as without the thread
+FATE_FFMPEG-$(call ALLYES, TESTSRC2_FILTER LAVFI_INDEV RAWVIDEO_ENCODER RAWVIDEO_MUXER) += fate-ffmpeg-mux-thread-fs
+fate-ffmpeg-mux-thread-fs: CMD = md5 -f lavfi -i testsrc2=d=2:r=25:s=176x144 -c:v rawvideo -fs 200000 -mux_thread_queue_size 1M -bitexact -f rawvideo
+
+# a single input is read from its own thread by default, here with a
+# readahead small enough to be held back and raised, same output as with
+# -thread_queue_size 0
+FATE_FFMPEG-$(call ALLYES, RAWVIDEO_DEMUXER RAWVIDEO_DECODER RAWVIDEO_ENCODER FRAMECRC_MUXER) += fate-ffmpeg-input-thread
+fate-ffmpeg-input-thread: tests/data/vsynth1.yuv
+fate-ffmpeg-input-thread: CMD = framecrc -f rawvideo -s 352x288 -pix_fmt yuv420p -thread_queue_bytes 4M -i $(TARGET_PATH)/tests/data/vsynth1.yuv -c:v rawvideo
+
+# a mid-stream size change with -reinit_filter 2 reconfigures the scaler added
+# in front of yadif instead of rebuilding the graph, so no frame is lost
+FATE_FFMPEG-$(call ALLYES, TESTSRC2_FILTER LAVFI_INDEV MPEG2VIDEO_ENCODER MPEG2VIDEO_MUXER CONCAT_PROTOCOL MPEGVIDEO_DEMUXER MPEG2VIDEO_DECODER YADIF_FILTER SCALE_FILTER RAWVIDEO_ENCODER FRAMECRC_MUXER) += fate-ffmpeg-reinit-filter-size
+fate-ffmpeg-reinit-filter-size: CMD = size_change "-reinit_filter 2" "-vf yadif=deint=all -sws_flags +accurate_rnd+bitexact -c:v rawvideo"
+
+FATE_FFMPEG-$(call ALLYES, TESTSRC2_FILTER LAVFI_INDEV HFLIP_FILTER RAWVIDEO_ENCODER NULL_MUXER) += fate-ffmpeg-profile-report
+fate-ffmpeg-profile-report: CMD = profile_report -f lavfi -i testsrc2=d=1:r=5:s=64x64 -vf hflip -c:v rawvideo -f null -
+
+# keeps frames 4 to 23 of 30 with keyframes every 10 frames: frames 4 to 9 and
+# 20 to 23 are re-encoded, the latter once the input ends, and the GOP in
+# between is copied; then a cut starting in the last GOP
+FATE_FFMPEG-$(call ALLYES, TESTSRC2_FILTER LAVFI_INDEV MPEG4_ENCODER MPEG4_DECODER AVI_MUXER AVI_DEMUXER NUT_MUXER NUT_DEMUXER RAWVIDEO_ENCODER FRAMECRC_MUXER) += fate-ffmpeg-smart-cut fate-ffmpeg-smart-cut-last-gop
+fate-ffmpeg-smart-cut: CMD = smart_cut -ss 0.35 -t 2
+fate-ffmpeg-smart-cut-last-gop: CMD = smart_cut -ss 2.35
+
+# three chunks starting at the keyframes of the input, which are also where the
+# encoder puts its keyframes, so the output is the same as without -chunks
+FATE_FFMPEG-$(call ALLYES, TESTSRC2_FILTER LAVFI_INDEV MPEG4_ENCODER MPEG4_DECODER AVI_MUXER AVI_DEMUXER NUT_MUXER NUT_DEMUXER CONCAT_DEMUXER RAWVIDEO_ENCODER FRAMECRC_MUXER) += fate-ffmpeg-chunks
+fate-ffmpeg-chunks: CMD = chunked_encode -c:v mpeg4 -g 10 -qscale 4 -chunks 3
+
+# drops the audio track, changes the title and moves the moov box in front
+FATE_FFMPEG-$(call ALLYES, TESTSRC2_FILTER SINE_FILTER LAVFI_INDEV MPEG4_ENCODER PCM_S16LE_ENCODER MOV_MUXER MOV_DEMUXER FRAMECRC_MUXER) += fate-ffmpeg-fast-remux
+fate-ffmpeg-fast-remux: CMD = fast_remux -map 0:v -metadata title=remuxed -movflags +faststart
+
+# a transcode writing to stdout, a failing job, a decode benchmark and a
+# nested worker, which is refused
+FATE_FFMPEG_WORKER-$(call ALLYES, COLOR_FILTER LAVFI_INDEV FRAMECRC_MUXER) += fate-ffmpeg-worker
+fate-ffmpeg-worker: CMD = worker "-lavfi color=d=1:r=5 -fflags +bitexact -bitexact -f framecrc -" \
+  "-i $(TARGET_PATH)/tests/data/fate/ffmpeg-worker-missing.nut -f null -" \
+  "-decode_bench v -f lavfi -i color=d=1:r=5" "-worker_jobs 1"
+
+FATE_FFMPEG-$(HAVE_FORK) += $(FATE_FFMPEG_WORKER-yes)
+
 FATE_SAMPLES_FFMPEG-$(CONFIG_RAWVIDEO_DEMUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth_lena.yuv
 fate-force_key_frames: CMD = enc_dec \
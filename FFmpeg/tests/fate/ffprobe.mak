@@ -34,8 +34,23 @@ fate-ffprobe_xsd: $(FFPROBE_TEST_FILE)
 fate-ffprobe_xsd: CMD = run $(FFPROBE_COMMAND) -noprivate -of xml=q=1:x=1 | \
 	xmllint --schema $(SRC_PATH)/doc/ffprobe.xsd -
 
+# the counts are taken from the index, except for the stream with an edit list
+FATE_FFMPEG_FFPROBE-$(call ALLYES, TESTSRC2_FILTER LAVFI_INDEV MPEG2VIDEO_ENCODER MPEG2VIDEO_DECODER MP4_MUXER MOV_DEMUXER) += fate-ffprobe-count-from-index
+fate-ffprobe-count-from-index: CMD = probe_edit_list -count_from_index -count_frames -count_packets -show_entries stream=nb_frames,nb_read_frames,nb_read_packets,nb_index_keyframes,index_bit_rate,index_max_bit_rate -of compact
+
+FATE_FFMPEG_FFPROBE-$(call ALLYES, TESTSRC2_FILTER LAVFI_INDEV MPEG2VIDEO_ENCODER MPEGVIDEO_PARSER NUT_MUXER NUT_DEMUXER) += fate-ffprobe-gops-csv fate-ffprobe-gops-json
+fate-ffprobe-gops-csv: CMD = probe_gops -of csv
+fate-ffprobe-gops-json: CMD = probe_gops -of json
+
+# batch mode forks a process per input
+FATE_FFPROBE_BATCH-$(call ALLYES, TESTSRC2_FILTER LAVFI_INDEV RAWVIDEO_ENCODER NUT_MUXER NUT_DEMUXER) += fate-ffprobe-batch
+fate-ffprobe-batch: CMD = probe_batch -batch_jobs 2 -show_entries format=format_name,nb_streams:stream=codec_name,width,height
+
+FATE_FFMPEG_FFPROBE-$(HAVE_FORK) += $(FATE_FFPROBE_BATCH-yes)
+
 FATE_FFPROBE-$(HAVE_XMLLINT) += $(FATE_FFPROBE_SCHEMA-yes)
 FATE_FFPROBE += $(FATE_FFPROBE-yes)
+FATE_FFMPEG_FFPROBE += $(FATE_FFMPEG_FFPROBE-yes)
 
-fate-ffprobe: $(FATE_FFPROBE)
+fate-ffprobe: $(FATE_FFPROBE) $(FATE_FFMPEG_FFPROBE)
 
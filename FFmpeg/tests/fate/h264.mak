@@ -229,6 +229,36 @@ FATE_H264-$(call DEMDEC, MOV, H264) += fate-h264-attachment-631
 FATE_H264-$(call DEMDEC, MPEGTS, H264) += fate-h264-skip-nokey fate-h264-skip-nointra
 FATE_H264_FFPROBE-$(call DEMDEC, MATROSKA, H264) += fate-h264-dts_5frames
 
+# conformance samples decoded with the loop filter on its own thread, which
+# must give the same output; MBAFF and field pictures keep the in-loop filter
+define FATE_H264_DEBLOCK_THREAD_TEST
+FATE_H264-$(call DEMDEC, H264, H264) += fate-h264-deblock-thread-$(1)
+fate-h264-deblock-thread-$(1): CMD = framecrc -deblock_thread 1 -i $(TARGET_SAMPLES)/h264-conformance/$(2) $(3)
+fate-h264-deblock-thread-$(1): REF = $(SRC_PATH)/tests/ref/fate/h264-conformance-$(1)
+endef
+
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,ba1_sony_d,BA1_Sony_D.jsv))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,ba3_sva_c,BA3_SVA_C.264))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,caba1_sva_b,CABA1_SVA_B.264))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,caba3_toshiba_e,CABA3_TOSHIBA_E.264))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,cabac_mot_frm0_full,camp_mot_frm0_full.26l))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,cabast3_sony_e,CABAST3_Sony_E.jsv))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,cabref3_sand_d,CABREF3_Sand_D.264))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,cama1_sony_c,CAMA1_Sony_C.jsv))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,camp_mot_mbaff_l30,CAMP_MOT_MBAFF_L30.26l))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,cvbs3_sony_c,CVBS3_Sony_C.jsv))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,cvfi1_sony_d,CVFI1_Sony_D.jsv))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,cvmp_mot_frm_l31_b,CVMP_MOT_FRM_L31_B.26l))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,cvwp1_toshiba_e,CVWP1_TOSHIBA_E.264))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,frext-frext1_panasonic_c,FRext/FRExt1_Panasonic.avc))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,frext-hcaff1_hhi_b,FRext/HCAFF1_HHI.264))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,frext-hi422fr1_sony_a,FRext/Hi422FR1_SONY_A.jsv))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,frext-hpcv_brcm_a,FRext/HPCV_BRCM_A.264))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,frext-pph10i1_panasonic_a,FRext/PPH10I1_Panasonic_A.264,-pix_fmt yuv420p10le -vf scale))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,mr1_bt_a,MR1_BT_A.h264))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,mr2_tandberg_e,MR2_TANDBERG_E.264))
+$(eval $(call FATE_H264_DEBLOCK_THREAD_TEST,sl1_sva_b,SL1_SVA_B.264))
+
 FATE_SAMPLES_AVCONV += $(FATE_H264-yes)
 FATE_SAMPLES_FFPROBE += $(FATE_H264_FFPROBE-yes)
 fate-h264: $(FATE_H264-yes) $(FATE_H264_FFPROBE-yes)
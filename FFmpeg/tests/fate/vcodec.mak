@@ -460,8 +460,25 @@ FATE_VCODEC-$(call ENCDEC, Y41P, AVI) += y41p
 
 FATE_VCODEC-$(call ENCDEC, ZLIB, AVI) += zlib
 
+# frame threads returning each frame as soon as it is decoded
+FATE_VSYNTH1_THREADS-$(call ENCDEC, MPEG4, AVI) += fate-vsynth1-mpeg4-low-latency-threads
+fate-vsynth1-mpeg4-low-latency-threads: CMD = threads=4 thread_type=frame enc_dec "rawvideo -s 352x288 -pix_fmt yuv420p" $(SRC) avi "-c mpeg4 -qscale 7 -bf 2 -flags +mv4" rawvideo "-s 352x288 -pix_fmt yuv420p -vsync 0" "" "-flags2 +low_latency_threads"
+
+# frame threads hand the frames to the encoder instances round robin, so the
+# rate controlled output does not depend on the scheduling
+FATE_VSYNTH1_THREADS-$(call ENCDEC, MPEG2VIDEO, MPEG2VIDEO MPEGVIDEO) += fate-vsynth1-mpeg2-frame-threads
+fate-vsynth1-mpeg2-frame-threads: CMD = enc_dec "rawvideo -s 352x288 -pix_fmt yuv420p" $(SRC) mpeg2video "-c mpeg2video -g 1 -b:v 4000k -threads 4 -thread_type frame" rawvideo "-s 352x288 -pix_fmt yuv420p -vsync 0"
+
+FATE_VSYNTH1_THREADS-$(call ENCDEC, MPEG4, AVI) += fate-vsynth1-mpeg4-frame-threads
+fate-vsynth1-mpeg4-frame-threads: CMD = enc_dec "rawvideo -s 352x288 -pix_fmt yuv420p" $(SRC) avi "-c mpeg4 -g 1 -b:v 2000k -threads 4 -thread_type frame" rawvideo "-s 352x288 -pix_fmt yuv420p -vsync 0"
+
+# slice threads deflate bands of rows on their own, which changes the file
+# but decodes to the same frames as fate-vsynth1-mpng
+FATE_VSYNTH1_THREADS-$(call ENCDEC, PNG, AVI) += fate-vsynth1-mpng-slice-threads
+fate-vsynth1-mpng-slice-threads: CMD = enc_dec "rawvideo -s 352x288 -pix_fmt yuv420p" $(SRC) avi "-c png -threads 4 -thread_type slice" rawvideo "-s 352x288 -pix_fmt yuv420p -vsync 0"
+
 FATE_VCODEC += $(FATE_VCODEC-yes)
-FATE_VSYNTH1 = $(FATE_VCODEC:%=fate-vsynth1-%)
+FATE_VSYNTH1 = $(FATE_VCODEC:%=fate-vsynth1-%) $(FATE_VSYNTH1_THREADS-yes)
 FATE_VSYNTH2 = $(FATE_VCODEC:%=fate-vsynth2-%)
 FATE_VSYNTH_LENA = $(FATE_VCODEC:%=fate-vsynth_lena-%)
 # Redundant tests because they just resize the input
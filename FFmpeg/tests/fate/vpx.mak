@@ -106,6 +106,15 @@ endef
 
 $(eval $(call FATE_VP8_FULL))
 
+# slice threads with a shared pool smaller than the number of jobs per frame
+define FATE_VP8_POOL
+FATE_VP8-$(call DEMDEC, IVF, VP8) += fate-vp8-test-vector-pool-$(1)
+fate-vp8-test-vector-pool-$(1): CMD = threads=4 thread_type=slice framemd5 -thread_pool_size 1 -i $(TARGET_SAMPLES)/vp8-test-vectors-r1/vp80-00-comprehensive-$(1).ivf
+fate-vp8-test-vector-pool-$(1): REF = $(SRC_PATH)/tests/ref/fate/vp8-test-vector-$(1)
+endef
+
+$(foreach N,$(VP8_SUITE),$(eval $(call FATE_VP8_POOL,$(N))))
+
 FATE_SAMPLES_AVCONV += $(FATE_VP8-yes)
 fate-vp8: $(FATE_VP8-yes)
 
@@ -0,0 +1,196 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Decode the same input in several concurrent codec contexts, first with
+ * per-context slice threads and then with the shared thread pool, and report
+ * the total throughput and the distribution of the time between two output
+ * frames of one context.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "decode_simple.h"
+
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/avcodec.h"
+
+typedef struct StreamData {
+    DecodeContext dc;
+    pthread_t     thread;
+    int           ret;
+
+    int64_t       last;
+    int64_t      *intervals;
+    int           nb_intervals;
+    int           intervals_allocated;
+} StreamData;
+
+static int process_frame(DecodeContext *dc, AVFrame *frame)
+{
+    StreamData *sd = dc->opaque;
+    int64_t now = av_gettime_relative();
+
+    if (!frame)
+        return 0;
+
+    if (sd->last != AV_NOPTS_VALUE) {
+        if (sd->nb_intervals == sd->intervals_allocated) {
+            int ret = av_reallocp_array(&sd->intervals, FFMAX(2 * sd->intervals_allocated, 256),
+                                        sizeof(*sd->intervals));
+            if (ret < 0)
+                return ret;
+            sd->intervals_allocated = FFMAX(2 * sd->intervals_allocated, 256);
+        }
+        sd->intervals[sd->nb_intervals++] = now - sd->last;
+    }
+    sd->last = now;
+
+    return 0;
+}
+
+static void *decode_thread(void *arg)
+{
+    StreamData *sd = arg;
+
+    sd->ret = ds_run(&sd->dc);
+    return NULL;
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+    const int64_t *x = a, *y = b;
+    return FFDIFFSIGN(*x, *y);
+}
+
+static int run(const char *filename, int nb_streams, int threads, int pool_size)
+{
+    StreamData *sd;
+    int64_t *all = NULL, start, elapsed;
+    int nb_all = 0, nb_frames = 0;
+    int i, ret = 0;
+
+    sd = av_calloc(nb_streams, sizeof(*sd));
+    if (!sd)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_streams; i++) {
+        ret = ds_open(&sd[i].dc, filename, 0);
+        if (ret < 0)
+            goto end;
+        sd[i].dc.process_frame = process_frame;
+        sd[i].dc.opaque        = &sd[i];
+        sd[i].last             = AV_NOPTS_VALUE;
+
+        av_dict_set_int(&sd[i].dc.decoder_opts, "threads", threads, 0);
+        av_dict_set(&sd[i].dc.decoder_opts, "thread_type", "slice", 0);
+        av_dict_set_int(&sd[i].dc.decoder_opts, "thread_pool_size", pool_size, 0);
+    }
+
+    start = av_gettime_relative();
+    for (i = 0; i < nb_streams; i++) {
+        ret = pthread_create(&sd[i].thread, NULL, decode_thread, &sd[i]);
+        if (ret) {
+            ret = AVERROR(ret);
+            nb_streams = i;
+            break;
+        }
+    }
+    for (i = 0; i < nb_streams; i++) {
+        pthread_join(sd[i].thread, NULL);
+        if (sd[i].ret < 0)
+            ret = sd[i].ret;
+    }
+    elapsed = av_gettime_relative() - start;
+    if (ret < 0)
+        goto end;
+
+    for (i = 0; i < nb_streams; i++) {
+        nb_frames += sd[i].dc.decoder->frame_number;
+        nb_all    += sd[i].nb_intervals;
+    }
+    all = av_malloc_array(FFMAX(nb_all, 1), sizeof(*all));
+    if (!all) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (nb_all = 0, i = 0; i < nb_streams; i++) {
+        memcpy(all + nb_all, sd[i].intervals, sd[i].nb_intervals * sizeof(*all));
+        nb_all += sd[i].nb_intervals;
+    }
+    qsort(all, nb_all, sizeof(*all), cmp_int64);
+
+    printf("%-14s streams %d threads %d: %d frames in %.3fs, %.1f fps",
+           pool_size ? "shared pool" : "per-context", nb_streams, threads,
+           nb_frames, elapsed / 1e6, nb_frames * 1e6 / FFMAX(elapsed, 1));
+    if (nb_all)
+        printf(", frame interval p50 %.2fms p99 %.2fms max %.2fms",
+               all[nb_all / 2] / 1e3, all[nb_all * 99 / 100] / 1e3,
+               all[nb_all - 1] / 1e3);
+    printf("\n");
+
+end:
+    for (i = 0; i < nb_streams; i++) {
+        av_freep(&sd[i].intervals);
+        ds_free(&sd[i].dc);
+    }
+    av_freep(&all);
+    av_freep(&sd);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int nb_streams, threads, pool_size = -1;
+    int ret;
+
+    if (argc < 4) {
+        fprintf(stderr,
+                "Usage: %s <input file> <number of streams> <threads per stream> [pool size]\n"
+                "Decodes the first stream of the input in each context with slice threading,\n"
+                "once with per-context threads and once with the shared thread pool.\n",
+                argv[0]);
+        return 1;
+    }
+
+    nb_streams = strtol(argv[2], NULL, 0);
+    threads    = strtol(argv[3], NULL, 0);
+    if (argc > 4)
+        pool_size = strtol(argv[4], NULL, 0);
+    if (nb_streams <= 0 || threads < 0 || !pool_size || pool_size < -1) {
+        fprintf(stderr, "Invalid parameters\n");
+        return 1;
+    }
+
+    ret = run(argv[1], nb_streams, threads, 0);
+    if (ret >= 0)
+        ret = run(argv[1], nb_streams, threads, pool_size);
+    if (ret < 0) {
+        fprintf(stderr, "Error: %s\n", av_err2str(ret));
+        return 1;
+    }
+
+    return 0;
+}
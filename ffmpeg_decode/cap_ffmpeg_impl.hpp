@@ -47,7 +47,10 @@
 #endif
 #include <assert.h>
 #include <algorithm>
+#include <condition_variable>
 #include <limits>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #define _FOURCC(c1, c2, c3, c4) (((c1) & 255) + (((c2) & 255) << 8) + (((c3) & 255) << 16) + (((c4) & 255) << 24))
@@ -75,6 +78,7 @@ extern "C" {
 
 #include <libavutil/mathematics.h>
 #include <libavutil/opt.h>
+#include <libavutil/threadmessage.h>
 
 #if LIBAVUTIL_BUILD >= (LIBAVUTIL_VERSION_MICRO >= 100 \
     ? CALC_FFMPEG_VERSION(51, 63, 100) : CALC_FFMPEG_VERSION(54, 6, 0))
@@ -1986,15 +1990,42 @@ bool FF_VideoDecoder::setProperty( int property_id, double value )
 
 
 ///////////////// FFMPEG CvVideoWriter implementation //////////////////////////
+
+// maximum number of encoded packets buffered per output before a slow
+// output blocks the encoder, or starts dropping if it may (it resumes at the next keyframe)
+#define FF_OUTPUT_QUEUE_SIZE 64
+
+/* one muxer fed by a shared encoder, see FF_VideoEncoder::outputs */
+struct FF_EncoderOutput
+{
+    AVFormatContext      * oc;
+    AVStream             * st;
+    AVBSFContext         * bsfc;    // dump_extra, when the encoder emits global headers and this muxer can't store them
+    AVThreadMessageQueue * queue;
+    std::thread          * thread;
+    bool                   header_written;
+    bool                   may_drop;       // drop packets instead of blocking the encoder when the queue is full
+    bool                   need_keyframe;
+    int64_t                nb_dropped;
+    int                    error;          // first error of this output, owned by the encoding thread
+    int                    mux_error;      // set by the muxing thread, only read once it is joined
+};
+
 struct FF_VideoEncoder
 {
     bool open( const char* filename, int fourcc,
                double fps, int width, int height, const VideoWriterParameters& params );
+    bool open( const char* const* filenames, const char* const* formats, const int* may_drop, int nb_files,
+               int fourcc, double fps, int width, int height, const VideoWriterParameters& params );
     void close();
     bool writeFrame( const unsigned char* data, int step, int width, int height, int cn, int origin );
     double getProperty(int propId) const;
+    int getOutputStatus(int index, int64_t* nb_dropped) const;
 
     void init();
+    bool openOutputs(const char* const* filenames);
+    bool convertFrame( const unsigned char* data, int step, int width, int height, int cn, int origin );
+    bool encodePicture();
 
     AVOutputFormat  * fmt;
     AVFormatContext * oc;
@@ -2015,6 +2046,11 @@ struct FF_VideoEncoder
     VideoAccelerationType va_type;
     int               hw_device;
     int               use_opencl;
+
+    /* when the writer was opened with several files, every encoded packet is
+       muxed into each of them; outputs[0] wraps oc/video_st */
+    FF_EncoderOutput* outputs;
+    int               nb_outputs;
 };
 
 static const char * _FFMPEGErrStr(int err)
@@ -2078,6 +2114,8 @@ void FF_VideoEncoder::init()
     va_type = VIDEO_ACCELERATION_NONE;
     hw_device = -1;
     use_opencl = 0;
+    outputs = NULL;
+    nb_outputs = 0;
     ok = false;
 }
 
@@ -2237,9 +2275,158 @@ static bool _configure_video_stream_FFMPEG(AVFormatContext *oc,
 
 static const int _NO_FRAMES_WRITTEN_CODE = 1000;
 
+static void _ff_free_packet_msg(void *msg)
+{
+    av_packet_free((AVPacket**)msg);
+}
+
+/* per-output muxing thread, so a stalled output only fills its own queue */
+static void _ff_output_mux_loop(FF_EncoderOutput* out)
+{
+    AVPacket* pkt;
+    while (av_thread_message_queue_recv(out->queue, &pkt, 0) >= 0)
+    {
+        int ret = av_write_frame(out->oc, pkt);
+        av_packet_free(&pkt);
+        if (ret < 0)
+        {
+            // stop accepting packets, the encoding thread gets ret from its next send
+            out->mux_error = ret;
+            av_thread_message_queue_set_err_send(out->queue, ret);
+            av_thread_message_flush(out->queue);
+        }
+    }
+}
+
+static int _ff_output_queue_packet(FF_EncoderOutput* out, AVPacket* pkt)
+{
+    if (out->error < 0)
+    {
+        av_packet_free(&pkt);
+        return out->error;
+    }
+    // after a drop the following packets reference missing data, so resume on a keyframe
+    if (out->need_keyframe && !(pkt->flags & AV_PKT_FLAG_KEY))
+    {
+        out->nb_dropped++;
+        av_packet_free(&pkt);
+        return 0;
+    }
+    int ret = av_thread_message_queue_send(out->queue, &pkt, out->may_drop ? AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (ret < 0)
+    {
+        av_packet_free(&pkt);
+        if (ret == AVERROR(EAGAIN))
+        {
+            out->need_keyframe = true;
+            out->nb_dropped++;
+            return 0;
+        }
+        out->error = ret;
+        return ret;
+    }
+    out->need_keyframe = false;
+    return 0;
+}
+
+/* hand one encoded packet to every output, sharing its payload; a failing
+   output is left behind (like tee's onfail=ignore), except for outputs[0]
+   whose error is returned */
+static int _ff_fanout_packet(FF_EncoderOutput* outputs, int nb_outputs,
+                             const AVPacket* pkt, AVRational time_base)
+{
+    for (int i = 0; i < nb_outputs; i++)
+    {
+        FF_EncoderOutput* out = &outputs[i];
+        AVPacket* opkt = av_packet_clone(pkt);
+        if (!opkt)
+            return AVERROR(ENOMEM);
+        av_packet_rescale_ts(opkt, time_base, out->st->time_base);
+        opkt->stream_index = out->st->index;
+
+        if (!out->bsfc)
+        {
+            _ff_output_queue_packet(out, opkt);
+        }
+        else
+        {
+            int ret = av_bsf_send_packet(out->bsfc, opkt);
+            av_packet_free(&opkt);
+            if (ret < 0 && out->error >= 0)
+                out->error = ret;
+            while (ret >= 0)
+            {
+                AVPacket* fpkt = av_packet_alloc();
+                if (!fpkt)
+                    return AVERROR(ENOMEM);
+                ret = av_bsf_receive_packet(out->bsfc, fpkt);
+                if (ret < 0)
+                {
+                    av_packet_free(&fpkt);
+                    break;
+                }
+                _ff_output_queue_packet(out, fpkt);
+            }
+        }
+
+        if (i == 0 && out->error < 0)
+            return out->error;
+    }
+    return 0;
+}
+
+/* stop the muxing threads once their queues are drained and finish the extra files */
+static void _ff_finish_outputs(FF_EncoderOutput* outputs, int nb_outputs)
+{
+    for (int i = 0; i < nb_outputs; i++)
+    {
+        FF_EncoderOutput* out = &outputs[i];
+        if (out->thread)
+        {
+            av_thread_message_queue_set_err_recv(out->queue, AVERROR_EOF);
+            out->thread->join();
+            delete out->thread;
+            out->thread = NULL;
+            if (out->error >= 0 && out->mux_error < 0)
+                out->error = out->mux_error;
+        }
+        // outputs[0] is the writer's own context, its trailer is written by close()
+        if (i > 0 && out->header_written)
+        {
+            av_write_trailer(out->oc);
+            out->header_written = false;
+        }
+    }
+}
+
+static void _ff_free_outputs(FF_EncoderOutput* outputs, int nb_outputs)
+{
+    if (!outputs)
+        return;
+    _ff_finish_outputs(outputs, nb_outputs);
+    for (int i = 0; i < nb_outputs; i++)
+    {
+        FF_EncoderOutput* out = &outputs[i];
+        if (out->nb_dropped > 0)
+            LOG_WARN(cv::format("Output #%d dropped %lld packets", i, (long long)out->nb_dropped).c_str());
+        if (out->error < 0)
+            LOG_WARN(cv::format("Output #%d failed: %s", i, _FFMPEGErrStr(out->error)).c_str());
+        av_thread_message_queue_free(&out->queue);
+        av_bsf_free(&out->bsfc);
+        if (i > 0 && out->oc)
+        {
+            if (!(out->oc->oformat->flags & AVFMT_NOFILE))
+                avio_closep(&out->oc->pb);
+            avformat_free_context(out->oc);
+        }
+    }
+    av_free(outputs);
+}
+
 static int _av_write_frame_FFMPEG( AVFormatContext * oc, AVStream * video_st,
                                       uint8_t *, uint32_t,
-                                      AVFrame * picture, int frame_idx)
+                                      AVFrame * picture, int frame_idx,
+                                      FF_EncoderOutput * outputs, int nb_outputs)
 {
     AVCodecContext* c = video_st->codec;
     int ret = _NO_FRAMES_WRITTEN_CODE;
@@ -2281,6 +2468,12 @@ static int _av_write_frame_FFMPEG( AVFormatContext * oc, AVStream * video_st,
 
             if(!ret)
             {
+                if (nb_outputs > 0)
+                {
+                    ret = _ff_fanout_packet(outputs, nb_outputs, pkt, c->time_base);
+                    av_packet_free(&pkt);
+                    continue;
+                }
                 av_packet_rescale_ts(pkt, c->time_base, video_st->time_base);
                 ret = av_write_frame(oc, pkt);
                 av_packet_free(&pkt);
@@ -2300,6 +2493,10 @@ static int _av_write_frame_FFMPEG( AVFormatContext * oc, AVStream * video_st,
         ret = avcodec_encode_video2(c, &pkt, picture, &got_output);
         if (ret < 0)
             ;
+        else if (got_output && nb_outputs > 0) {
+            ret = _ff_fanout_packet(outputs, nb_outputs, &pkt, c->time_base);
+            _ffmpeg_av_packet_unref(&pkt);
+        }
         else if (got_output) {
             if (pkt.pts != (int64_t)AV_NOPTS_VALUE)
                 pkt.pts = av_rescale_q(pkt.pts, c->time_base, video_st->time_base);
@@ -2320,6 +2517,12 @@ static int _av_write_frame_FFMPEG( AVFormatContext * oc, AVStream * video_st,
 
 /// write a frame with FFMPEG
 bool FF_VideoEncoder::writeFrame( const unsigned char* data, int step, int width, int height, int cn, int origin )
+{
+    return convertFrame(data, step, width, height, cn, origin) && encodePicture();
+}
+
+/// bring the caller's image into 'picture' in the encoder's pixel format
+bool FF_VideoEncoder::convertFrame( const unsigned char* data, int step, int width, int height, int cn, int origin )
 {
     // check parameters
     if (input_pix_fmt == AV_PIX_FMT_BGR24) {
@@ -2418,6 +2621,12 @@ bool FF_VideoEncoder::writeFrame( const unsigned char* data, int step, int width
         picture->linesize[0] = step;
     }
 
+    return true;
+}
+
+/// encode the content of 'picture' and hand the packets to the muxer(s)
+bool FF_VideoEncoder::encodePicture()
+{
     bool ret;
 #if USE_AV_HW_CODECS
     if (video_st->codec->hw_device_ctx) {
@@ -2438,14 +2647,14 @@ bool FF_VideoEncoder::writeFrame( const unsigned char* data, int step, int width
             return false;
         }
         hw_frame->pts = frame_idx;
-        int ret_write = _av_write_frame_FFMPEG(oc, video_st, outbuf, outbuf_size, hw_frame, frame_idx);
+        int ret_write = _av_write_frame_FFMPEG(oc, video_st, outbuf, outbuf_size, hw_frame, frame_idx, outputs, nb_outputs);
         ret = ret_write >= 0 ? true : false;
         av_frame_free(&hw_frame);
     } else
 #endif
     {
         picture->pts = frame_idx;
-        int ret_write = _av_write_frame_FFMPEG(oc, video_st, outbuf, outbuf_size, picture, frame_idx);
+        int ret_write = _av_write_frame_FFMPEG(oc, video_st, outbuf, outbuf_size, picture, frame_idx, outputs, nb_outputs);
         ret = ret_write >= 0 ? true : false;
     }
 
@@ -2474,12 +2683,27 @@ double FF_VideoEncoder::getProperty(int propId) const
     return 0;
 }
 
+/// error (or 0) and number of dropped packets of one output of a multi-output writer
+int FF_VideoEncoder::getOutputStatus(int index, int64_t* nb_dropped) const
+{
+    if (index < 0 || index >= FFMAX(nb_outputs, 1))
+        return AVERROR(EINVAL);
+    if (nb_dropped)
+        *nb_dropped = nb_outputs ? outputs[index].nb_dropped : 0;
+    return nb_outputs ? outputs[index].error : 0;
+}
+
 /// close video output stream and free associated memory
 void FF_VideoEncoder::close()
 {
     // nothing to do if already released
     if ( !picture )
+    {
+        _ff_free_outputs(outputs, nb_outputs);
+        outputs = NULL;
+        nb_outputs = 0;
         return;
+    }
 
     /* no more frame to compress. The codec has a latency of a few
        frames if using B frames, so we get the last frames by
@@ -2495,13 +2719,16 @@ void FF_VideoEncoder::close()
         {
             for(;;)
             {
-                int ret = _av_write_frame_FFMPEG( oc, video_st, outbuf, outbuf_size, NULL, frame_idx);
+                int ret = _av_write_frame_FFMPEG( oc, video_st, outbuf, outbuf_size, NULL, frame_idx, outputs, nb_outputs);
                 if( ret == _NO_FRAMES_WRITTEN_CODE || ret < 0 )
                     break;
             }
         }
+        _ff_finish_outputs(outputs, nb_outputs);
         av_write_trailer(oc);
     }
+    // the muxing threads must be gone before the contexts they use are freed
+    _ff_finish_outputs(outputs, nb_outputs);
 
     if( img_convert_ctx )
     {
@@ -2538,6 +2765,8 @@ void FF_VideoEncoder::close()
         avformat_free_context(oc);
     }
 
+    _ff_free_outputs(outputs, nb_outputs);
+
     av_freep(&aligned_input);
 
     init();
@@ -2586,6 +2815,16 @@ static inline void _ff_codec_tag_dump(const AVCodecTag *const *tags)
 /// Create a video writer object that uses FFMPEG
 bool FF_VideoEncoder::open( const char * filename, int fourcc,
                                  double fps, int width, int height, const VideoWriterParameters& params)
+{
+    return open(&filename, NULL, NULL, 1, fourcc, fps, width, height, params);
+}
+
+/// Create a video writer which encodes once and muxes the packets into each of 'filenames'
+/// ('formats' may be NULL, or hold NULL entries, to guess the container from the name;
+/// the outputs for which 'may_drop' is set drop packets rather than stall the encoder)
+bool FF_VideoEncoder::open( const char* const* filenames, const char* const* formats, const int* may_drop,
+                                 int nb_files, int fourcc, double fps, int width, int height,
+                                 const VideoWriterParameters& params)
 {
     InternalFFMpegRegister::init();
 
@@ -2634,8 +2873,9 @@ bool FF_VideoEncoder::open( const char * filename, int fourcc,
     }
 
     // check arguments
-    if( !filename )
+    if( !filenames || nb_files < 1 || !filenames[0] )
         return false;
+    const char* filename = filenames[0];
     if(fps <= 0)
         return false;
 
@@ -2649,11 +2889,30 @@ bool FF_VideoEncoder::open( const char * filename, int fourcc,
 
     /* auto detect the output format from the name and fourcc code. */
 
-    fmt = av_guess_format(NULL, filename, NULL);
+    fmt = av_guess_format(formats ? formats[0] : NULL, filename, NULL);
 
     if (!fmt)
         return false;
 
+    if (nb_files > 1)
+    {
+        outputs = (FF_EncoderOutput*)av_mallocz_array(nb_files, sizeof(*outputs));
+        if (!outputs)
+            return false;
+        nb_outputs = nb_files;
+        for (int i = 0; i < nb_files; i++)
+            outputs[i].may_drop = may_drop && may_drop[i];
+        for (int i = 1; i < nb_files; i++)
+        {
+            if (!filenames[i] ||
+                avformat_alloc_output_context2(&outputs[i].oc, NULL, formats ? formats[i] : NULL, filenames[i]) < 0)
+            {
+                close();
+                return false;
+            }
+        }
+    }
+
     /* determine optimal pixel format */
     if (is_color) {
         input_pix_fmt = AV_PIX_FMT_BGR24;
@@ -2916,6 +3175,13 @@ bool FF_VideoEncoder::open( const char * filename, int fourcc,
             continue;
         }
 
+        // the encoder is shared, so it emits global headers as soon as one muxer wants them
+        for (int i = 1; i < nb_outputs; i++)
+        {
+            if (outputs[i].oc->oformat->flags & AVFMT_GLOBALHEADER)
+                c->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+
 #if 0
 #if FF_API_DUMP_FORMAT
         dump_format(oc, 0, filename, 1);
@@ -3031,6 +3297,14 @@ bool FF_VideoEncoder::open( const char * filename, int fourcc,
         remove(filename);
         return false;
     }
+
+    if (nb_outputs > 0 && !openOutputs(filenames))
+    {
+        close();
+        for (int i = 0; i < nb_files; i++)
+            remove(filenames[i]);
+        return false;
+    }
     frame_width = width;
     frame_height = height;
     frame_idx = 0;
@@ -3039,6 +3313,57 @@ bool FF_VideoEncoder::open( const char * filename, int fourcc,
     return true;
 }
 
+/// set up the muxers and muxing threads fed by the shared encoder
+bool FF_VideoEncoder::openOutputs(const char* const* filenames)
+{
+    AVCodecContext *c = video_st->codec;
+
+    outputs[0].oc = oc;
+    outputs[0].st = video_st;
+    for (int i = 0; i < nb_outputs; i++)
+    {
+        FF_EncoderOutput* out = &outputs[i];
+        if (i > 0)
+        {
+            out->st = avformat_new_stream(out->oc, NULL);
+            if (!out->st)
+                return false;
+            if (avcodec_parameters_from_context(out->st->codecpar, c) < 0)
+                return false;
+            // the fourcc was validated against the first container only, let the others pick their own tag
+            out->st->codecpar->codec_tag = 0;
+            out->st->time_base = c->time_base;
+            out->st->avg_frame_rate = video_st->avg_frame_rate;
+
+            if (!(out->oc->oformat->flags & AVFMT_NOFILE) &&
+                avio_open(&out->oc->pb, filenames[i], AVIO_FLAG_WRITE) < 0)
+                return false;
+            if (avformat_write_header(out->oc, NULL) < 0)
+                return false;
+            out->header_written = true;
+        }
+
+        // repeat the extradata in-band for containers which don't store global headers (e.g. mpegts)
+        if ((c->flags & AV_CODEC_FLAG_GLOBAL_HEADER) && !(out->oc->oformat->flags & AVFMT_GLOBALHEADER))
+        {
+            const AVBitStreamFilter* filter = av_bsf_get_by_name("dump_extra");
+            if (!filter || av_bsf_alloc(filter, &out->bsfc) < 0)
+                return false;
+            if (avcodec_parameters_copy(out->bsfc->par_in, out->st->codecpar) < 0)
+                return false;
+            out->bsfc->time_base_in = out->st->time_base;
+            if (av_bsf_init(out->bsfc) < 0)
+                return false;
+        }
+
+        if (av_thread_message_queue_alloc(&out->queue, FF_OUTPUT_QUEUE_SIZE, sizeof(AVPacket*)) < 0)
+            return false;
+        av_thread_message_queue_set_free_func(out->queue, _ff_free_packet_msg);
+        out->thread = new std::thread(_ff_output_mux_loop, out);
+    }
+    return true;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static
@@ -3096,14 +3421,15 @@ int FF_VideoDecoder_RetrieveFrame(FF_VideoDecoder* capture, unsigned char** data
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static FF_VideoEncoder* FF_VideoEncoder_CreateWithParams( const char* filename, int fourcc, double fps,
+static FF_VideoEncoder* FF_VideoEncoder_CreateWithParams( const char* const* filenames, const char* const* formats,
+                                                  const int* may_drop, int nb_files, int fourcc, double fps,
                                                   int width, int height, const VideoWriterParameters& params )
 {
     FF_VideoEncoder* writer = (FF_VideoEncoder*)malloc(sizeof(*writer));
     if (!writer)
         return 0;
     writer->init();
-    if( writer->open( filename, fourcc, fps, width, height, params ))
+    if( writer->open( filenames, formats, may_drop, nb_files, fourcc, fps, width, height, params ))
         return writer;
     writer->close();
     free(writer);
@@ -3115,7 +3441,16 @@ FF_VideoEncoder* FF_VideoEncoder_Create( const char* filename, int fourcc, doubl
 {
     VideoWriterParameters params;
     params.add(VIDEOWRITER_PROP_IS_COLOR, isColor);
-    return FF_VideoEncoder_CreateWithParams(filename, fourcc, fps, width, height, params);
+    return FF_VideoEncoder_CreateWithParams(&filename, NULL, NULL, 1, fourcc, fps, width, height, params);
+}
+
+FF_VideoEncoder* FF_VideoEncoder_CreateMulti( const char* const* filenames, const char* const* formats,
+                                                  const int* may_drop, int nb_files, int fourcc, double fps,
+                                                  int width, int height, int isColor )
+{
+    VideoWriterParameters params;
+    params.add(VIDEOWRITER_PROP_IS_COLOR, isColor);
+    return FF_VideoEncoder_CreateWithParams(filenames, formats, may_drop, nb_files, fourcc, fps, width, height, params);
 }
 
 void FF_VideoEncoder_Release( FF_VideoEncoder** writer )
@@ -3135,3 +3470,298 @@ int FF_VideoEncoder_WriteFrame( FF_VideoEncoder* writer,
 {
     return writer->writeFrame(data, step, width, height, cn, origin);
 }
+
+int FF_VideoEncoder_GetOutputStatus( FF_VideoEncoder* writer, int index, int64_t* nb_dropped )
+{
+    return writer->getOutputStatus(index, nb_dropped);
+}
+
+///////////////// multi-rendition (ABR ladder) writer //////////////////////////
+
+/* set of jobs a caller waits for as a whole */
+struct FF_TaskGroup
+{
+    FF_TaskGroup() : pending(0) {}
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+    std::mutex              mutex;
+    std::condition_variable done;
+    int                     pending;
+};
+
+/* process-wide worker pool, shared by all ladder writers so that N ladders
+   don't spawn N * renditions threads */
+class FF_ThreadPool
+{
+public:
+    static FF_ThreadPool& instance()
+    {
+        // never destroyed: workers may still be blocked in wait() at exit
+        static FF_ThreadPool* pool = new FF_ThreadPool(std::max(get_number_of_cpus(), 1));
+        return *pool;
+    }
+
+    void submit(void (*func)(void*), void* arg, FF_TaskGroup* group)
+    {
+        {
+            std::lock_guard<std::mutex> glock(group->mutex);
+            group->pending++;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(Job{func, arg, group});
+        cond.notify_one();
+    }
+
+private:
+    struct Job
+    {
+        void (*func)(void*);
+        void* arg;
+        FF_TaskGroup* group;
+    };
+
+    explicit FF_ThreadPool(int nb_threads)
+    {
+        for (int i = 0; i < nb_threads; i++)
+            std::thread(&FF_ThreadPool::worker, this).detach();
+    }
+
+    void worker()
+    {
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [this] { return !jobs.empty(); });
+                job = jobs.front();
+                jobs.erase(jobs.begin());
+            }
+            job.func(job.arg);
+
+            std::lock_guard<std::mutex> glock(job.group->mutex);
+            if (--job.group->pending == 0)
+                job.group->done.notify_all();
+        }
+    }
+
+    std::mutex              mutex;
+    std::condition_variable cond;
+    std::vector<Job>        jobs;
+};
+
+struct FF_VideoLadderEncoder;
+
+struct FF_LadderJob
+{
+    FF_VideoLadderEncoder* ladder;
+    int                    index;
+};
+
+/* one input feeding several renditions: the BGR/GRAY -> YUV conversion is done
+   once at the top resolution, every lower rung is scaled from the rung above it
+   (1080 -> 720 -> 360) and the rendition encoders run on FF_ThreadPool */
+struct FF_VideoLadderEncoder
+{
+    bool open( const char* const* filenames, const int* widths, const int* heights, int nb_renditions,
+               int fourcc, double fps, const VideoWriterParameters& params );
+    void close();
+    bool writeFrame( const unsigned char* data, int step, int width, int height, int cn, int origin );
+    bool wait();
+
+    void init();
+
+    FF_VideoEncoder  ** renditions;
+    struct SwsContext ** scale_ctx;     // rung i-1 -> rung i, [0] is unused
+    FF_LadderJob       * jobs;
+    bool               * results;
+    int                  nb_renditions;
+    FF_TaskGroup       * pending;
+};
+
+void FF_VideoLadderEncoder::init()
+{
+    renditions = NULL;
+    scale_ctx = NULL;
+    jobs = NULL;
+    results = NULL;
+    nb_renditions = 0;
+    pending = NULL;
+}
+
+static void _ff_ladder_encode_job(void* arg)
+{
+    FF_LadderJob* job = (FF_LadderJob*)arg;
+    FF_VideoLadderEncoder* ladder = job->ladder;
+    ladder->results[job->index] = ladder->renditions[job->index]->encodePicture();
+}
+
+/// wait for the encoders of the previous frame; false if one of them failed
+bool FF_VideoLadderEncoder::wait()
+{
+    bool ret = true;
+    if (pending)
+        pending->wait();
+    for (int i = 0; i < nb_renditions; i++)
+        ret = ret && results[i];
+    return ret;
+}
+
+void FF_VideoLadderEncoder::close()
+{
+    if (pending)
+    {
+        pending->wait();
+        delete pending;
+    }
+
+    for (int i = 0; i < nb_renditions; i++)
+    {
+        if (scale_ctx && scale_ctx[i])
+            sws_freeContext(scale_ctx[i]);
+        if (renditions)
+            FF_VideoEncoder_Release(&renditions[i]);
+    }
+    av_free(renditions);
+    av_free(scale_ctx);
+    av_free(jobs);
+    av_free(results);
+
+    init();
+}
+
+/// renditions must be given from the largest to the smallest, the first one
+/// has the size of the frames passed to writeFrame()
+bool FF_VideoLadderEncoder::open( const char* const* filenames, const int* widths, const int* heights,
+                                  int nb_renditions_, int fourcc, double fps, const VideoWriterParameters& params )
+{
+    close();
+
+    if (!filenames || !widths || !heights || nb_renditions_ < 1)
+        return false;
+    for (int i = 1; i < nb_renditions_; i++)
+    {
+        if (widths[i] > widths[i-1] || heights[i] > heights[i-1])
+            return false;
+    }
+
+    renditions = (FF_VideoEncoder**)av_mallocz_array(nb_renditions_, sizeof(*renditions));
+    scale_ctx = (struct SwsContext**)av_mallocz_array(nb_renditions_, sizeof(*scale_ctx));
+    jobs = (FF_LadderJob*)av_mallocz_array(nb_renditions_, sizeof(*jobs));
+    results = (bool*)av_mallocz_array(nb_renditions_, sizeof(*results));
+    pending = new FF_TaskGroup();
+    nb_renditions = nb_renditions_;
+    if (!renditions || !scale_ctx || !jobs || !results)
+    {
+        close();
+        return false;
+    }
+
+    for (int i = 0; i < nb_renditions; i++)
+    {
+        results[i] = true;
+        jobs[i].ladder = this;
+        jobs[i].index = i;
+
+        renditions[i] = (FF_VideoEncoder*)malloc(sizeof(FF_VideoEncoder));
+        if (!renditions[i])
+        {
+            close();
+            return false;
+        }
+        renditions[i]->init();
+        if (!renditions[i]->open(filenames[i], fourcc, fps, widths[i], heights[i], params))
+        {
+            close();
+            return false;
+        }
+        if (i == 0)
+            continue;
+
+        // lower rungs are scaled from the picture of the rung above, which has
+        // to be a converted copy rather than the caller's buffer
+        FF_VideoEncoder* src = renditions[i-1];
+        FF_VideoEncoder* dst = renditions[i];
+        if (!src->input_picture || !dst->input_picture)
+        {
+            close();
+            return false;
+        }
+        scale_ctx[i] = sws_getContext(src->frame_width, src->frame_height, (AVPixelFormat)src->picture->format,
+                                      dst->frame_width, dst->frame_height, (AVPixelFormat)dst->picture->format,
+                                      SWS_BICUBIC, NULL, NULL, NULL);
+        if (!scale_ctx[i])
+        {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FF_VideoLadderEncoder::writeFrame( const unsigned char* data, int step, int width, int height, int cn, int origin )
+{
+    // the pictures are still owned by the previous frame's encoders
+    if (!wait())
+        return false;
+
+    if (!renditions[0]->convertFrame(data, step, width, height, cn, origin))
+        return false;
+    for (int i = 1; i < nb_renditions; i++)
+    {
+        FF_VideoEncoder* src = renditions[i-1];
+        FF_VideoEncoder* dst = renditions[i];
+        if (sws_scale(scale_ctx[i], src->picture->data, src->picture->linesize, 0, src->frame_height,
+                      dst->picture->data, dst->picture->linesize) < 0)
+            return false;
+    }
+
+    for (int i = 0; i < nb_renditions; i++)
+        FF_ThreadPool::instance().submit(_ff_ladder_encode_job, &jobs[i], pending);
+
+    // without a colour conversion the top rung encodes straight from the caller's buffer
+    if (!renditions[0]->input_picture)
+        return wait();
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+FF_VideoLadderEncoder* FF_VideoLadderEncoder_Create( const char* const* filenames, const int* widths, const int* heights,
+                                                  int nb_renditions, int fourcc, double fps, int isColor )
+{
+    VideoWriterParameters params;
+    params.add(VIDEOWRITER_PROP_IS_COLOR, isColor);
+
+    FF_VideoLadderEncoder* ladder = (FF_VideoLadderEncoder*)malloc(sizeof(*ladder));
+    if (!ladder)
+        return 0;
+    ladder->init();
+    if (ladder->open(filenames, widths, heights, nb_renditions, fourcc, fps, params))
+        return ladder;
+    ladder->close();
+    free(ladder);
+    return 0;
+}
+
+void FF_VideoLadderEncoder_Release( FF_VideoLadderEncoder** ladder )
+{
+    if( ladder && *ladder )
+    {
+        (*ladder)->close();
+        free(*ladder);
+        *ladder = 0;
+    }
+}
+
+int FF_VideoLadderEncoder_WriteFrame( FF_VideoLadderEncoder* ladder,
+                         const unsigned char* data, int step,
+                         int width, int height, int cn, int origin)
+{
+    return ladder->writeFrame(data, step, width, height, cn, origin);
+}
@@ -1,6 +1,8 @@
 #ifndef _FFMPEG_LEGACY_API_H__
 #define _FFMPEG_LEGACY_API_H__
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -16,6 +18,7 @@ extern "C"
 
 typedef struct FF_VideoDecoder FF_VideoDecoder;
 typedef struct FF_VideoEncoder FF_VideoEncoder;
+typedef struct FF_VideoLadderEncoder FF_VideoLadderEncoder;
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 _FFMPEG_API FF_VideoDecoder* FF_VideoDecoder_Create( const char* filename);
 _FFMPEG_API int FF_VideoDecoder_SetProperty(struct FF_VideoDecoder* cap,
@@ -28,10 +31,31 @@ _FFMPEG_API void FF_VideoDecoder_Release(struct FF_VideoDecoder** cap);
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 _FFMPEG_API struct FF_VideoEncoder* FF_VideoEncoder_Create(const char* filename,
             int fourcc, double fps, int width, int height, int isColor );
+/* encodes every frame once and muxes it into each of the nb_files outputs;
+   formats may be NULL (or hold NULL entries) to guess the container from the file name.
+   An output falling behind blocks the encoder unless its may_drop entry is set, then it
+   drops packets until the next keyframe; may_drop may be NULL. */
+_FFMPEG_API struct FF_VideoEncoder* FF_VideoEncoder_CreateMulti(const char* const* filenames,
+            const char* const* formats, const int* may_drop, int nb_files,
+            int fourcc, double fps, int width, int height, int isColor );
+/* returns 0 when a frame could not be encoded or outputs[0] failed; the other outputs
+   are left behind on errors, see FF_VideoEncoder_GetOutputStatus() */
 _FFMPEG_API int FF_VideoEncoder_WriteFrame(struct FF_VideoEncoder* writer, const unsigned char* data,
                                           int step, int width, int height, int cn, int origin);
+/* returns the error (a negative AVERROR) of output index, or 0, and stores the number
+   of packets it dropped so far in nb_dropped if not NULL */
+_FFMPEG_API int FF_VideoEncoder_GetOutputStatus(struct FF_VideoEncoder* writer, int index,
+                                          int64_t* nb_dropped);
 _FFMPEG_API void FF_VideoEncoder_Release(struct FF_VideoEncoder** writer);
 ///////////////////////////////////////////////////////////////////////////////////////////////////
+/* one writer per rendition, largest first; frames are passed at widths[0] x heights[0] */
+_FFMPEG_API struct FF_VideoLadderEncoder* FF_VideoLadderEncoder_Create(const char* const* filenames,
+            const int* widths, const int* heights, int nb_renditions,
+            int fourcc, double fps, int isColor );
+_FFMPEG_API int FF_VideoLadderEncoder_WriteFrame(struct FF_VideoLadderEncoder* ladder, const unsigned char* data,
+                                          int step, int width, int height, int cn, int origin);
+_FFMPEG_API void FF_VideoLadderEncoder_Release(struct FF_VideoLadderEncoder** ladder);
+///////////////////////////////////////////////////////////////////////////////////////////////////
 #ifdef __cplusplus
 }
 #endif
@@ -3,6 +3,7 @@
 // of this distribution and at http://opencv.org/license.html.
 
 #include "test_precomp.hpp"
+#include "cap_ffmpeg_legacy_api.hpp"
 
 using namespace std;
 
@@ -516,4 +517,123 @@ TEST(videoio_ffmpeg, create_with_property_badarg)
 }
 
 
+static int ffmpeg_count_frames(const string& filename, const Size& sz)
+{
+    VideoCapture cap(filename, CAP_FFMPEG);
+    if (!cap.isOpened())
+        return -1;
+    int n = 0;
+    Mat frame;
+    while (cap.read(frame))
+    {
+        EXPECT_EQ(sz, frame.size());
+        n++;
+    }
+    return n;
+}
+
+TEST(videoio_ffmpeg, write_multi_output)
+{
+    if (!videoio_registry::hasBackend(CAP_FFMPEG))
+        throw SkipTestException("FFmpeg backend was not found");
+
+    const Size sz(320, 240);
+    const int frameNum = 30;
+    const Scalar color(Scalar::all(0));
+    const Point center(sz.width / 2, sz.height / 2);
+    const string files[] = { tempfile("multi_output.avi"), tempfile("multi_output.mkv") };
+    const char* filenames[] = { files[0].c_str(), files[1].c_str() };
+
+    FF_VideoEncoder* writer = FF_VideoEncoder_CreateMulti(filenames, NULL, NULL, 2,
+                                                          VideoWriter::fourcc('M','J','P','G'),
+                                                          25.0, sz.width, sz.height, 1);
+    ASSERT_TRUE(writer != NULL);
+    Mat frame(sz, CV_8UC3);
+    for (int i = 0; i < frameNum; i++)
+    {
+        generateFrame(frame, i, center, color);
+        ASSERT_TRUE(FF_VideoEncoder_WriteFrame(writer, frame.data, (int)frame.step,
+                                               sz.width, sz.height, 3, 0) != 0) << "frame " << i;
+    }
+    // outputs without may_drop block instead of dropping
+    for (int i = 0; i < 2; i++)
+    {
+        int64_t nb_dropped = -1;
+        EXPECT_EQ(0, FF_VideoEncoder_GetOutputStatus(writer, i, &nb_dropped)) << files[i];
+        EXPECT_EQ(0, nb_dropped) << files[i];
+    }
+    FF_VideoEncoder_Release(&writer);
+
+    // both files hold the same packets, so they decode to the same frames
+    VideoCapture caps[2];
+    for (int i = 0; i < 2; i++)
+    {
+        caps[i].open(files[i], CAP_FFMPEG);
+        ASSERT_TRUE(caps[i].isOpened()) << files[i];
+    }
+    int n = 0;
+    Mat frames[2];
+    while (caps[0].read(frames[0]))
+    {
+        ASSERT_TRUE(caps[1].read(frames[1])) << "frame " << n;
+        EXPECT_EQ(0, cvtest::norm(frames[0], frames[1], NORM_INF)) << "frame " << n;
+        n++;
+    }
+    EXPECT_FALSE(caps[1].read(frames[1]));
+    EXPECT_EQ(frameNum, n);
+    for (int i = 0; i < 2; i++)
+    {
+        caps[i].release();
+        remove(files[i].c_str());
+    }
+}
+
+TEST(videoio_ffmpeg, write_abr_ladder)
+{
+    if (!videoio_registry::hasBackend(CAP_FFMPEG))
+        throw SkipTestException("FFmpeg backend was not found");
+
+    const int nb_renditions = 3;
+    const Size sizes[nb_renditions] = { Size(640, 480), Size(320, 240), Size(160, 120) };
+    const int widths[nb_renditions]  = { 640, 320, 160 };
+    const int heights[nb_renditions] = { 480, 240, 120 };
+    const int frameNum = 30;
+    const Scalar color(Scalar::all(0));
+    const Point center(sizes[0].width / 2, sizes[0].height / 2);
+    string files[nb_renditions];
+    const char* filenames[nb_renditions];
+    for (int i = 0; i < nb_renditions; i++)
+    {
+        ostringstream stream;
+        stream << "abr_ladder_" << widths[i] << ".avi";
+        files[i] = tempfile(stream.str().c_str());
+        filenames[i] = files[i].c_str();
+    }
+
+    // the rungs must not grow
+    const int bad_widths[] = { 320, 640 };
+    const int bad_heights[] = { 240, 480 };
+    EXPECT_TRUE(FF_VideoLadderEncoder_Create(filenames, bad_widths, bad_heights, 2,
+                                             VideoWriter::fourcc('M','J','P','G'), 25.0, 1) == NULL);
+
+    FF_VideoLadderEncoder* ladder = FF_VideoLadderEncoder_Create(filenames, widths, heights, nb_renditions,
+                                                                 VideoWriter::fourcc('M','J','P','G'), 25.0, 1);
+    ASSERT_TRUE(ladder != NULL);
+    Mat frame(sizes[0], CV_8UC3);
+    for (int i = 0; i < frameNum; i++)
+    {
+        generateFrame(frame, i, center, color);
+        ASSERT_TRUE(FF_VideoLadderEncoder_WriteFrame(ladder, frame.data, (int)frame.step,
+                                                     sizes[0].width, sizes[0].height, 3, 0) != 0) << "frame " << i;
+    }
+    FF_VideoLadderEncoder_Release(&ladder);
+
+    for (int i = 0; i < nb_renditions; i++)
+    {
+        EXPECT_EQ(frameNum, ffmpeg_count_frames(files[i], sizes[i])) << files[i];
+        remove(files[i].c_str());
+    }
+}
+
+
 }} // namespace